@@ -17,10 +17,13 @@
 #include "Highlighter.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <limits>
+#include <memory>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/range/adaptor/reversed.hpp>
@@ -35,12 +38,28 @@
 #include "tree.hpp"
 
 static int leftShift(const Node *node);
+template <typename C>
+static int leftShiftOfSiblings(const C &nodes);
+static int getCol(const Node *node);
 static ColorGroup getHighlight(const Node &node, int moved, State state,
                                const Language &lang);
 static bool isDiffable(const Node &node, State state, const Language &lang);
 static std::vector<boost::string_ref> toWords(boost::string_ref s);
 static std::vector<boost::string_ref> toChars(boost::string_ref s);
 
+// Result of diffing spelling of a pair of nodes.
+struct SpellingDiffs::Diff
+{
+    // Kind of an edit script element.
+    enum class Edit : std::uint8_t { Common, Deleted, Inserted };
+
+    bool surround;                         // Whether diffed as an identifier.
+    bool similar;                          // Whether diff is worth displaying.
+    std::vector<boost::string_ref> lWords; // Words of original spelling.
+    std::vector<boost::string_ref> rWords; // Words of updated spelling.
+    std::vector<Edit> edits;               // Shortest edit script.
+};
+
 class Highlighter::ColorPicker
 {
 public:
@@ -64,6 +83,20 @@ private:
     bool currMoved = false;
 };
 
+// Saved state of highlighting at the beginning of a line.
+struct Highlighter::Checkpoint
+{
+    int line;                              // Line at which state was saved.
+    std::stack<Entry> toProcess;           // State of tree traversal.
+    ColorPicker colorPicker;               // Highlighting state.
+    const Node *current;                   // Node that's being processed.
+    std::vector<boost::string_ref> olines; // Rest of undiffed spelling.
+    std::vector<ColorCane> lines;          // Rest of possibly diffed spelling.
+};
+
+// Number of lines between two adjacent checkpoints.
+static const int checkpointStep = 64;
+
 Highlighter::ColorPicker::ColorPicker(const Language &lang) : lang(lang) { }
 
 void
@@ -113,14 +146,29 @@ Highlighter::ColorPicker::getFillHighlight() const
 }
 
 Highlighter::Highlighter(const Tree &tree, bool original)
-    : Highlighter(*tree.getRoot(), *tree.getLanguage(), original, 1, 1)
+    : Highlighter(*tree.getLanguage(), original, 1, 1)
 {
+    const Node &root = *tree.getRoot();
+    toProcess.push({ &root, root.moved, root.state, false, false });
+    saveCheckpoint();
 }
 
 Highlighter::Highlighter(const Node &root, const Language &lang, bool original,
                          int lineOffset)
-    : Highlighter(root, lang, original, lineOffset, leftShift(&root))
+    : Highlighter(lang, original, lineOffset, leftShift(&root))
+{
+    toProcess.push({ &root, root.moved, root.state, false, false });
+    saveCheckpoint();
+}
+
+Highlighter::Highlighter(const std::vector<Node *> &nodes,
+                         const Language &lang, bool original, int lineOffset)
+    : Highlighter(lang, original, lineOffset, leftShiftOfSiblings(nodes))
 {
+    for (Node *node : boost::adaptors::reverse(nodes)) {
+        toProcess.push({ node, node->moved, node->state, false, false });
+    }
+    saveCheckpoint();
 }
 
 // Computes how far to the right subtree defined by the `node` is shifted.  This
@@ -129,14 +177,6 @@ Highlighter::Highlighter(const Node &root, const Language &lang, bool original,
 static int
 leftShift(const Node *node)
 {
-    auto getCol = [](const Node *node) {
-        if (node->spelling.find('\n') != std::string::npos) {
-            // Multiline nodes occupy first column.
-            return 1;
-        }
-        return node->col;
-    };
-
     if (node->next != nullptr) {
         return leftShift(node->next);
     }
@@ -145,24 +185,43 @@ leftShift(const Node *node)
         return getCol(node);
     }
 
+    return leftShiftOfSiblings(node->children);
+}
+
+// Computes left shift of a sequence of sibling subtrees.
+template <typename C>
+static int
+leftShiftOfSiblings(const C &nodes)
+{
     int shift = std::numeric_limits<int>::max();
-    for (Node *child : node->children) {
-        if (!child->leaf || child->next != nullptr) {
-            shift = std::min(shift, leftShift(child));
+    for (const Node *node : nodes) {
+        if (!node->leaf || node->next != nullptr) {
+            shift = std::min(shift, leftShift(node));
         } else {
-            shift = std::min(shift, getCol(child));
+            shift = std::min(shift, getCol(node));
         }
     }
     return shift;
 }
 
-Highlighter::Highlighter(const Node &root, const Language &lang, bool original,
-                         int lineOffset, int colOffset)
+// Retrieves column of a leaf node for the purposes of computing shift.
+static int
+getCol(const Node *node)
+{
+    if (node->spelling.find('\n') != std::string::npos) {
+        // Multiline nodes occupy first column.
+        return 1;
+    }
+    return node->col;
+}
+
+Highlighter::Highlighter(const Language &lang, bool original, int lineOffset,
+                         int colOffset)
     : lang(lang), line(lineOffset), col(1), colOffset(colOffset),
       colorPicker(new ColorPicker(lang)), original(original), current(nullptr),
-      printReferences(false), printBrackets(false), transparentDiffables(false)
+      printReferences(false), printBrackets(false), transparentDiffables(false),
+      spellingDiffs(std::make_shared<SpellingDiffs>())
 {
-    toProcess.push({ &root, root.moved, root.state, false, false });
 }
 
 Highlighter::~Highlighter() = default;
@@ -185,10 +244,24 @@ Highlighter::setTransparentDiffables(bool transparent)
     transparentDiffables = transparent;
 }
 
+void
+Highlighter::setSpellingDiffs(std::shared_ptr<SpellingDiffs> diffs)
+{
+    spellingDiffs = std::move(diffs);
+}
+
+int
+Highlighter::getLeftShift() const
+{
+    return colOffset - 1;
+}
+
 ColorCane
 Highlighter::print(int from, int n)
 {
     colorCane = ColorCane();
+
+    restoreCheckpoint(from);
     if (from < line) {
         n = std::max(0, n - (line - from));
     }
@@ -206,8 +279,64 @@ Highlighter::print()
     return std::move(colorCane);
 }
 
+void
+Highlighter::restoreCheckpoint(int targetLine)
+{
+    const int firstLine = checkpoints.front()->line;
+    if (targetLine < firstLine) {
+        targetLine = firstLine;
+    }
+
+    const std::size_t idx = std::min<std::size_t>(
+        (targetLine - firstLine)/checkpointStep, checkpoints.size() - 1U
+    );
+    const Checkpoint &cp = *checkpoints[idx];
+    // State is past the last line once everything is processed.
+    const bool exhausted = (toProcess.empty() && lines.empty());
+    if (!exhausted && cp.line <= line && line <= targetLine) {
+        // Current state is at least as good as the checkpoint.
+        return;
+    }
+
+    line = cp.line;
+    toProcess = cp.toProcess;
+    colorPicker.reset(new ColorPicker(cp.colorPicker));
+    current = cp.current;
+    olines = cp.olines;
+    lines = cp.lines;
+}
+
+void
+Highlighter::saveCheckpoint()
+{
+    checkpoints.emplace_back(new Checkpoint {
+        line, toProcess, *colorPicker, current, olines, lines
+    });
+}
+
 void
 Highlighter::skipUntil(int targetLine)
+{
+    while (true) {
+        const int nextCheckpoint = checkpoints.front()->line
+                                 + checkpoints.size()*checkpointStep;
+        if (line >= nextCheckpoint || nextCheckpoint > targetLine) {
+            break;
+        }
+
+        skipTo(nextCheckpoint);
+        if (line != nextCheckpoint) {
+            // Reached the end.
+            return;
+        }
+        saveCheckpoint();
+    }
+
+    skipTo(targetLine);
+}
+
+void
+Highlighter::skipTo(int targetLine)
 {
     if (line >= targetLine) {
         return;
@@ -474,8 +603,9 @@ Highlighter::getSpelling(const Entry &entry)
         cc.append(node.spelling, &node, ColorGroup::Updated);
     }
 
-    int &id = updates[original ? &node : node.relative];
-    id = updates.size();
+    // Nodes can be visited more than once, keep their ids stable.
+    const Node *key = (original ? &node : node.relative);
+    const int id = updates.emplace(key, updates.size() + 1).first->second;
     if (printReferences) {
         cc.append('{', ColorGroup::UpdatedSurroundings);
         cc.append(std::to_string(id), nullptr, ColorGroup::UpdatedSurroundings);
@@ -494,44 +624,121 @@ isDiffable(const Node &node, State state, const Language &lang)
         && state == State::Updated;
 }
 
-ColorCane
-Highlighter::diffSpelling(const Node &node, bool moved)
+SpellingDiffs::SpellingDiffs() = default;
+
+SpellingDiffs::~SpellingDiffs() = default;
+
+const SpellingDiffs::Diff &
+SpellingDiffs::get(const Node &l, const Node &r, bool surround)
 {
-    // XXX: some kind of caching would be nice since we're doing the same thing
-    //      for both original and updated nodes.
+    std::unique_ptr<Diff> &entry = diffs[{ &l, &r }];
+    // Highlighters of different sides might disagree on how to diff the pair
+    // if types of nodes differ.
+    if (entry != nullptr && entry->surround == surround) {
+        return *entry;
+    }
 
-    boost::string_ref l = (original ? node.spelling : node.relative->spelling);
-    boost::string_ref r = (original ? node.relative->spelling : node.spelling);
+    entry.reset(new Diff());
+    Diff &diff = *entry;
+    diff.surround = surround;
 
-    std::vector<boost::string_ref> lWords = toWords(l);
-    std::vector<boost::string_ref> rWords = toWords(r);
+    diff.lWords = toWords(l.spelling);
+    diff.rWords = toWords(r.spelling);
 
-    const bool surround = node.type == Type::Functions
-                       || node.type == Type::Identifiers
-                       || node.type == Type::UserTypes;
+    if (surround && diff.lWords.size() == 1U && diff.rWords.size() == 1U) {
+        diff.lWords = toChars(l.spelling);
+        diff.rWords = toChars(r.spelling);
+    }
 
-    if (surround && lWords.size() == 1U && rWords.size() == 1U) {
-        lWords = toChars(l);
-        rWords = toChars(r);
+    const std::vector<boost::string_ref> &lWords = diff.lWords;
+    const std::vector<boost::string_ref> &rWords = diff.rWords;
+
+    // Identical prefix and suffix are common to both spellings and don't need
+    // to go through edit distance computation, which is quadratic in the worst
+    // case (long string literals and comments with a small change).
+    std::size_t prefix = 0U;
+    std::size_t maxCommon = std::min(lWords.size(), rWords.size());
+    while (prefix < maxCommon && lWords[prefix] == rWords[prefix]) {
+        ++prefix;
+    }
+    std::size_t suffix = 0U;
+    while (prefix + suffix < maxCommon &&
+           lWords[lWords.size() - 1U - suffix] ==
+           rWords[rWords.size() - 1U - suffix]) {
+        ++suffix;
     }
 
-    auto cmp = [](const boost::string_ref &a, const boost::string_ref &b) {
-        return (a == b);
-    };
+    std::vector<boost::string_ref> lMiddle(lWords.cbegin() + prefix,
+                                           lWords.cend() - suffix);
+    std::vector<boost::string_ref> rMiddle(rWords.cbegin() + prefix,
+                                           rWords.cend() - suffix);
 
-    dtl::Diff<boost::string_ref, std::vector<boost::string_ref>,
-              decltype(cmp)> diff(lWords, rWords, cmp);
-    diff.compose();
+    diff.edits.assign(prefix, Diff::Edit::Common);
 
-    ColorCane cc;
+    if (lMiddle.empty() || rMiddle.empty()) {
+        diff.edits.insert(diff.edits.cend(), lMiddle.size(),
+                          Diff::Edit::Deleted);
+        diff.edits.insert(diff.edits.cend(), rMiddle.size(),
+                          Diff::Edit::Inserted);
+    } else {
+        auto cmp = [](const boost::string_ref &a, const boost::string_ref &b) {
+            return (a == b);
+        };
+
+        dtl::Diff<boost::string_ref, std::vector<boost::string_ref>,
+                  decltype(cmp)> dtlDiff(lMiddle, rMiddle, cmp);
+        dtlDiff.compose();
+
+        for (const auto &x : dtlDiff.getSes().getSequence()) {
+            switch (x.second.type) {
+                case dtl::SES_DELETE:
+                    diff.edits.push_back(Diff::Edit::Deleted);
+                    break;
+                case dtl::SES_ADD:
+                    diff.edits.push_back(Diff::Edit::Inserted);
+                    break;
+                case dtl::SES_COMMON:
+                    diff.edits.push_back(Diff::Edit::Common);
+                    break;
+            }
+        }
+    }
+
+    diff.edits.insert(diff.edits.cend(), suffix, Diff::Edit::Common);
+
+    const std::size_t common = std::count(diff.edits.cbegin(),
+                                          diff.edits.cend(),
+                                          Diff::Edit::Common);
+    const std::size_t editDistance = diff.edits.size() - common;
 
     float worstDistance = std::max(lWords.size(), rWords.size());
-    float sim = 1.0f - diff.getEditDistance()/worstDistance;
+    float sim = 1.0f - editDistance/worstDistance;
 
     // If Levenshtein distance ends up being too big (similarity is too small),
-    // drop comparison results and get back to just printing two nodes as
+    // comparison results aren't worth displaying.
+    diff.similar = (sim >= 0.2f);
+
+    return diff;
+}
+
+ColorCane
+Highlighter::diffSpelling(const Node &node, bool moved)
+{
+    const Node &lNode = (original ? node : *node.relative);
+    const Node &rNode = (original ? *node.relative : node);
+
+    const bool surround = node.type == Type::Functions
+                       || node.type == Type::Identifiers
+                       || node.type == Type::UserTypes;
+
+    const SpellingDiffs::Diff &diff = spellingDiffs->get(lNode, rNode,
+                                                         surround);
+
+    ColorCane cc;
+
+    // Drop comparison results and get back to just printing two nodes as
     // updated.
-    if (sim < 0.2f) {
+    if (!diff.similar) {
         cc.append(node.spelling, &node, ColorGroup::Updated);
         return cc;
     }
@@ -540,21 +747,17 @@ Highlighter::diffSpelling(const Node &node, bool moved)
         cc.append('[', ColorGroup::UpdatedSurroundings);
     }
 
-    const char *lastL = l.data(), *lastR = r.data();
+    const std::vector<boost::string_ref> &words = (original ? diff.lWords
+                                                            : diff.rWords);
+    const boost::string_ref spelling = node.spelling;
+    const char *last = spelling.data();
+    std::size_t wordIdx = 0U;
 
-    auto printLeft = [&](const dtl::elemInfo &info, ColorGroup hi,
-                         ColorGroup def) {
-        const boost::string_ref sr = lWords[info.beforeIdx - 1];
-        cc.append(boost::string_ref(lastL, sr.data() - lastL), &node, def);
+    auto printWord = [&](ColorGroup hi, ColorGroup def) {
+        const boost::string_ref sr = words[wordIdx++];
+        cc.append(boost::string_ref(last, sr.data() - last), &node, def);
         cc.append(sr, &node, hi);
-        lastL = sr.data() + sr.size();
-    };
-    auto printRight = [&](const dtl::elemInfo &info, ColorGroup hi,
-                          ColorGroup def) {
-        const boost::string_ref sr = rWords[info.afterIdx - 1];
-        cc.append(boost::string_ref(lastR, sr.data() - lastR), &node, def);
-        cc.append(sr, &node, hi);
-        lastR = sr.data() + sr.size();
+        last = sr.data() + sr.size();
     };
 
     // Unchanged parts are highlighted using this color group.
@@ -565,33 +768,26 @@ Highlighter::diffSpelling(const Node &node, bool moved)
         def = ColorGroup::Moved;
     }
 
-    for (const auto &x : diff.getSes().getSequence()) {
-        switch (x.second.type) {
-            case dtl::SES_DELETE:
+    using Edit = SpellingDiffs::Diff::Edit;
+    for (Edit edit : diff.edits) {
+        switch (edit) {
+            case Edit::Deleted:
                 if (original) {
-                    printLeft(x.second, ColorGroup::PieceDeleted, def);
+                    printWord(ColorGroup::PieceDeleted, def);
                 }
                 break;
-            case dtl::SES_ADD:
+            case Edit::Inserted:
                 if (!original) {
-                    printRight(x.second, ColorGroup::PieceInserted, def);
+                    printWord(ColorGroup::PieceInserted, def);
                 }
                 break;
-            case dtl::SES_COMMON:
-                if (original) {
-                    printLeft(x.second, def, def);
-                } else {
-                    printRight(x.second, def, def);
-                }
+            case Edit::Common:
+                printWord(def, def);
                 break;
         }
     }
 
-    if (original) {
-        cc.append(boost::string_ref(lastL, lastL - l.end()), &node, def);
-    } else {
-        cc.append(boost::string_ref(lastR, lastR - r.end()), &node, def);
-    }
+    cc.append(boost::string_ref(last, last - spelling.end()), &node, def);
     if (surround && printBrackets) {
         cc.append(']', ColorGroup::UpdatedSurroundings);
     }
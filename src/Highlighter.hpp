@@ -19,9 +19,11 @@
 
 #include <cstdint>
 
+#include <map>
 #include <memory>
 #include <stack>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/utility/string_ref.hpp>
@@ -34,10 +36,36 @@ class Language;
 class Node;
 class Tree;
 
+// Storage of results of diffing spelling of updated nodes.  Can be shared by
+// highlighters of both versions of a file to diff each pair of nodes only
+// once.  Trees must outlive the storage.
+class SpellingDiffs
+{
+    friend class Highlighter;
+
+    struct Diff;
+
+public:
+    // Constructs empty storage.
+    SpellingDiffs();
+    // Destructs the storage.
+    ~SpellingDiffs();
+
+private:
+    // Retrieves diff of the pair of nodes computing it on the first request.
+    const Diff & get(const Node &l, const Node &r, bool surround);
+
+private:
+    // Maps pair of original and updated nodes to their diff.
+    std::map<std::pair<const Node *, const Node *>,
+             std::unique_ptr<Diff>> diffs;
+};
+
 // Tree highlighter.  Highlights either all at once or by line ranges.
 class Highlighter
 {
     class ColorPicker;
+    struct Checkpoint;
 
     // Single processing entry.
     struct Entry
@@ -64,6 +92,10 @@ public:
     Highlighter(const Node &root, const Language &lang, bool original = true,
                 int lineOffset = 1);
 
+    // Same as above, but highlights sequence of sibling subtrees.
+    Highlighter(const std::vector<Node *> &nodes, const Language &lang,
+                bool original = true, int lineOffset = 1);
+
     // No copying.
     Highlighter(const Highlighter&) = delete;
     // No assigning.
@@ -73,9 +105,10 @@ public:
     virtual ~Highlighter();
 
 private:
-    // Common implementation of two public constructors.
-    Highlighter(const Node &root, const Language &lang, bool original,
-                int lineOffset, int colOffset);
+    // Common implementation of public constructors, which leaves nothing to
+    // process.
+    Highlighter(const Language &lang, bool original, int lineOffset,
+                int colOffset);
 
 public:
     // Specifies whether nodes should be labeled with references to identify
@@ -87,17 +120,31 @@ public:
     // Specifies whether unchanged parts diffables should have their original
     // color.  If not, they are colored as `PieceUpdated`.  On by default.
     void setTransparentDiffables(bool transparent);
-
-    // Prints lines in the range [from, from + n).  Each line can be printed at
-    // most once, thus calls to this function need to increase `from` argument.
+    // Specifies storage for results of diffing spelling of updated nodes.  By
+    // default each highlighter has storage of its own.
+    void setSpellingDiffs(std::shared_ptr<SpellingDiffs> diffs);
+    // Retrieves number of columns by which lines are shifted to the left to
+    // get rid of unnecessary indentation.
+    int getLeftShift() const;
+
+    // Prints lines in the range [from, from + n).  Lines can be requested in
+    // any order, but sequential calls are the cheapest.
     ColorCane print(int from, int n);
 
     // Prints lines until the end.
     ColorCane print();
 
 private:
-    // Skips everything until target line is reached.
+    // Skips everything until target line is reached recording checkpoints on
+    // the way.
     void skipUntil(int targetLine);
+    // Skips everything until target line is reached.
+    void skipTo(int targetLine);
+    // Remembers current state, which must be at the beginning of a line.
+    void saveCheckpoint();
+    // Restores state from the closest checkpoint at or before the line if it's
+    // closer than the current state.
+    void restoreCheckpoint(int targetLine);
     // Prints at most `n` lines.
     void print(int n);
     // Prints lines of spelling decreasing `n` on advancing through lines.
@@ -121,6 +168,8 @@ private:
     std::vector<boost::string_ref> olines;    // Undiffed spelling.
     std::vector<ColorCane> lines;             // Possibly diffed spelling.
     std::stack<Entry> toProcess;              // State of tree traversal.
+    std::vector<std::unique_ptr<Checkpoint>>  // Saved states at every
+        checkpoints;                          // checkpointStep-th line.
     bool original;                            // Whether this is an old version.
     const Node *current;                      // Node that's being processed.
     std::unordered_map<const Node *,          // Maps original updated node to
@@ -129,6 +178,8 @@ private:
     bool printBrackets;                       // Bracket diffed identifiers.
     bool transparentDiffables;                // Leave unchanged parts of
                                               // diffables with original color.
+    std::shared_ptr<SpellingDiffs>            // Cache of diffs of
+        spellingDiffs;                        // updated spellings.
 };
 
 #endif // ZOGRASCOPE_HIGHLIGHTER_HPP_
@@ -22,6 +22,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -38,6 +39,8 @@ namespace fs = boost::filesystem;
 
 using boost::algorithm::to_lower_copy;
 
+static std::string resolveLanguage(const std::string &fileName,
+                                   const std::string &lang);
 static std::string simplifyLanguage(const std::string &lang);
 static std::string detectLanguage(const std::string &stem,
                                   const std::string &ext);
@@ -45,20 +48,7 @@ static std::string detectLanguage(const std::string &stem,
 std::unique_ptr<Language>
 Language::create(const std::string &fileName, const std::string &l)
 {
-    std::string lang = l;
-    if (lang.empty()) {
-        fs::path path = fileName;
-
-        lang = detectLanguage(to_lower_copy(path.stem().string()),
-                              to_lower_copy(path.extension().string()));
-
-        if (lang.empty()) {
-            // Assume C by default.
-            lang = "c";
-        }
-    }
-
-    lang = simplifyLanguage(lang);
+    const std::string lang = resolveLanguage(fileName, l);
 
     if (lang == "c") {
         return std::unique_ptr<C11Language>(new C11Language());
@@ -78,6 +68,30 @@ Language::create(const std::string &fileName, const std::string &l)
     throw std::runtime_error("Unknown language: \"" + lang + '"');
 }
 
+void
+Language::prefetch(const std::vector<std::string> &fileNames,
+                   const std::vector<std::string> &langs)
+{
+    std::vector<std::string> cxxFiles;
+    for (std::size_t i = 0U; i < fileNames.size(); ++i) {
+        if (resolveLanguage(fileNames[i], langs[i]) == "cxx") {
+            cxxFiles.push_back(fileNames[i]);
+        }
+    }
+
+    // Other parsers are in-process and gain nothing from parsing in bulk.
+    if (!cxxFiles.empty()) {
+        SrcmlCxxLanguage::prefetch(cxxFiles);
+    }
+}
+
+bool
+Language::canPrefetch(const std::string &fileName, const std::string &lang)
+{
+    return resolveLanguage(fileName, lang) == "cxx"
+        && SrcmlCxxLanguage::canPrefetch();
+}
+
 bool
 Language::matches(const std::string &fileName, const std::string &lang)
 {
@@ -105,6 +119,26 @@ Language::equal(const std::string &langA, const std::string &langB)
         && simplifyLanguage(langA) == simplifyLanguage(langB);
 }
 
+// Determines language of a file in the form used by `create()`.
+static std::string
+resolveLanguage(const std::string &fileName, const std::string &l)
+{
+    std::string lang = l;
+    if (lang.empty()) {
+        fs::path path = fileName;
+
+        lang = detectLanguage(to_lower_copy(path.stem().string()),
+                              to_lower_copy(path.extension().string()));
+
+        if (lang.empty()) {
+            // Assume C by default.
+            lang = "c";
+        }
+    }
+
+    return simplifyLanguage(lang);
+}
+
 // Removes parser prefixes from language ids or does nothing.
 static std::string
 simplifyLanguage(const std::string &lang)
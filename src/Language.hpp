@@ -17,10 +17,13 @@
 #ifndef ZOGRASCOPE_LANGUAGE_HPP_
 #define ZOGRASCOPE_LANGUAGE_HPP_
 
+#include <boost/utility/string_ref.hpp>
+
 #include <cstdint>
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace cpp17 {
     namespace pmr {
@@ -44,6 +47,15 @@ public:
     // `std::runtime_error` on incorrect language name.
     static std::unique_ptr<Language> create(const std::string &fileName,
                                             const std::string &lang = {});
+    // Hints that files are about to be parsed, which lets languages parse
+    // them ahead of time.  `langs` correspond to `fileNames` and have the
+    // same meaning as `lang` parameter of `create()`.
+    static void prefetch(const std::vector<std::string> &fileNames,
+                         const std::vector<std::string> &langs);
+    // Checks whether prefetch() does anything for the file.  `lang` has the
+    // same meaning as for `create()`.
+    static bool canPrefetch(const std::string &fileName,
+                            const std::string &lang);
     // Checks whether file matches given language.  When `lang` is an empty
     // string any of supported languages is considered a match.
     static bool matches(const std::string &fileName, const std::string &lang);
@@ -58,7 +70,7 @@ public:
     // Maps language-specific token to an element of Type enumeration.
     virtual Type mapToken(int token) const = 0;
     // Parses source file into a tree.
-    virtual TreeBuilder parse(const std::string &contents,
+    virtual TreeBuilder parse(boost::string_ref contents,
                               const std::string &fileName,
                               int tabWidth,
                               bool debug,
@@ -105,6 +117,8 @@ public:
     virtual bool isSatellite(SType stype) const = 0;
     // Maps language-specific stype to generic mtype.
     virtual MType classify(SType stype) const = 0;
+    // Checks whether value belongs to SType enumeration of the language.
+    virtual bool isValidSType(SType stype) const = 0;
     // Stringifies value of SType enumeration.
     virtual const char * toString(SType stype) const = 0;
 
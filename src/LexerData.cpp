@@ -34,7 +34,8 @@ LexerData::readInput(char buf[], std::size_t maxSize)
     char *end = std::copy_n(next, count, buf);
     const std::size_t copied = end - buf;
 
-    if (next[copied] == '\0') {
+    // Input isn't necessarily null-terminated, hence the check against its end.
+    if (next + copied == finish) {
         next = (next == trailing ? nullptr : trailing);
         finish = (next == nullptr ? nullptr : next + std::strlen(next));
     } else {
@@ -17,9 +17,9 @@
 #ifndef ZOGRASCOPE_LEXERDATA_HPP_
 #define ZOGRASCOPE_LEXERDATA_HPP_
 
-#include <cstddef>
+#include <boost/utility/string_ref.hpp>
 
-#include <string>
+#include <cstddef>
 
 class TreeBuilder;
 
@@ -29,7 +29,7 @@ struct LexerData
     const char *contents;
     int tabWidth;
 
-    LexerData(const std::string &str, int tabWidth, TreeBuilder &tb)
+    LexerData(boost::string_ref str, int tabWidth, TreeBuilder &tb)
         : tb(&tb), contents(str.data()), tabWidth(tabWidth), next(contents),
           finish(str.data() + str.size())
     {
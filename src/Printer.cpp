@@ -18,6 +18,7 @@
 
 #include <functional>
 #include <iomanip>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <utility>
@@ -35,6 +36,27 @@
 #include "tree.hpp"
 #include "tree-edit-distance.hpp"
 
+// Calculates width of a string ignoring embedded escape sequences.
+static int
+measureWidth(boost::string_ref s)
+{
+    int valWidth = 0;
+    while (!s.empty()) {
+        if (s.front() != '\033') {
+            ++valWidth;
+            s.remove_prefix(1);
+            continue;
+        }
+
+        const auto width = s.find('m');
+        if (width == std::string::npos) {
+            break;
+        }
+        s.remove_prefix(width + 1U);
+    }
+    return valWidth;
+}
+
 namespace {
 
 class LayoutBuilder;
@@ -46,8 +68,7 @@ class Layout
 
 private:
     // Reference to the builder is saved, so it should outlive layout.
-    explicit Layout(const LayoutBuilder &builder,
-                    std::vector<int> &&leftWidths);
+    explicit Layout(const LayoutBuilder &builder);
 
 public:
     // Retrieves width of a marker used in left part of header line.
@@ -76,9 +97,9 @@ public:
     int getMaxRightWidth() const { return maxRightWidth; }
 
     // Retrieves width for string on the left.
-    int getLeftWidth(boost::string_ref ll, int idx) const
+    int getLeftWidth(boost::string_ref ll) const
     {
-        const int extraWidth = ll.size() - leftWidths[idx];
+        const int extraWidth = ll.size() - measureWidth(ll);
         if (rightVisible) {
             return maxLeftWidth + extraWidth;
         }
@@ -130,7 +151,7 @@ private:
     }
 
 private:
-    bool leftVisible, rightVisible;
+    bool leftVisible = true, rightVisible = true;
     int maxLeftWidth, maxRightWidth;
     int leftNumWidth, rightNumWidth;
 
@@ -141,8 +162,6 @@ private:
 
     int wholeWidth, usefulWidth;
     int leftWidth, rightWidth;
-
-    std::vector<int> leftWidths;
 };
 
 // Collects information needed to compute layout.
@@ -151,9 +170,21 @@ class LayoutBuilder
     friend class Layout;
 
 public:
+    // Starts computing layout of headers alone.
+    explicit LayoutBuilder(const std::vector<Header> &headers)
+    {
+        for (const Header &hdr : headers) {
+            maxLeftHeaderWidth = std::max<int>(hdr.left.size(),
+                                               maxLeftHeaderWidth);
+            maxRightHeaderWidth = std::max<int>(hdr.right.size(),
+                                                maxRightHeaderWidth);
+        }
+    }
+
     // Starts computing layout by analyzing headers and contents of parts.
     LayoutBuilder(const DiffSource &lsrc, const DiffSource &rsrc,
                   const std::vector<Header> &headers)
+        : LayoutBuilder(headers)
     {
         leftVisible = std::find(lsrc.modified.cbegin(), lsrc.modified.cend(),
                                 true) != lsrc.modified.cend();
@@ -164,13 +195,6 @@ public:
             leftVisible = true;
             rightVisible = true;
         }
-
-        for (const Header &hdr : headers) {
-            maxLeftHeaderWidth = std::max<int>(hdr.left.size(),
-                                               maxLeftHeaderWidth);
-            maxRightHeaderWidth = std::max<int>(hdr.right.size(),
-                                                maxRightHeaderWidth);
-        }
     }
 
 public:
@@ -187,23 +211,17 @@ public:
     }
 
     // Records width of a line on the left part.
-    void measureLeft(const std::string &line)
+    void measureLeft(int width)
     {
-        if (!leftVisible) {
-            leftWidths.push_back(0);
-            return;
+        if (leftVisible) {
+            maxLeftWidth = std::max(width, maxLeftWidth);
         }
-
-        const int width = measureWidth(line);
-        leftWidths.push_back(width);
-        maxLeftWidth = std::max(width, maxLeftWidth);
     }
 
     // Records width of a line on the right part.
-    void measureRight(const std::string &line)
+    void measureRight(int width)
     {
         if (rightVisible) {
-            const int width = measureWidth(line);
             maxRightWidth = std::max(width, maxRightWidth);
         }
     }
@@ -213,30 +231,7 @@ public:
     {
         maxLeftWidth = std::max(maxLeftWidth, maxLeftHeaderWidth);
         maxRightWidth = std::max(maxRightWidth, maxRightHeaderWidth);
-        return Layout(*this, std::move(leftWidths));
-    }
-
-private:
-    // Calculates width of a string ignoring embedded escape sequences.
-    static unsigned int measureWidth(boost::string_ref s)
-    {
-        // XXX: we actually print lines without formatting and should be able to
-        //      avoid using this function.
-        unsigned int valWidth = 0U;
-        while (!s.empty()) {
-            if (s.front() != '\033') {
-                ++valWidth;
-                s.remove_prefix(1);
-                continue;
-            }
-
-            const auto width = s.find('m');
-            if (width == std::string::npos) {
-                break;
-            }
-            s.remove_prefix(width + 1U);
-        }
-        return valWidth;
+        return Layout(*this);
     }
 
 private:
@@ -245,12 +240,9 @@ private:
     int maxLeftHeaderWidth = 0, maxRightHeaderWidth = 0;
     int maxLeftWidth = 0, maxRightWidth = 0;
     int maxLeftNum = 0, maxRightNum = 0;
-
-    std::vector<int> leftWidths;
 };
 
-Layout::Layout(const LayoutBuilder &builder, std::vector<int> &&leftWidths)
-    : leftWidths(std::move(leftWidths))
+Layout::Layout(const LayoutBuilder &builder)
 {
     leftVisible = builder.leftVisible;
     rightVisible = builder.rightVisible;
@@ -303,6 +295,16 @@ public:
            << '\n';
     }
 
+    // Prints headers between separators.
+    void printHeaders(const std::vector<Header> &headers)
+    {
+        printSeparator();
+        for (const Header &hdr : headers) {
+            printHeader(hdr);
+        }
+        printSeparator();
+    }
+
     // Prints single header.
     void printHeader(const Header &hdr)
     {
@@ -336,7 +338,7 @@ public:
     // Prints line of the left part.
     void printLeftLine(int lineNum, boost::string_ref str)
     {
-        const int width = layout.getLeftWidth(str, leftWidthIndex++);
+        const int width = layout.getLeftWidth(str);
         printLine(lineNum, str, layout.getLeftNumWidth(), width);
     }
 
@@ -414,8 +416,6 @@ private:
     ColorScheme cs;
     // Line number style.
     decor::Decoration lineNo = cs[ColorGroup::LineNo];
-    // Next line index of the left part (needed to correct maximum width).
-    int leftWidthIndex = 0;
 };
 
 }
@@ -441,6 +441,12 @@ Printer::addHeader(Header header)
     headers.emplace_back(std::move(header));
 }
 
+void
+Printer::setStreaming(bool streaming)
+{
+    this->streaming = streaming;
+}
+
 void
 Printer::print(TimeReport &tr)
 {
@@ -456,18 +462,46 @@ Printer::print(TimeReport &tr)
 
     TermHighlighter lh(left, lang, true);
     TermHighlighter rh(right, lang, false);
-    std::vector<std::string> l(lsrc.lines.size());
-    std::vector<std::string> r(rsrc.lines.size());
+    // Each pair of updated nodes is diffed once for both sides.
+    auto spellingDiffs = std::make_shared<SpellingDiffs>();
+    lh.setSpellingDiffs(spellingDiffs);
+    rh.setSpellingDiffs(spellingDiffs);
+    // Rendered lines, which are kept only when not streaming.
+    std::vector<std::string> l(streaming ? 0U : lsrc.lines.size());
+    std::vector<std::string> r(streaming ? 0U : rsrc.lines.size());
 
     LayoutBuilder layoutBuilder(lsrc, rsrc, headers);
 
-    auto annotate = [](std::string &str,
-                       const std::vector<std::string> &annots,
-                       std::size_t index) {
+    auto render = [](TermHighlighter &hi, bool visible,
+                     const std::vector<std::string> &annots,
+                     std::size_t index) {
+        if (!visible) {
+            return std::string();
+        }
+
+        std::string str = hi.print(index + 1, 1);
         if (index < annots.size()) {
             str.insert(str.begin(),
                        annots[index].cbegin(), annots[index].cend());
         }
+        return str;
+    };
+    auto renderLeft = [&](std::size_t index) {
+        return render(lh, layoutBuilder.isLeftVisible(), leftAnnots, index);
+    };
+    auto renderRight = [&](std::size_t index) {
+        return render(rh, layoutBuilder.isRightVisible(), rightAnnots, index);
+    };
+
+    // Estimates width of a line from its source without highlighting it.
+    auto sourceWidth = [](const DiffSource &src, const TermHighlighter &hi,
+                          const std::vector<std::string> &annots,
+                          std::size_t index) {
+        const int size = src.lines[index].text.str().size();
+        const int textWidth = std::max(size - hi.getLeftShift(), 0);
+        return (index < annots.size())
+             ? measureWidth(annots[index]) + textWidth
+             : textWidth;
     };
 
     unsigned int i = 0U, j = 0U;
@@ -479,18 +513,22 @@ Printer::print(TimeReport &tr)
         }
 
         if (d.type != Diff::Right) {
-            if (layoutBuilder.isLeftVisible()) {
-                l[i] = lh.print(i + 1, 1);
-                annotate(l[i], leftAnnots, i);
+            if (streaming) {
+                layoutBuilder.measureLeft(sourceWidth(lsrc, lh, leftAnnots, i));
+            } else {
+                l[i] = renderLeft(i);
+                layoutBuilder.measureLeft(measureWidth(l[i]));
             }
-            layoutBuilder.measureLeft(l[i++]);
+            ++i;
         }
         if (d.type != Diff::Left) {
-            if (layoutBuilder.isRightVisible()) {
-                r[j] = rh.print(j + 1, 1);
-                annotate(r[j], rightAnnots, j);
+            if (streaming) {
+                layoutBuilder.measureRight(sourceWidth(rsrc, rh, rightAnnots, j));
+            } else {
+                r[j] = renderRight(j);
+                layoutBuilder.measureRight(measureWidth(r[j]));
             }
-            layoutBuilder.measureRight(r[j++]);
+            ++j;
         }
 
         // Record last non-folded indices.
@@ -500,11 +538,16 @@ Printer::print(TimeReport &tr)
     Layout layout = layoutBuilder.compute();
     Outliner outliner(os, layout);
 
-    outliner.printSeparator();
-    for (const Header &hdr : headers) {
-        outliner.printHeader(hdr);
-    }
-    outliner.printSeparator();
+    outliner.printHeaders(headers);
+
+    // Storage for lines rendered while streaming.
+    std::string lbuf, rbuf;
+    auto getLeft = [&](std::size_t index) -> boost::string_ref {
+        return streaming ? (lbuf = renderLeft(index)) : l[index];
+    };
+    auto getRight = [&](std::size_t index) -> boost::string_ref {
+        return streaming ? (rbuf = renderRight(index)) : r[index];
+    };
 
     i = 0U;
     j = 0U;
@@ -514,14 +557,16 @@ Printer::print(TimeReport &tr)
         ColorGroup markerColor = ColorGroup::None;
 
         switch (d.type) {
-            case Diff::Left:      ll = l[i++];              marker = '-';
+            case Diff::Left:      ll = getLeft(i++);    marker = '-';
                                   markerColor = ColorGroup::Deleted;
                                   break;
-            case Diff::Right:                  rl = r[j++]; marker = '+';
+            case Diff::Right:     rl = getRight(j++);   marker = '+';
                                   markerColor = ColorGroup::Inserted;
                                   break;
-            case Diff::Identical: ll = l[i++]; rl = r[j++]; marker = '|'; break;
-            case Diff::Different: ll = l[i++]; rl = r[j++]; marker = '~';
+            case Diff::Identical: ll = getLeft(i++);
+                                  rl = getRight(j++);   marker = '|'; break;
+            case Diff::Different: ll = getLeft(i++);
+                                  rl = getRight(j++);   marker = '~';
                                   markerColor = ColorGroup::Updated;
                                   break;
 
@@ -561,3 +606,11 @@ Printer::print(TimeReport &tr)
         outliner.nextLine();
     }
 }
+
+void
+Printer::printHeaders(const std::vector<Header> &headers, std::ostream &os)
+{
+    LayoutBuilder layoutBuilder(headers);
+    Layout layout = layoutBuilder.compute();
+    Outliner(os, layout).printHeaders(headers);
+}
@@ -50,15 +50,25 @@ public:
 public:
     // Adds table header.
     void addHeader(Header header);
+    // Enables printing lines as soon as they are highlighted instead of
+    // formatting whole output beforehand.  Widths of columns are then derived
+    // from source text, so textual markers used without decorations make
+    // changed lines wider than their columns.
+    void setStreaming(bool streaming);
     // Performs printing.
     void print(TimeReport &tr);
 
+    // Prints only table headers as they would appear for two empty trees.
+    static void printHeaders(const std::vector<Header> &headers,
+                             std::ostream &os);
+
 private:
     const Node &left, &right;                         // Tree roots.
     std::vector<std::string> leftAnnots, rightAnnots; // Annotations.
     const Language &lang;                             // Language of the trees.
     std::ostream &os;                                 // Output stream.
     std::vector<Header> headers;                      // Table headers.
+    bool streaming = false;                           // Don't buffer output.
 };
 
 #endif // ZOGRASCOPE_PRINTER_HPP_
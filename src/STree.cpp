@@ -16,43 +16,43 @@
 
 #include "STree.hpp"
 
-#include <deque>
+#include <algorithm>
 #include <iostream>
 #include <utility>
-#include <vector>
 
-#include "utils/Pool.hpp"
 #include "utils/trees.hpp"
 #include "Language.hpp"
 #include "decoration.hpp"
 
-static void print(const PNode *node, const std::string &contents,
+static void print(const PNode *node, boost::string_ref contents,
                   Language &lang);
-static PNode * findSNode(PNode *node);
-static SNode * makeSNode(Pool<SNode> &snodes, const std::string &contents,
-                         Language &lang, PNode *pnode, bool dumpUnclear);
+static void printUnclear(const PNode *node, boost::string_ref contents,
+                         Language &lang);
 
-STree::STree(TreeBuilder &&ptree, const std::string &contents, bool dumpWhole,
-             bool dumpUnclear, Language &lang, cpp17::pmr::monolithic &mr)
-    : ptree(std::move(ptree)), pool(&mr)
+STree::STree(TreeBuilder &&ptree, boost::string_ref contents, bool dumpWhole,
+             bool dumpUnclear, Language &lang)
+    : ptree(std::move(ptree))
 {
-    PNode *proot = ptree.getRoot();
+    const PNode *proot = this->ptree.getRoot();
 
     if (dumpWhole) {
         print(proot, contents, lang);
     }
 
-    PNode *rootNode = findSNode(proot);
+    const PNode *rootNode = findSNode(proot);
     if (rootNode == nullptr) {
-        root = pool.make(proot);
+        root = proot;
         return;
     }
 
-    root = makeSNode(pool, contents, lang, rootNode, dumpUnclear);
+    root = rootNode;
+    if (dumpUnclear) {
+        printUnclear(root, contents, lang);
+    }
 }
 
 static void
-print(const PNode *node, const std::string &contents, Language &lang)
+print(const PNode *node, boost::string_ref contents, Language &lang)
 {
     using namespace decor;
     using namespace decor::literals;
@@ -73,43 +73,46 @@ print(const PNode *node, const std::string &contents, Language &lang)
     });
 }
 
-static PNode *
-findSNode(PNode *node)
+// Prints children of SNodes which don't contain SNodes.
+static void
+printUnclear(const PNode *node, boost::string_ref contents, Language &lang)
 {
-    if (node->stype != SType{}) {
-        return node;
+    if (STree::isLeaf(node)) {
+        return;
     }
 
-    return node->children.size() == 1U
-         ? findSNode(node->children.front())
-         : nullptr;
+    for (const PNode *child : node->children) {
+        if (const PNode *schild = STree::findSNode(child)) {
+            printUnclear(schild, contents, lang);
+        } else {
+            print(child, contents, lang);
+        }
+    }
 }
 
-static SNode *
-makeSNode(Pool<SNode> &pool, const std::string &contents, Language &lang,
-          PNode *pnode, bool dumpUnclear)
+const PNode *
+STree::findSNode(const PNode *node)
 {
-    SNode *snode = pool.make(pnode);
-
-    auto isSNode = [](PNode *child) {
-        return (findSNode(child) != nullptr);
-    };
-    // If none of the children is SNode, then current node is a leaf SNode.
-    if (std::none_of(pnode->children.begin(), pnode->children.end(), isSNode)) {
-        return snode;
+    while (node->stype == SType{}) {
+        if (node->children.size() != 1U) {
+            return nullptr;
+        }
+        node = node->children.front();
     }
+    return node;
+}
 
-    cpp17::pmr::vector<SNode *> &c = snode->children;
-    c.reserve(pnode->children.size());
-    for (PNode *child : pnode->children) {
-        if (PNode *schild = findSNode(child)) {
-            c.push_back(makeSNode(pool, contents, lang, schild, dumpUnclear));
-        } else {
-            if (dumpUnclear) {
-                print(child, contents, lang);
-            }
-            c.push_back(pool.make(pnode->children[c.size()]));
-        }
+bool
+STree::isLeaf(const PNode *node)
+{
+    // Nodes without SType are leaves of the coarse tree.
+    if (node->stype == SType{}) {
+        return true;
     }
-    return snode;
+
+    auto isSNode = [](const PNode *child) {
+        return (findSNode(child) != nullptr);
+    };
+    return std::none_of(node->children.cbegin(), node->children.cend(),
+                        isSNode);
 }
@@ -17,53 +17,48 @@
 #ifndef ZOGRASCOPE_STREE_HPP_
 #define ZOGRASCOPE_STREE_HPP_
 
-#include <string>
+#include <boost/utility/string_ref.hpp>
 
-#include "pmr/pmr_vector.hpp"
-
-#include "utils/Pool.hpp"
 #include "TreeBuilder.hpp"
 
-namespace cpp17 {
-    namespace pmr {
-        class monolithic;
-    }
-}
-
 class Language;
 
-struct SNode
-{
-    using allocator_type = cpp17::pmr::polymorphic_allocator<cpp17::byte>;
-
-    SNode(PNode *value, allocator_type al = {})
-        : value(value), children(al)
-    {
-    }
-
-    PNode *value;
-    cpp17::pmr::vector<SNode *> children;
-};
-
+// Coarse view of a parse tree.  Its nodes (SNodes) are nodes of the parse tree
+// that have SType along with leaves which don't contain any SNodes.  The view
+// isn't stored anywhere, Tree walks the parse tree directly using functions
+// below.
 class STree
 {
 public:
-    STree(TreeBuilder &&ptree, const std::string &contents,
-          bool dumpWhole, bool dumpUnclear, Language &lang,
-          cpp17::pmr::monolithic &mr);
+    STree(TreeBuilder &&ptree, boost::string_ref contents,
+          bool dumpWhole, bool dumpUnclear, Language &lang);
 
     STree(const STree &rhs) = delete;
     STree(STree &&rhs) = delete;
     STree & operator=(const STree &rhs) = delete;
-    STree & operator=(STree &&rhs) = default;
+    STree & operator=(STree &&rhs) = delete;
 
 public:
-    SNode * getRoot() { return root; }
+    // Retrieves root SNode.
+    const PNode * getRoot() const { return root; }
+
+    // Finds SNode that corresponds to the node or returns `nullptr` if there
+    // is no such node.
+    static const PNode * findSNode(const PNode *node);
+
+    // Checks whether SNode has no SNode children.
+    static bool isLeaf(const PNode *node);
+
+    // Retrieves SNode that corresponds to the child of a non-leaf SNode.
+    static const PNode * getChild(const PNode *child)
+    {
+        const PNode *schild = findSNode(child);
+        return (schild == nullptr ? child : schild);
+    }
 
 private:
     TreeBuilder ptree;
-    Pool<SNode> pool;
-    SNode *root;
+    const PNode *root;
 };
 
 #endif // ZOGRASCOPE_STREE_HPP_
@@ -33,10 +33,12 @@ public:
     using Highlighter::setPrintReferences;
     using Highlighter::setPrintBrackets;
     using Highlighter::setTransparentDiffables;
+    using Highlighter::setSpellingDiffs;
+    using Highlighter::getLeftShift;
 
-    // Prints lines in the range [from, from + n) into a string.  Each line can
-    // be printed at most once, thus calls to this function need to increase
-    // `from` argument.  Returns the string.
+    // Prints lines in the range [from, from + n) into a string.  Lines can be
+    // requested in any order, but sequential calls are the cheapest.  Returns
+    // the string.
     std::string print(int from, int n);
     // Prints lines until the end into a string.  Returns the string.
     std::string print();
@@ -80,9 +80,9 @@ struct PNode
     }
 
     // Finds the leftmost child of the subtree defined by this node.
-    PNode * leftmostChild()
+    const PNode * leftmostChild() const
     {
-        PNode *node = this;
+        const PNode *node = this;
         while (!node->children.empty()) {
             node = node->children.front();
         }
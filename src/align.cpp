@@ -18,11 +18,13 @@
 
 #include <algorithm>
 #include <deque>
+#include <map>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/utility/string_ref.hpp>
-#include "dtl/dtl.hpp"
 
 #include "utils/CountIterator.hpp"
 #include "utils/strings.hpp"
@@ -46,7 +48,7 @@ DiffSource::DiffSource(const Node &root)
             if (node.next != nullptr) {
                 forceChanged |= (node.moved || node.state != State::Unchanged);
                 n = (node.next->last ? &node : nullptr);
-                relative = (node.relative != nullptr ? node.relative : nullptr);
+                relative = node.relative;
                 return run(*node.next, forceChanged, n, relative);
             }
 
@@ -111,6 +113,358 @@ DiffSource::DiffSource(const Node &root)
     }
 }
 
+namespace {
+
+// Line along with starts of its non-null nodes and relatives, which are found
+// once instead of on every comparison.
+struct ComparedLine
+{
+    using Iterator = std::vector<const Node *>::const_iterator;
+
+    explicit ComparedLine(LineInfo &info)
+        : info(&info), nodes(skipNulls(info.nodes)), rels(skipNulls(info.rels))
+    { }
+
+    // Finds first non-null element of a sorted vector.
+    static Iterator skipNulls(const std::vector<const Node *> &v)
+    {
+        return std::find_if(v.cbegin(), v.cend(), [](const Node *n) {
+            return (n != nullptr);
+        });
+    }
+
+    LineInfo *info; // The line.
+    Iterator nodes; // First non-null node.
+    Iterator rels;  // First non-null relative.
+};
+
+// Checks whether line of the left source corresponds to line of the right one.
+bool
+compareLines(const ComparedLine &l, const ComparedLine &r)
+{
+    LineInfo &a = *l.info;
+    LineInfo &b = *r.info;
+
+    int all = a.rels.size() + b.nodes.size();
+    if (all == 0) {
+        // Match empty lines.
+        return true;
+    }
+
+    auto aRels = l.rels;
+    auto bRels = r.rels;
+    auto bNodes = r.nodes;
+
+    int matched = std::set_intersection(aRels, a.rels.cend(),
+                                        bNodes, b.nodes.cend(),
+                                        CountIterator()).getCount();
+    int total = (a.rels.cend() - aRels) + (b.nodes.cend() - bNodes);
+    // XXX: hard-coded thresholds.
+    return false
+        // Check for matched tokens first.
+        || (total != 0 && 2.0f*matched/total >= 0.6f)
+        // Check for complete replacement of tokens which look alike a bit.
+        || (matched == 0 &&
+            aRels == a.rels.cend() && bRels == b.rels.cend() &&
+            !a.nodes.empty() && !b.nodes.empty() &&
+            a.text.compare(b.text) >= 0.4f)
+        // Resort to text based comparison for small total number of tokens
+        // unless one of lines contains only removed/added tokens (first
+        // condition).
+        || ((aRels == a.rels.cend()) == (bRels == b.rels.cend()) &&
+            all > 2 && all < 7 && a.text.compare(b.text) >= 0.8f);
+}
+
+// Finds matching lines of two sources.  Unchanged lines that correspond only to
+// each other serve as anchors, which leaves only gaps between them to be
+// aligned by linear-space version of Myers' algorithm.  Lines are prepared for
+// comparison upfront, because the algorithm compares some pairs repeatedly.
+class LineAligner
+{
+    using Match = std::pair<int, int>;
+
+public:
+    // Remembers sources.  Expects rels of left lines and nodes of right lines
+    // to be sorted.
+    LineAligner(DiffSource &l, DiffSource &r)
+        : lt(l.lines), rt(r.lines), lm(l.modified), rm(r.modified)
+    {
+        lc.reserve(lt.size());
+        for (LineInfo &line : lt) {
+            lc.emplace_back(line);
+        }
+        rc.reserve(rt.size());
+        for (LineInfo &line : rt) {
+            rc.emplace_back(line);
+        }
+    }
+
+public:
+    // Computes ordered list of pairs of matched lines.
+    std::vector<Match> align()
+    {
+        matches.clear();
+
+        Match prev(-1, -1);
+        for (const Match &anchor : findAnchors()) {
+            alignRange(prev.first + 1, anchor.first,
+                       prev.second + 1, anchor.second);
+            matches.push_back(anchor);
+            prev = anchor;
+        }
+        alignRange(prev.first + 1, lt.size(), prev.second + 1, rt.size());
+
+        // Pair lines as early as possible to place unmatched lines after
+        // matched ones consistently.
+        prev = Match(-1, -1);
+        for (Match &match : matches) {
+            int &i = match.first;
+            int &j = match.second;
+            for (int k = prev.first + 1; k < i; ++k) {
+                if (same(k, j)) {
+                    i = k;
+                    break;
+                }
+            }
+            for (int k = prev.second + 1; k < j; ++k) {
+                if (same(i, k)) {
+                    j = k;
+                    break;
+                }
+            }
+            prev = match;
+        }
+
+        return std::move(matches);
+    }
+
+private:
+    // Picks longest ordered sequence of pairs of unchanged lines that either
+    // are related only to each other or have text unique on both sides.
+    std::vector<Match> findAnchors()
+    {
+        std::vector<int> ltToRt = mapLines(lt, rt, &LineInfo::rels);
+        std::vector<int> rtToLt = mapLines(rt, lt, &LineInfo::rels);
+
+        // Lines of multiline tokens and of multiline nodes aren't mapped, so
+        // also look for lines whose text occurs only once on each side.
+        std::map<boost::string_ref, Match> occurrences;
+        auto countLines = [&](const std::vector<LineInfo> &lines, bool left) {
+            for (int i = 0; i < static_cast<int>(lines.size()); ++i) {
+                if (lines[i].text.str().empty()) {
+                    continue;
+                }
+
+                Match &m = occurrences.emplace(lines[i].text.str(),
+                                               Match(-1, -1)).first->second;
+                int &idx = (left ? m.first : m.second);
+                idx = (idx == -1 ? i : -2);
+            }
+        };
+        countLines(lt, true);
+        countLines(rt, false);
+
+        for (const auto &entry : occurrences) {
+            const Match &m = entry.second;
+            if (m.first >= 0 && m.second >= 0) {
+                ltToRt[m.first] = m.second;
+                rtToLt[m.second] = m.first;
+            }
+        }
+
+        // Moved lines are left out as they aren't part of any alignment.
+        std::vector<Match> candidates;
+        for (int i = 0; i < static_cast<int>(lt.size()); ++i) {
+            const int j = ltToRt[i];
+            if (j >= 0 && rtToLt[j] == i && !lm[i] && !rm[j] &&
+                lt[i].text.str() == rt[j].text.str() && same(i, j)) {
+                candidates.emplace_back(i, j);
+            }
+        }
+
+        // Patience-like search of the longest increasing subsequence.
+        std::vector<int> tails;
+        std::vector<int> prevs(candidates.size());
+        for (int c = 0; c < static_cast<int>(candidates.size()); ++c) {
+            auto it = std::lower_bound(tails.begin(), tails.end(), c,
+                                       [&](int t, int c) {
+                return candidates[t].second < candidates[c].second;
+            });
+            prevs[c] = (it == tails.begin() ? -1 : *(it - 1));
+            if (it == tails.end()) {
+                tails.push_back(c);
+            } else {
+                *it = c;
+            }
+        }
+
+        std::vector<Match> anchors(tails.size());
+        int c = (tails.empty() ? -1 : tails.back());
+        for (auto it = anchors.rbegin(); c != -1; ++it, c = prevs[c]) {
+            *it = candidates[c];
+        }
+        return anchors;
+    }
+
+    // Maps lines of one source onto lines of the other one by their relations.
+    // Lines that have no relations or are related to several lines are mapped
+    // to -1.
+    static std::vector<int>
+    mapLines(const std::vector<LineInfo> &from,
+             const std::vector<LineInfo> &to,
+             std::vector<const Node *> LineInfo::*rels)
+    {
+        std::unordered_map<const Node *, int> lineOf;
+        for (int i = 0; i < static_cast<int>(to.size()); ++i) {
+            for (const Node *node : to[i].nodes) {
+                auto r = lineOf.emplace(node, i);
+                if (!r.second && r.first->second != i) {
+                    // Nodes spanning several lines are ambiguous.
+                    r.first->second = -1;
+                }
+            }
+        }
+
+        std::vector<int> map(from.size(), -1);
+        for (int i = 0; i < static_cast<int>(from.size()); ++i) {
+            int line = -1;
+            for (const Node *rel : from[i].*rels) {
+                if (rel == nullptr) {
+                    continue;
+                }
+
+                auto it = lineOf.find(rel);
+                int relLine = (it == lineOf.end() ? -1 : it->second);
+                if (relLine == -1 || (line != -1 && relLine != line)) {
+                    line = -1;
+                    break;
+                }
+                line = relLine;
+            }
+            map[i] = line;
+        }
+        return map;
+    }
+
+    // Aligns lines in [a0; a1) of the left source with lines in [b0; b1) of
+    // the right one.
+    void alignRange(int a0, int a1, int b0, int b1)
+    {
+        while (a0 < a1 && b0 < b1 && same(a0, b0)) {
+            matches.emplace_back(a0++, b0++);
+        }
+        int suffix = 0;
+        while (a0 < a1 && b0 < b1 && same(a1 - 1, b1 - 1)) {
+            --a1;
+            --b1;
+            ++suffix;
+        }
+
+        if (a0 < a1 && b0 < b1) {
+            Match split = findSplit(a0, a1, b0, b1);
+            if (split.first != -1) {
+                alignRange(a0, split.first, b0, split.second);
+                alignRange(split.first, a1, split.second, b1);
+            }
+        }
+
+        for (int k = 0; k < suffix; ++k) {
+            matches.emplace_back(a1 + k, b1 + k);
+        }
+    }
+
+    // Finds a point on a shortest edit path from (a0, b0) to (a1, b1) by
+    // running the search from both ends until the paths overlap.  Returns
+    // (-1, -1) if ranges have nothing in common.
+    Match findSplit(int a0, int a1, int b0, int b1)
+    {
+        const int n = a1 - a0;
+        const int m = b1 - b0;
+        const int maxD = (n + m + 1)/2;
+        const int offset = maxD;
+        const int delta = n - m;
+        const bool front = (delta%2 != 0);
+
+        std::vector<int> fwd(2*maxD + 2, -1), bwd(2*maxD + 2, -1);
+        fwd[offset + 1] = 0;
+        bwd[offset + 1] = 0;
+
+        int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+        for (int d = 0; d < maxD; ++d) {
+            for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+                const int k1off = offset + k1;
+                const bool down = (k1 == -d || (k1 != d &&
+                                   fwd[k1off - 1] < fwd[k1off + 1]));
+                int x1 = (down ? fwd[k1off + 1] : fwd[k1off - 1] + 1);
+                int y1 = x1 - k1;
+                while (x1 < n && y1 < m && same(a0 + x1, b0 + y1)) {
+                    ++x1;
+                    ++y1;
+                }
+                fwd[k1off] = x1;
+
+                if (x1 > n) {
+                    k1end += 2;
+                } else if (y1 > m) {
+                    k1start += 2;
+                } else if (front) {
+                    const int k2off = offset + delta - k1;
+                    if (k2off >= 0 && k2off < static_cast<int>(bwd.size()) &&
+                        bwd[k2off] != -1 && x1 >= n - bwd[k2off]) {
+                        return Match(a0 + x1, b0 + y1);
+                    }
+                }
+            }
+
+            for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+                const int k2off = offset + k2;
+                const bool down = (k2 == -d || (k2 != d &&
+                                   bwd[k2off - 1] < bwd[k2off + 1]));
+                int x2 = (down ? bwd[k2off + 1] : bwd[k2off - 1] + 1);
+                int y2 = x2 - k2;
+                while (x2 < n && y2 < m &&
+                       same(a1 - x2 - 1, b1 - y2 - 1)) {
+                    ++x2;
+                    ++y2;
+                }
+                bwd[k2off] = x2;
+
+                if (x2 > n) {
+                    k2end += 2;
+                } else if (y2 > m) {
+                    k2start += 2;
+                } else if (!front) {
+                    const int k1off = offset + delta - k2;
+                    if (k1off >= 0 && k1off < static_cast<int>(fwd.size()) &&
+                        fwd[k1off] != -1 && fwd[k1off] >= n - x2) {
+                        const int x1 = fwd[k1off];
+                        return Match(a0 + x1, b0 + x1 - (k1off - offset));
+                    }
+                }
+            }
+        }
+
+        return Match(-1, -1);
+    }
+
+    // Compares two lines.
+    bool same(int i, int j)
+    {
+        return compareLines(lc[i], rc[j]);
+    }
+
+private:
+    std::vector<LineInfo> &lt;       // Lines of the left source.
+    std::vector<LineInfo> &rt;       // Lines of the right source.
+    const std::vector<bool> &lm;     // Changed lines on the left.
+    const std::vector<bool> &rm;     // Changed lines on the right.
+    std::vector<ComparedLine> lc;    // Left lines prepared for comparison.
+    std::vector<ComparedLine> rc;    // Right lines prepared for comparison.
+    std::vector<Match> matches;      // Result being built.
+};
+
+}
+
 std::vector<DiffLine>
 makeDiff(DiffSource &&l, DiffSource &&r)
 {
@@ -126,46 +480,6 @@ makeDiff(DiffSource &&l, DiffSource &&r)
         std::sort(info.nodes.begin(), info.nodes.end());
     }
 
-    auto cmp = [](LineInfo &a, LineInfo &b) {
-        int all = a.rels.size() + b.nodes.size();
-        if (all == 0) {
-            // Match empty lines.
-            return true;
-        }
-
-        auto skipNulls = [](std::vector<const Node *> &v) {
-            return std::find_if(v.cbegin(), v.cend(), [](const Node *n) {
-                return (n != nullptr);
-            });
-        };
-
-        auto aRels = skipNulls(a.rels);
-        auto bRels = skipNulls(b.rels);
-        auto bNodes = skipNulls(b.nodes);
-
-        int matched = std::set_intersection(aRels, a.rels.cend(),
-                                            bNodes, b.nodes.cend(),
-                                            CountIterator()).getCount();
-        int total = (a.rels.cend() - aRels) + (b.nodes.cend() - bNodes);
-        // XXX: hard-coded thresholds.
-        return false
-            // Check for matched tokens first.
-            || (total != 0 && 2.0f*matched/total >= 0.6f)
-            // Check for complete replacement of tokens which look alike a bit.
-            || (matched == 0 &&
-                aRels == a.rels.cend() && bRels == b.rels.cend() &&
-                !a.nodes.empty() && !b.nodes.empty() &&
-                a.text.compare(b.text) >= 0.4f)
-            // Resort to text based comparison for small total number of tokens
-            // unless one of lines contains only removed/added tokens (first
-            // condition).
-            || ((aRels == a.rels.cend()) == (bRels == b.rels.cend()) &&
-                all > 2 && all < 7 && a.text.compare(b.text) >= 0.8f);
-    };
-
-    dtl::Diff<LineInfo, std::vector<LineInfo>, decltype(cmp)> diff(lt, rt, cmp);
-    diff.compose();
-
     size_type identicalLines = 0U;
     const size_type minFold = 3;
     const size_type ctxSize = 2;
@@ -197,21 +511,23 @@ makeDiff(DiffSource &&l, DiffSource &&r)
         }
     };
 
-    for (const auto &x : diff.getSes().getSequence()) {
-        switch (x.second.type) {
-            case dtl::SES_DELETE:
-                foldIdentical(false);
-                diffSeq.emplace_back(Diff::Left);
-                break;
-            case dtl::SES_ADD:
-                foldIdentical(false);
-                diffSeq.emplace_back(Diff::Right);
-                break;
-            case dtl::SES_COMMON:
-                handleSameLines(x.second.beforeIdx - 1, x.second.afterIdx - 1);
-                break;
+    size_type i = 0U, j = 0U;
+    auto addUnmatched = [&](size_type li, size_type rj) {
+        for (; i < li; ++i) {
+            foldIdentical(false);
+            diffSeq.emplace_back(Diff::Left);
+        }
+        for (; j < rj; ++j) {
+            foldIdentical(false);
+            diffSeq.emplace_back(Diff::Right);
         }
+    };
+
+    for (const std::pair<int, int> &match : LineAligner(l, r).align()) {
+        addUnmatched(match.first, match.second);
+        handleSameLines(i++, j++);
     }
+    addUnmatched(lt.size(), rt.size());
 
     foldIdentical(true);
 
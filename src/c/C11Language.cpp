@@ -152,7 +152,7 @@ C11Language::mapToken(int token) const
 }
 
 TreeBuilder
-C11Language::parse(const std::string &contents, const std::string &fileName,
+C11Language::parse(boost::string_ref contents, const std::string &fileName,
                    int tabWidth, bool debug, cpp17::pmr::monolithic &mr) const
 {
     return c11_parse(contents, fileName, tabWidth, debug, mr);
@@ -357,6 +357,12 @@ C11Language::classify(SType stype) const
     }
 }
 
+bool
+C11Language::isValidSType(SType stype) const
+{
+    return -stype <= C11SType::BundleComma;
+}
+
 const char *
 C11Language::toString(SType stype) const
 {
@@ -32,7 +32,7 @@ public:
     // Maps language-specific token to an element of Type enumeration.
     virtual Type mapToken(int token) const override;
     // Parses source file into a tree.
-    virtual TreeBuilder parse(const std::string &contents,
+    virtual TreeBuilder parse(boost::string_ref contents,
                               const std::string &fileName,
                               int tabWidth,
                               bool debug,
@@ -81,6 +81,7 @@ public:
     // Maps language-specific stype to generic mtype.
     virtual MType classify(SType stype) const override;
     // Stringifies value of SType enumeration.
+    virtual bool isValidSType(SType stype) const override;
     virtual const char * toString(SType stype) const override;
 
 private:
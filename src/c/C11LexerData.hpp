@@ -17,6 +17,8 @@
 #ifndef ZOGRASCOPE_C_C11LEXERDATA_HPP_
 #define ZOGRASCOPE_C_C11LEXERDATA_HPP_
 
+#include <boost/utility/string_ref.hpp>
+
 #include <cstddef>
 #include <cstring>
 
@@ -37,7 +39,7 @@ struct C11LexerData : LexerData
 
     C11ParseData *pd;
 
-    C11LexerData(const std::string &str, int tabWidth, TreeBuilder &tb,
+    C11LexerData(boost::string_ref str, int tabWidth, TreeBuilder &tb,
                  C11ParseData &pd)
         : LexerData(str, tabWidth, tb), pd(&pd)
     { }
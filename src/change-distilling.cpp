@@ -19,6 +19,9 @@
 #include <cmath>
 
 #include <algorithm>
+#include <map>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "utils/strings.hpp"
@@ -28,6 +31,10 @@
 
 static void postOrderAndInit(Node &root, std::vector<Node *> &v);
 static void postOrderAndInitImpl(Node &node, std::vector<Node *> &v);
+static void indexSubtrees(const std::vector<Node *> &po,
+                          std::vector<int> &leftmost,
+                          std::vector<int> &terminals,
+                          std::vector<int> &matched);
 static void clear(Node *node);
 static bool haveValues(const Node *x, const Node *y);
 static bool unmatchedInternal(const Node *node);
@@ -43,33 +50,31 @@ namespace {
 struct descendants_t {} descendants;
 struct subtree_t     {} subtree;
 
-// Represents range of nodes and provides common operations on it.
+// Represents range of nodes in post-order and provides common operations on it.
 class NodeRange
 {
 public:
     // Constructs an empty range.
-    NodeRange() : from(-1), to(-1), po(nullptr)
+    NodeRange() : from(0), to(0)
     {
     }
 
     // Constructs range from all descendants of the node, including the node
-    // itself.
-    NodeRange(subtree_t, const std::vector<Node *> &po, const Node *n)
-        : from(leftmostChild(n)), to(n->poID + 1), po(&po)
+    // itself.  `leftmost` is the result of indexSubtrees().
+    NodeRange(subtree_t, const std::vector<Node *> &po,
+              const std::vector<int> &leftmost, const Node *n)
+        : from(leftmostChild(po, leftmost, n)), to(n->poID + 1)
     {
     }
 
     // Constructs range from all descendants of the node, but not including the
-    // node itself.
-    NodeRange(descendants_t, const std::vector<Node *> &po, const Node *n)
-        : from(leftmostChild(n)), to(n->poID), po(&po)
+    // node itself.  `leftmost` is the result of indexSubtrees().
+    NodeRange(descendants_t, const std::vector<Node *> &po,
+              const std::vector<int> &leftmost, const Node *n)
+        : from(leftmostChild(po, leftmost, n)), to(n->poID)
     {
     }
 
-    // List of nodes must be an lvalue.
-    NodeRange(subtree_t, std::vector<Node *> &&po, const Node *n) = delete;
-    NodeRange(descendants_t, std::vector<Node *> &&po, const Node *n) = delete;
-
 public:
     // Checks whether range includes the node.
     bool includes(const Node *n) const
@@ -77,40 +82,34 @@ public:
         return (n->poID >= from && n->poID < to);
     }
 
-    // Computes number of terminals.
-    int terminalCount() const
-    {
-        return (po == nullptr ? 0 : std::count_if(begin(), end(), &isTerminal));
-    }
-
-    // Retrieves beginning of the range.
-    const Node *const * begin() const
-    {
-        return (po == nullptr ? nullptr : &(*po)[from]);
-    }
-
-    // Retrieves end of the range.
-    const Node *const * end() const
+    // Computes number of elements of the range given prefix sums of some
+    // property of nodes.
+    int count(const std::vector<int> &sums) const
     {
-        return (po == nullptr ? nullptr : &(*po)[to]);
+        return sums[to] - sums[from];
     }
 
 private:
     // Finds id of the leftmost child of the node ignoring satellites.
-    static int leftmostChild(const Node *node)
+    static int leftmostChild(const std::vector<Node *> &po,
+                             const std::vector<int> &leftmost, const Node *n)
     {
-        for (const Node *child : node->children) {
+        if (n->poID >= 0 && n->poID < static_cast<int>(po.size()) &&
+            po[n->poID] == n) {
+            return leftmost[n->poID];
+        }
+
+        // Node that isn't part of the traversal.
+        for (const Node *child : n->children) {
             if (!child->satellite) {
-                return leftmostChild(child);
+                return leftmostChild(po, leftmost, child);
             }
         }
-
-        return node->poID;
+        return n->poID;
     }
 
 private:
-    int from, to;                  // Range defined by from and to ids.
-    const std::vector<Node *> *po; // External storage of nodes in post-order.
+    int from, to; // Range defined by from and to ids.
 };
 
 }
@@ -184,7 +183,11 @@ Distiller::rateTerminalsMatch(const Node *x, const Node *y) const
         }
     }
 
-    if ((xParent ? xParent->relative : nullptr) != yParent) {
+    const Node *xParentRelative = nullptr;
+    if (xParent != nullptr) {
+        xParentRelative = xParent->relative;
+    }
+    if (xParentRelative != yParent) {
         return 0;
     }
 
@@ -267,16 +270,58 @@ Distiller::initialize(Node &T1, Node &T2)
     postOrderAndInit(T1, po1);
     postOrderAndInit(T2, po2);
 
+    // Release storage of bigrams only after strings that use it are gone.
     dice1.clear();
+    dice2.clear();
+    diceMR.reset(new cpp17::pmr::monolithic());
+
     dice1.reserve(po1.size());
     for (Node *x : po1) {
-        dice1.emplace_back(x->label);
+        dice1.emplace_back(x->label, diceMR.get());
     }
 
-    dice2.clear();
     dice2.reserve(po2.size());
     for (Node *x : po2) {
-        dice2.emplace_back(x->label);
+        dice2.emplace_back(x->label, diceMR.get());
+    }
+
+    indexSubtrees(po1, leftmost1, terminals1, matched1);
+    indexSubtrees(po2, leftmost2, terminals2, matched2);
+}
+
+// Computes information about subtrees of nodes in post-order: leftmost
+// non-satellite descendant, prefix sums of number of terminals and number of
+// leaves that were matched before distilling (i.e., are under satellites).
+static void
+indexSubtrees(const std::vector<Node *> &po, std::vector<int> &leftmost,
+              std::vector<int> &terminals, std::vector<int> &matched)
+{
+    const int n = po.size();
+    leftmost.resize(n);
+    terminals.resize(n + 1);
+    matched.resize(n);
+
+    terminals[0] = 0;
+    for (int i = 0; i < n; ++i) {
+        const Node *const node = po[i];
+
+        terminals[i + 1] = terminals[i] + isTerminal(node);
+
+        leftmost[i] = i;
+        matched[i] = 0;
+        bool first = true;
+        for (const Node *child : node->children) {
+            if (child->satellite) {
+                matched[i] += child->fingerprint.leafCount;
+                continue;
+            }
+
+            if (first) {
+                leftmost[i] = leftmost[child->poID];
+                first = false;
+            }
+            matched[i] += matched[child->poID];
+        }
     }
 }
 
@@ -287,6 +332,7 @@ postOrderAndInit(Node &root, std::vector<Node *> &v)
 {
     root.parent = nullptr;
     v.clear();
+    v.reserve(root.fingerprint.size);
     postOrderAndInitImpl(root, v);
 }
 
@@ -329,6 +375,87 @@ clear(Node *node)
 
 std::vector<Distiller::TerminalMatch>
 Distiller::generateTerminalMatches()
+{
+    if (bruteForce) {
+        return generateAllTerminalMatches();
+    }
+
+    // Terminals of the same group.  Forced groups consist of nodes that can
+    // match regardless of their labels, for other groups labels need to be
+    // similar enough, so only candidates found in the index are examined.
+    struct Group
+    {
+        std::vector<Node *> nodes;
+        std::vector<DiceString *> dice;
+        bool forced;
+        std::unique_ptr<DiceIndex> index;
+    };
+
+    // Terminals that can match each other are of the same canonized type and
+    // virtual ones are also of the same SType.
+    auto groupOf = [](const Node *n) {
+        const Type type = canonizeType(n->type);
+        return std::make_pair(type,
+                              type == Type::Virtual ? n->stype : SType{});
+    };
+
+    std::map<std::pair<Type, SType>, Group> groups;
+    for (Node *y : po2) {
+        if (y->children.empty()) {
+            Group &group = groups[groupOf(y)];
+            group.nodes.push_back(y);
+            group.dice.push_back(&dice2[y->poID]);
+        }
+    }
+    for (auto &entry : groups) {
+        Group &group = entry.second;
+        const Node *n = group.nodes.front();
+        group.forced = canForceLeafMatch(n, n);
+        if (!group.forced) {
+            group.index.reset(new DiceIndex(group.dice, 0.6f));
+        }
+    }
+
+    std::vector<TerminalMatch> matches;
+
+    auto tryMatch = [&](Node *x, Node *y) {
+        if (!canMatch(x, y)) {
+            return;
+        }
+
+        const float similarity = dice1[x->poID].compare(dice2[y->poID]);
+        if (similarity >= 0.6f || canForceLeafMatch(x, y)) {
+            matches.push_back({ x, y, similarity });
+        }
+    };
+
+    for (Node *x : po1) {
+        if (!x->children.empty()) {
+            continue;
+        }
+
+        auto it = groups.find(groupOf(x));
+        if (it == groups.end()) {
+            continue;
+        }
+
+        Group &group = it->second;
+        if (group.forced) {
+            for (Node *y : group.nodes) {
+                tryMatch(x, y);
+            }
+        } else {
+            for (int i : group.index->lookup(dice1[x->poID])) {
+                tryMatch(x, group.nodes[i]);
+            }
+        }
+    }
+
+    return matches;
+}
+
+std::vector<Distiller::TerminalMatch>
+Distiller::generateAllTerminalMatches()
 {
     std::vector<TerminalMatch> matches;
 
@@ -357,52 +484,30 @@ Distiller::generateTerminalMatches()
 }
 
 float
-Distiller::childrenSimilarity(const Node *x,
-                              const std::vector<Node *> &po1,
-                              const Node *y,
-                              const std::vector<Node *> &po2) const
+Distiller::childrenSimilarity(const Node *x, const Node *y) const
 {
-    NodeRange xChildren(descendants, po1, x), yChildren(descendants, po2, y);
+    NodeRange xChildren(descendants, po1, leftmost1, x);
+    NodeRange yChildren(descendants, po2, leftmost2, y);
 
     NodeRange xValue, yValue;
     if (haveValues(x, y)) {
-        xValue = NodeRange(descendants, po1, x->getValue());
-        yValue = NodeRange(descendants, po2, y->getValue());
+        xValue = NodeRange(descendants, po1, leftmost1, x->getValue());
+        yValue = NodeRange(descendants, po2, leftmost2, y->getValue());
     }
 
     // Number of common terminal nodes (terminals of unmatched internal nodes
     // are not ignored).
-    int nonValueCommon = 0;
+    int nonValueCommon = yChildren.count(commonSums)
+                       - yValue.count(commonSums);
     // Number of selected common terminal nodes (terminals of unmatched internal
     // nodes are ignored).
-    int selCommon = 0;
-
-    int yLeaves = 0;
-    for (const Node *n : yChildren) {
-        if (!isTerminal(n)) {
-            continue;
-        }
-        ++yLeaves;
-
-        if (n->relative == nullptr || !xChildren.includes(n->relative)) {
-            continue;
-        }
-
-        if (!yValue.includes(n)) {
-            ++nonValueCommon;
-        }
-
-        const Node *const parent = getParent(n);
-        // This might skip children of unmatched internal nodes.
-        if (parent == nullptr || parent->relative != nullptr) {
-            ++selCommon;
-        }
-    }
+    int selCommon = yChildren.count(selCommonSums);
 
-    int xLeaves = xChildren.terminalCount();
+    int xLeaves = xChildren.count(terminals1);
+    int yLeaves = yChildren.count(terminals2);
 
-    const int xExtra = countAlreadyMatched(x);
-    const int yExtra = countAlreadyMatched(y);
+    const int xExtra = matched1[x->poID];
+    const int yExtra = matched2[y->poID];
     selCommon += std::min(xExtra, yExtra);
     xLeaves += xExtra;
     yLeaves += yExtra;
@@ -422,8 +527,8 @@ Distiller::childrenSimilarity(const Node *x,
     // Disregard values only if they aren't matched.
     if (haveValues(x, y) && x->getValue()->relative == nullptr &&
         y->getValue()->relative == nullptr) {
-        xLeaves -= xValue.terminalCount();
-        yLeaves -= yValue.terminalCount();
+        xLeaves -= xValue.count(terminals1);
+        yLeaves -= yValue.count(terminals2);
 
         const int maxLeaves = std::max(xLeaves, yLeaves);
         const float nonValueSim = maxLeaves == 0
@@ -447,40 +552,39 @@ Distiller::getParent(const Node *n) const
     return parent;
 }
 
-int
-Distiller::countAlreadyMatched(const Node *node) const
+void
+Distiller::countCommon(const Node *x)
 {
-    if (node->satellite) {
-        return countAlreadyMatchedLeaves(node);
-    }
+    const NodeRange xChildren(descendants, po1, leftmost1, x);
 
-    int count = 0;
-    for (const Node *child : node->children) {
-        count += countAlreadyMatched(child);
+    NodeRange xValue;
+    if (x->hasValue()) {
+        xValue = NodeRange(subtree, po1, leftmost1, x->getValue());
     }
-    return count;
-}
 
-int
-Distiller::countAlreadyMatchedLeaves(const Node *node) const
-{
-    if (lang.isSatellite(node->stype)) {
-        // We aren't interested in satellites specified by the language, because
-        // they don't participate in comparison.
-        return 0;
-    }
+    const int n = po2.size();
+    commonSums.assign(n + 1, 0);
+    selCommonSums.assign(n + 1, 0);
+    nonValueSums.assign(n + 1, 0);
 
-    if (node->children.empty()) {
-        // We get here only for descendants of non-language-specific satellites
-        // that are themselves aren't such satellites, so count the node.
-        return 1;
-    }
+    for (int i = 0; i < n; ++i) {
+        const Node *const node = po2[i];
+
+        bool isCommon = false, isSelected = false, isNonValue = false;
+        if (isTerminal(node) && node->relative != nullptr &&
+            xChildren.includes(node->relative)) {
+            isCommon = true;
+            isNonValue = !xValue.includes(node->relative);
+
+            const Node *const parent = getParent(node);
+            // This might skip children of unmatched internal nodes.
+            isSelected = (parent == nullptr || parent->relative != nullptr);
+        }
 
-    int count = 0;
-    for (const Node *child : node->children) {
-        count += countAlreadyMatchedLeaves(child);
+        commonSums[i + 1] = commonSums[i] + isCommon;
+        selCommonSums[i + 1] = selCommonSums[i] + isSelected;
+        nonValueSums[i + 1] = nonValueSums[i] + isNonValue;
     }
-    return count;
 }
 
 void
@@ -491,6 +595,9 @@ Distiller::distillInternal()
             continue;
         }
 
+        // Matching state doesn't change until a match for `x` is found.
+        bool counted = false;
+
         for (Node *y : po2) {
             if (!unmatchedInternal(y) || !canMatch(x, y)) {
                 continue;
@@ -515,7 +622,12 @@ Distiller::distillInternal()
                 break;
             }
 
-            const float childrenSim = childrenSimilarity(x, po1, y, po2);
+            if (!counted) {
+                countCommon(x);
+                counted = true;
+            }
+
+            const float childrenSim = childrenSimilarity(x, y);
             if (childrenSim == 0.0f) {
                 continue;
             }
@@ -560,38 +672,26 @@ Distiller::matchPartiallyMatchedInternal(bool excludeValues)
             continue;
         }
 
+        bool counted = false;
+
         for (Node *y : po2) {
             if (!unmatchedInternal(y) || !canMatch(x, y)) {
                 continue;
             }
 
-            NodeRange xChildren(descendants, po1, x);
-            NodeRange yChildren(descendants, po2, y);
-
-            NodeRange xValue, yValue;
-            if (haveValues(x, y)) {
-                xValue = NodeRange(subtree, po1, x->getValue());
-                yValue = NodeRange(subtree, po2, y->getValue());
+            if (!counted) {
+                countCommon(x);
+                counted = true;
             }
 
-            int common = 0;
-            int commonWithValue = 0;
-            for (const Node *n : yChildren) {
-                if (!isTerminal(n)) {
-                    continue;
-                }
-
-                if (n->relative == nullptr) {
-                    continue;
-                }
+            NodeRange yChildren(descendants, po2, leftmost2, y);
 
-                if (xChildren.includes(n->relative)) {
-                    if (!yValue.includes(n) &&
-                        !xValue.includes(n->relative)) {
-                        ++common;
-                    }
-                    ++commonWithValue;
-                }
+            const int commonWithValue = yChildren.count(commonSums);
+            int common = commonWithValue;
+            if (haveValues(x, y)) {
+                NodeRange yValue(subtree, po2, leftmost2, y->getValue());
+                common = yChildren.count(nonValueSums)
+                       - yValue.count(nonValueSums);
             }
 
             if (!excludeValues) {
@@ -19,11 +19,15 @@
 
 #include <cstdint>
 
+#include <memory>
 #include <vector>
 
+#include "pmr/monolithic.hpp"
+
+#include "utils/strings.hpp"
+
 enum class State : std::uint8_t;
 
-class DiceString;
 class Language;
 class Node;
 
@@ -36,11 +40,19 @@ class Distiller
 
 public:
     // Creates an instance for the specific language.
-    Distiller(Language &lang) : lang(lang)
+    Distiller(Language &lang) : lang(lang), bruteForce(false)
     {
     }
 
 public:
+    // Makes matching of terminals compare every pair of them instead of
+    // looking up candidates in an index.  Results don't change, this is meant
+    // for verification of the index.
+    void setBruteForce(bool bruteForce)
+    {
+        this->bruteForce = bruteForce;
+    }
+
     // Computes changes between two disjoint subtrees and marks nodes
     // appropriately.
     void distill(Node &T1, Node &T2);
@@ -50,12 +62,16 @@ private:
     void initialize(Node &T1, Node &T2);
     // Composes list of viable matches of terminals.
     std::vector<TerminalMatch> generateTerminalMatches();
+    // Composes list of viable matches of terminals by comparing all of them.
+    std::vector<TerminalMatch> generateAllTerminalMatches();
+    // Computes prefix sums over po2 of terminals that are matched to
+    // descendants of `x`, which are used to count common terminals of `x` and
+    // any node of T2 in constant time.
+    void countCommon(const Node *x);
     // Computes children similarity.  Returns the similarity, which is 0.0 if
-    // it's too small to consider nodes as matching.
-    float childrenSimilarity(const Node *x,
-                             const std::vector<Node *> &po1,
-                             const Node *y,
-                             const std::vector<Node *> &po2) const;
+    // it's too small to consider nodes as matching.  countCommon() must be
+    // called for `x` beforehand.
+    float childrenSimilarity(const Node *x, const Node *y) const;
     // Computes rating of a match of terminals, which is to be compared with
     // ratings of other matches.
     int rateTerminalsMatch(const Node *x, const Node *y) const;
@@ -68,10 +84,6 @@ private:
     // Retrieves parent of the node possibly skipping container parents.  Might
     // return `nullptr`.
     const Node * getParent(const Node *n) const;
-    // Counts number of already matched elements in specified subtree.
-    int countAlreadyMatched(const Node *node) const;
-    // Counts number of already matched leaves in specified subtree.
-    int countAlreadyMatchedLeaves(const Node *node) const;
     // Main pass for matching internal nodes.
     void distillInternal();
     // Matches unmatched internal nodes with similar nodes that have maximum
@@ -87,9 +99,23 @@ private:
 
 private:
     Language &lang;                // Language of the nodes.
+    bool bruteForce;               // Whether terminals aren't indexed.
     std::vector<Node *> po1, po2;  // Nodes in post-order traversal order.
+    // Storage of bigrams of dice1 and dice2, recreated on every distilling.
+    std::unique_ptr<cpp17::pmr::monolithic> diceMR;
     std::vector<DiceString> dice1; // DiceString of corresponding po1[i]->label.
     std::vector<DiceString> dice2; // DiceString of corresponding po2[i]->label.
+    std::vector<int> leftmost1;    // Leftmost non-satellite descendants of po1.
+    std::vector<int> leftmost2;    // Leftmost non-satellite descendants of po2.
+    std::vector<int> terminals1;   // Prefix sums of terminals of po1.
+    std::vector<int> terminals2;   // Prefix sums of terminals of po2.
+    std::vector<int> matched1;     // Leaves of po1[i] matched before distilling.
+    std::vector<int> matched2;     // Leaves of po2[i] matched before distilling.
+    std::vector<int> commonSums;   // Terminals matched into descendants of x.
+    std::vector<int> selCommonSums; // Same as above but only those with
+                                    // matched parents.
+    std::vector<int> nonValueSums;  // Same as commonSums but excluding those
+                                    // matched into value of x.
 };
 
 #endif // ZOGRASCOPE_CHANGE_DISTILLING_HPP_
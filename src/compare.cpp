@@ -19,12 +19,20 @@
 #include <cassert>
 
 #include <algorithm>
+#include <exception>
+#include <functional>
 #include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/optional.hpp>
 #include <dtl/dtl.hpp>
 
+#include "pmr/monolithic.hpp"
+
+#include "utils/ThreadPool.hpp"
 #include "utils/strings.hpp"
 #include "utils/time.hpp"
 #include "Language.hpp"
@@ -37,10 +45,16 @@ namespace {
 // Coordinates tree comparison.
 class Comparator
 {
+    class Batch;
+
 public:
-    // Records arguments for future use.
+    // Records arguments for future use.  Pool is optional, when it's provided
+    // independent subtrees are compared in parallel.
     Comparator(Tree &T1, Tree &T2, TimeReport &tr, bool coarse,
-               bool skipRefine);
+               bool skipRefine, ThreadPool *pool);
+    // Creates a comparator that works on behalf of the parent one, but has its
+    // own state and time report.
+    Comparator(const Comparator &parent, TimeReport &tr);
 
 public:
     // Launches comparison.
@@ -50,8 +64,13 @@ private:
     // Performs comparison of trees available at this level and if necessary of
     // trees from the following levels.
     void compare(Node *T1, Node *T2);
+    // Distills a pair of matched top-level subtrees and compares their next
+    // layers if they turned out to be matched.
+    void compareMatched(Node *subT1, Node *subT2);
     // Recursively compares nodes that are marked as changed.
-    void compareChanged(Node *node);
+    void compareChanged(Node *node, Batch &batch);
+    // Runs tree edit distance on next layers of updated leaves.
+    void refine(Node &node, Batch &batch);
     // Flattens two trees simultaneously.
     void flatten(Node *x, Node *y);
     // Attempts to flatten subtrees on a specific level.  Returns `true` if
@@ -84,9 +103,92 @@ private:
     TimeReport &tr;      // Time keeper.
     bool coarse;         // Do only fine-grained comparison.
     bool skipRefine;     // Do not perform fine-grained refining.
+    ThreadPool *pool;    // Threads for parallel processing or `nullptr`.
     Distiller distiller; // Implementation of change-distilling algorithm.
 };
 
+// Set of independent pieces of comparison that are either executed right away
+// or put on a thread pool.  In the latter case each piece gets a comparator of
+// its own with a nested time report.
+class Comparator::Batch
+{
+public:
+    // Piece of work to be performed by the specified comparator.
+    using Work = std::function<void(Comparator &)>;
+
+public:
+    // Remembers the comparator.
+    explicit Batch(Comparator &parent) : parent(parent)
+    {
+    }
+
+    // Waits for all pieces of work to finish.
+    ~Batch() try
+    {
+        finish();
+    } catch (...) {
+        // Do not throw from a destructor.
+    }
+
+    Batch(const Batch &rhs) = delete;
+    Batch & operator=(const Batch &rhs) = delete;
+
+public:
+    // Schedules piece of work.  Returns handle that can be used to wait for
+    // this particular piece.
+    ThreadPool::Task add(Work work)
+    {
+        if (parent.pool == nullptr) {
+            work(parent);
+            return {};
+        }
+
+        reports.emplace_back(new TimeReport(parent.tr));
+        TimeReport &tr = *reports.back();
+        Comparator &parent = this->parent;
+        ThreadPool::Task task = parent.pool->submit([&parent, &tr, work]() {
+            Comparator comparator(parent, tr);
+            work(comparator);
+        });
+        tasks.push_back(task);
+        return task;
+    }
+
+    // Waits for the piece of work.
+    void wait(const ThreadPool::Task &task)
+    {
+        if (task) {
+            parent.pool->wait(task);
+        }
+    }
+
+    // Waits for all pieces of work to finish and merges their time reports.
+    void finish()
+    {
+        // Make sure all tasks are done before anything gets thrown.
+        std::exception_ptr error;
+        for (const ThreadPool::Task &task : tasks) {
+            try {
+                parent.pool->wait(task);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        tasks.clear();
+
+        TimeReport::commitAll(reports);
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    Comparator &parent;                               // Owner of the batch.
+    std::vector<ThreadPool::Task> tasks;              // Scheduled tasks.
+    std::vector<std::unique_ptr<TimeReport>> reports; // Their time reports.
+};
+
 template <typename T, typename... Args>
 auto bind(const T &f, Args&&... a)
     -> decltype(std::bind(f, std::forward<Args>(a)..., std::placeholders::_1))
@@ -96,21 +198,31 @@ auto bind(const T &f, Args&&... a)
 
 }
 
+static bool isNotSatellite(const Node *x);
 static void setParentLinks(Node *x, Node *parent);
-static void refine(Node &node);
 
 Comparator::Comparator(Tree &T1, Tree &T2, TimeReport &tr, bool coarse,
-                       bool skipRefine)
+                       bool skipRefine, ThreadPool *pool)
     : T1(T1), T2(T2), lang(*T1.getLanguage()),
-      tr(tr), coarse(coarse), skipRefine(skipRefine), distiller(lang)
+      tr(tr), coarse(coarse), skipRefine(skipRefine), pool(pool),
+      distiller(lang)
 {
     // XXX: the assumption is that both trees have the same language.
     //      Might be a good idea to actually check this somewhere.
 }
 
+Comparator::Comparator(const Comparator &parent, TimeReport &tr)
+    : T1(parent.T1), T2(parent.T2), lang(parent.lang),
+      tr(tr), coarse(parent.coarse), skipRefine(parent.skipRefine),
+      pool(parent.pool), distiller(lang)
+{
+}
+
 void
 Comparator::compare()
 {
+    // Relatives get assigned concurrently below, so link trees beforehand.
+    T1.link(T2);
     compare(T1.getRoot(), T2.getRoot());
 }
 
@@ -129,7 +241,9 @@ Comparator::compare(Node *T1, Node *T2)
 
     tr.measure("coarse-reduction"), reduceTreesCoarse(T1, T2);
 
-    if (!coarse) {
+    // Fine-grained comparison takes memory quadratic in size of trees, so
+    // large trees are compared coarsely.
+    if (!coarse && canTed(*T1, *T2)) {
         tr.measure("diffing"), ted(*T1, *T2);
         return;
     }
@@ -137,29 +251,72 @@ Comparator::compare(Node *T1, Node *T2)
     std::vector<Match> matches;
 
     auto timer = tr.measure("distilling");
-    for (Node *t1Child : T1->children) {
-        if (t1Child->satellite) {
-            continue;
+
+    std::vector<Node *> children1, children2;
+    std::copy_if(T1->children.cbegin(), T1->children.cend(),
+                 std::back_inserter(children1), &isNotSatellite);
+    std::copy_if(T2->children.cbegin(), T2->children.cend(),
+                 std::back_inserter(children2), &isNotSatellite);
+
+    // Stringify every subtree only once.  Strings must be in place before
+    // DiceString objects referring to them are created.
+    std::vector<std::string> st1, st2;
+    st1.reserve(children1.size());
+    for (Node *t1Child : children1) {
+        st1.push_back(printSubTree(*t1Child, false));
+    }
+    st2.reserve(children2.size());
+    for (Node *t2Child : children2) {
+        st2.push_back(printSubTree(*t2Child, false));
+    }
+
+    // Bigrams of all strings are freed at once.
+    cpp17::pmr::monolithic diceMR;
+    std::vector<DiceString> dice1, dice2;
+    dice1.reserve(st1.size());
+    for (const std::string &s : st1) {
+        dice1.emplace_back(s, &diceMR);
+    }
+    dice2.reserve(st2.size());
+    for (const std::string &s : st2) {
+        dice2.emplace_back(s, &diceMR);
+    }
+
+    // Versions of subtrees with comments, computed only when needed and only
+    // for subtrees that do have comments.
+    std::vector<boost::optional<std::string>> full1(children1.size());
+    std::vector<boost::optional<std::string>> full2(children2.size());
+    auto printFull = [](boost::optional<std::string> &full, const Node *node,
+                        const std::string &code) -> const std::string & {
+        const Fingerprint &fp = node->fingerprint;
+        if (fp.textLength == fp.codeLength) {
+            return code;
         }
-        boost::optional<std::string> subtree1;
-        const std::string st1 = printSubTree(*t1Child, false);
-        DiceString subtree1Dice(st1);
-        for (Node *t2Child : T2->children) {
-            if (t2Child->satellite) {
-                continue;
-            }
+        if (!full) {
+            full = printSubTree(*node, true);
+        }
+        return *full;
+    };
+
+    // Lower of the two thresholds below.
+    DiceIndex index(dice2, 0.6f);
+
+    for (int i = 0, n = children1.size(); i < n; ++i) {
+        Node *t1Child = children1[i];
+        for (int j : index.lookup(dice1[i])) {
+            Node *t2Child = children2[j];
 
             // XXX: here mismatched labels are included in similarity
             //      measurement, which affects it negatively
-            const std::string st2 = printSubTree(*t2Child, false);
-            DiceString subtree2Dice(st2);
-            const float similarity = subtree1Dice.compare(subtree2Dice);
+            const float similarity = dice1[i].compare(dice2[j]);
             bool identical = (similarity == 1.0f);
             if (identical) {
-                if (!subtree1) {
-                    subtree1 = printSubTree(*t1Child, true);
-                }
-                identical = (subtree1 == printSubTree(*t2Child, true));
+                const Fingerprint &fp1 = t1Child->fingerprint;
+                const Fingerprint &fp2 = t2Child->fingerprint;
+                identical = (fp1.text == fp2.text
+                          && fp1.textLength == fp2.textLength
+                          && printFull(full1[i], t1Child, st1[i])
+                          == printFull(full2[j], t2Child, st2[j]));
             }
             if ((t1Child->label == t2Child->label && similarity >= 0.6f) ||
                 (t1Child->label != t2Child->label && similarity >= 0.8f)) {
@@ -176,25 +333,32 @@ Comparator::compare(Node *T1, Node *T2)
                          return b.similarity < a.similarity;
                      });
 
-    for (const Match &match : matches) {
-        if (match.x->relative != nullptr || match.y->relative != nullptr) {
-            continue;
-        }
+    {
+        Batch batch(*this);
 
-        Node *subT1 = match.x, *subT2 = match.y;
-        distiller.distill(*subT1, *subT2);
-
-        if (subT1->relative == subT2 && subT1->next && subT2->next &&
-            !subT1->next->last && !subT2->next->last) {
-            // Process next layers of nodes which were identified as updated the
-            // same way compareChanged() does it.
-            compare(subT1->next, subT2->next);
-            subT1->state = State::Unchanged;
-            subT2->state = State::Unchanged;
-            // Mark the trees as satellites to exclude them from distilling.
-            subT1->satellite = true;
-            subT2->satellite = true;
+        // Whether a match is processed depends on the outcome of previous
+        // matches involving its nodes, but not on any other ones.  This way
+        // matches of unrelated subtrees are processed in parallel with the
+        // same result as if it was done sequentially.
+        std::unordered_map<const Node *, ThreadPool::Task> lastTasks;
+
+        for (const Match &match : matches) {
+            batch.wait(lastTasks[match.x]);
+            batch.wait(lastTasks[match.y]);
+
+            if (match.x->relative != nullptr || match.y->relative != nullptr) {
+                continue;
+            }
+
+            Node *subT1 = match.x, *subT2 = match.y;
+            ThreadPool::Task task = batch.add([=](Comparator &comparator) {
+                comparator.compareMatched(subT1, subT2);
+            });
+            lastTasks[subT1] = task;
+            lastTasks[subT2] = task;
         }
+
+        batch.finish();
     }
 
     // Flatten unmatched trees into parent tree of their roots before doing
@@ -207,15 +371,37 @@ Comparator::compare(Node *T1, Node *T2)
     detectMoves(T1);
 
     timer.measure("descending");
-    compareChanged(T1);
 
+    // Subtrees of different nodes are disjoint and can be processed
+    // independently.
+    Batch batch(*this);
+    compareChanged(T1, batch);
     if (!skipRefine) {
-        refine(*T1);
+        refine(*T1, batch);
+    }
+    batch.finish();
+}
+
+void
+Comparator::compareMatched(Node *subT1, Node *subT2)
+{
+    distiller.distill(*subT1, *subT2);
+
+    if (subT1->relative == subT2 && subT1->next && subT2->next &&
+        !subT1->next->last && !subT2->next->last) {
+        // Process next layers of nodes which were identified as updated the
+        // same way compareChanged() does it.
+        compare(subT1->next, subT2->next);
+        subT1->state = State::Unchanged;
+        subT2->state = State::Unchanged;
+        // Mark the trees as satellites to exclude them from distilling.
+        subT1->satellite = true;
+        subT2->satellite = true;
     }
 }
 
 void
-Comparator::compareChanged(Node *node)
+Comparator::compareChanged(Node *node, Batch &batch)
 {
     for (Node *x : node->children) {
         Node *y = x->relative;
@@ -223,10 +409,12 @@ Comparator::compareChanged(Node *node)
             if (!x->next->last && !x->satellite) {
                 x->state = State::Unchanged;
                 y->state = State::Unchanged;
-                compare(x->next, y->next);
+                batch.add([x, y](Comparator &comparator) {
+                    comparator.compare(x->next, y->next);
+                });
             }
         } else {
-            compareChanged(x);
+            compareChanged(x, batch);
         }
     }
 }
@@ -267,7 +455,8 @@ Comparator::flatten(Node *n, int level, bool dry)
         return 0;
     }
 
-    for (Node *&c : n->children) {
+    for (std::size_t i = 0U; i < n->children.size(); ++i) {
+        Node *c = n->children[i];
         if (c->satellite || (c->next != nullptr && c->next->last)) {
             continue;
         }
@@ -283,7 +472,7 @@ Comparator::flatten(Node *n, int level, bool dry)
 
         if (c->next != nullptr && lang.canBeFlattened(n, c, level)) {
             if (!dry) {
-                c = c->next;
+                n->children.replace(i, c->next);
             }
             ++flattened;
         }
@@ -292,6 +481,13 @@ Comparator::flatten(Node *n, int level, bool dry)
     return flattened;
 }
 
+// Checks whether node isn't a satellite.
+static bool
+isNotSatellite(const Node *x)
+{
+    return !x->satellite;
+}
+
 static void
 setParentLinks(Node *x, Node *parent)
 {
@@ -330,8 +526,10 @@ Comparator::detectMoves(Node *x)
             return x->relative == y;
         };
 
-        dtl::Diff<Node *, cpp17::pmr::vector<Node *>, decltype(cmp)>
-            diff(x->children, y->children, cmp);
+        std::vector<Node *> xChildren(x->children.begin(), x->children.end());
+        std::vector<Node *> yChildren(y->children.begin(), y->children.end());
+        dtl::Diff<Node *, std::vector<Node *>, decltype(cmp)>
+            diff(xChildren, yChildren, cmp);
         diff.compose();
 
         for (const auto &d : diff.getSes().getSequence()) {
@@ -394,7 +592,7 @@ Comparator::detectMovesInFixedStructure(Node *x, Node *y)
 int
 Comparator::getMovePosOfAux(Node *node)
 {
-    cpp17::pmr::vector<Node *> &children = node->parent->children;
+    const NodeChildren &children = node->parent->children;
     int pos = 0;
     for (Node *child : children) {
         if (child == node) {
@@ -461,29 +659,39 @@ Comparator::isTravellingPair(const Node *x, const Node *y)
     return false;
 }
 
-static void
-refine(Node &node)
+void
+Comparator::refine(Node &node, Batch &batch)
 {
     if (node.satellite) {
         return;
     }
 
     if (node.leaf && node.state == State::Updated &&
-        node.next != nullptr && node.relative->next != nullptr) {
+        node.next != nullptr && node.relative->next != nullptr &&
+        canTed(*node.next, *node.relative->next)) {
         node.state = State::Unchanged;
         node.relative->state = State::Unchanged;
 
         Node *subT1 = node.next, *subT2 = node.relative->next;
-        ted(*subT1, *subT2);
+        batch.add([subT1, subT2](Comparator &) {
+            ted(*subT1, *subT2);
+        });
     }
 
     for (Node *child : node.children) {
-        refine(*child);
+        refine(*child, batch);
     }
 }
 
 void
-compare(Tree &T1, Tree &T2, TimeReport &tr, bool coarse, bool skipRefine)
+compare(Tree &T1, Tree &T2, TimeReport &tr, bool coarse, bool skipRefine,
+        int jobs)
 {
-    return Comparator(T1, T2, tr, coarse, skipRefine).compare();
+    if (jobs <= 1) {
+        return Comparator(T1, T2, tr, coarse, skipRefine, nullptr).compare();
+    }
+
+    // Calling thread participates in processing while it waits.
+    ThreadPool pool(jobs - 1);
+    return Comparator(T1, T2, tr, coarse, skipRefine, &pool).compare();
 }
@@ -20,6 +20,9 @@
 class TimeReport;
 class Tree;
 
-void compare(Tree &T1, Tree &T2, TimeReport &tr, bool coarse, bool skipRefine);
+// Compares two trees marking their nodes.  Independent subtrees are compared in
+// parallel when `jobs` is greater than one, which doesn't affect the result.
+void compare(Tree &T1, Tree &T2, TimeReport &tr, bool coarse, bool skipRefine,
+             int jobs = 1);
 
 #endif // ZOGRASCOPE_COMPARE_HPP_
@@ -19,6 +19,7 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -27,11 +28,14 @@
 #include <boost/iostreams/stream_buffer.hpp>
 #include <boost/scope_exit.hpp>
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -289,13 +293,44 @@ getTerminalSize()
 std::string
 readCommandOutput(std::vector<std::string> cmd, const std::string &input)
 {
+    std::string output;
+    auto sink = [&output](boost::string_ref chunk) {
+        output.append(chunk.data(), chunk.size());
+    };
+    readCommandOutput(std::move(cmd), input, sink);
+    return normalizeEols(std::move(output));
+}
+
+void
+readCommandOutput(std::vector<std::string> cmd, const std::string &input,
+                  const std::function<void(boost::string_ref)> &sink)
+{
+    // Descriptors are closed on exec, otherwise commands started concurrently
+    // by other threads would inherit them and keep pipes open.  Flag is set
+    // after creating a pipe, so forking by other threads has to wait for it.
+    static std::mutex forkMutex;
+    std::unique_lock<std::mutex> forkLock(forkMutex);
+
+    auto makePipe = [](int pipePair[2]) {
+        if (pipe(pipePair) != 0) {
+            return false;
+        }
+        if (fcntl(pipePair[0], F_SETFD, FD_CLOEXEC) == -1 ||
+            fcntl(pipePair[1], F_SETFD, FD_CLOEXEC) == -1) {
+            close(pipePair[0]);
+            close(pipePair[1]);
+            return false;
+        }
+        return true;
+    };
+
     int stdinPipePair[2];
-    if (pipe(stdinPipePair) != 0) {
+    if (!makePipe(stdinPipePair)) {
         throw std::runtime_error("Failed to create a pipe");
     }
 
     int stdoutPipePair[2];
-    if (pipe(stdoutPipePair) != 0) {
+    if (!makePipe(stdoutPipePair)) {
         close(stdinPipePair[0]);
         close(stdinPipePair[1]);
         throw std::runtime_error("Failed to create a pipe");
@@ -330,6 +365,7 @@ readCommandOutput(std::vector<std::string> cmd, const std::string &input)
         execvp(argv[0], argv);
         _Exit(127);
     }
+    forkLock.unlock();
 
     close(stdinPipePair[0]);
     close(stdoutPipePair[1]);
@@ -339,17 +375,32 @@ readCommandOutput(std::vector<std::string> cmd, const std::string &input)
     stdinStream << input;
     stdinStream.close();
 
-    io::stream_buffer<io::file_descriptor_source>
-        stdoutStream(stdoutPipePair[0], boost::iostreams::close_handle);
-
-    std::ostringstream iss;
-    iss << &stdoutStream;
-
     int wstatus;
+    try {
+        char buf[64*1024];
+        while (true) {
+            const ssize_t n = read(stdoutPipePair[0], buf, sizeof(buf));
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n == -1) {
+                throw std::runtime_error("Failed to read output of " + cmd[0]);
+            }
+            if (n == 0) {
+                break;
+            }
+            sink(boost::string_ref(buf, n));
+        }
+    } catch (...) {
+        // Closing the pipe makes the command terminate if it's still writing.
+        close(stdoutPipePair[0]);
+        (void)waitpid(pid, &wstatus, 0);
+        throw;
+    }
+    close(stdoutPipePair[0]);
+
     if (waitpid(pid, &wstatus, 0) == -1 || !WIFEXITED(wstatus) ||
         WEXITSTATUS(wstatus) != EXIT_SUCCESS) {
         throw std::runtime_error("Invocation failed for " + cmd[0]);
     }
-
-    return normalizeEols(iss.str());
 }
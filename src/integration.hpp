@@ -17,11 +17,14 @@
 #ifndef ZOGRASCOPE_INTEGRATION_HPP_
 #define ZOGRASCOPE_INTEGRATION_HPP_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <boost/utility/string_ref.hpp>
+
 /**
  * @file integration.hpp
  *
@@ -93,4 +96,19 @@ std::pair<unsigned int, unsigned int> getTerminalSize();
 std::string readCommandOutput(std::vector<std::string> cmd,
                               const std::string &input);
 
+/**
+ * @brief Runs a command and passes its output to a callback piece by piece.
+ *
+ * Output is passed as is, without normalizing line endings.  If @p sink
+ * throws, the command is waited for and the exception is propagated.
+ *
+ * @param cmd Program name followed by its arguments.
+ * @param input Input to be sent to program's standard input stream.
+ * @param sink Receiver of chunks of program's output as they are read.
+ *
+ * @throws std::runtime_error On errors (including application returning non-0).
+ */
+void readCommandOutput(std::vector<std::string> cmd, const std::string &input,
+                       const std::function<void(boost::string_ref)> &sink);
+
 #endif // ZOGRASCOPE_INTEGRATION_HPP_
@@ -65,7 +65,7 @@ MakeLanguage::mapToken(int token) const
 }
 
 TreeBuilder
-MakeLanguage::parse(const std::string &contents, const std::string &fileName,
+MakeLanguage::parse(boost::string_ref contents, const std::string &fileName,
                     int tabWidth, bool debug, cpp17::pmr::monolithic &mr) const
 {
     return make_parse(contents, fileName, tabWidth, debug, mr);
@@ -206,6 +206,12 @@ MakeLanguage::classify(SType stype) const
     }
 }
 
+bool
+MakeLanguage::isValidSType(SType stype) const
+{
+    return -stype <= MakeSType::Punctuation;
+}
+
 const char *
 MakeLanguage::toString(SType stype) const
 {
@@ -17,6 +17,8 @@
 #ifndef ZOGRASCOPE_MAKE_MAKELEXERDATA_HPP_
 #define ZOGRASCOPE_MAKE_MAKELEXERDATA_HPP_
 
+#include <boost/utility/string_ref.hpp>
+
 #include <cstddef>
 #include <cstring>
 
@@ -58,7 +60,7 @@ struct MakeLexerData : LexerData
 
     // Remembers arguments to use them in the lexer, all of them must be alive
     // during lexing (including the string which isn't copied).
-    MakeLexerData(const std::string &str, int tabWidth, TreeBuilder &tb,
+    MakeLexerData(boost::string_ref str, int tabWidth, TreeBuilder &tb,
                   MakeParseData &pd)
         : LexerData(str, tabWidth, tb), pd(&pd)
     { }
@@ -18,13 +18,22 @@
 
 #include <cstdlib>
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/utility/string_ref.hpp>
-#include "tinyxml2/tinyxml2.h"
 
 #ifdef HAVE_LIBSRCML
 #include <srcml.h>
@@ -33,21 +42,188 @@
 #include "utils/fs.hpp"
 #include "utils/strings.hpp"
 #include "TreeBuilder.hpp"
+#include "XmlParser.hpp"
 #include "integration.hpp"
 #include "types.hpp"
 
-namespace ti = tinyxml2;
-
-static void toSrcmlForm(const std::string &contents,
+static void toSrcmlForm(boost::string_ref contents,
                         const std::string &path,
                         const std::string &language,
-                        ti::XMLDocument &doc);
-static bool toLibSrcmlForm(const std::string &contents,
+                        XmlHandler &handler);
+static void runSrcml(boost::string_ref contents,
+                     const std::string &path,
+                     const std::string &language,
+                     XmlHandler &handler);
+static bool toLibSrcmlForm(boost::string_ref contents,
                            const std::string &language,
-                           ti::XMLDocument &doc);
+                           XmlHandler &handler);
 static boost::string_ref processValue(boost::string_ref str);
 
-SrcmlTransformer::SrcmlTransformer(const std::string &contents,
+namespace {
+
+// Forwards events to another handler and counts elements that were seen.
+class ElementCounter : public XmlHandler
+{
+public:
+    // Remembers the handler.
+    explicit ElementCounter(XmlHandler &handler) : handler(handler)
+    { }
+
+public:
+    // Retrieves number of elements seen so far.
+    int getCount() const
+    { return count; }
+
+private:
+    virtual void startElement(boost::string_ref name,
+                              const XmlAttrs &attrs) override
+    {
+        ++count;
+        handler.startElement(name, attrs);
+    }
+
+    virtual void endElement(boost::string_ref name) override
+    { handler.endElement(name); }
+
+    virtual void text(boost::string_ref text) override
+    { handler.text(text); }
+
+private:
+    XmlHandler &handler; // Receiver of events.
+    int count = 0;       // Number of elements.
+};
+
+// Splits an archive produced by srcml into XML of its units.
+class UnitSplitter : public XmlHandler
+{
+public:
+    // Callback that receives file name and XML of a unit.
+    using Sink = std::function<void(const std::string &fileName,
+                                    std::string xml)>;
+
+public:
+    // Remembers the callback.
+    explicit UnitSplitter(Sink sink) : parser(*this), sink(std::move(sink))
+    { }
+
+public:
+    // Processes next piece of the archive.
+    void feed(boost::string_ref chunk)
+    {
+        archive.append(chunk.data(), chunk.size());
+        parser.feed(chunk);
+
+        // Keep only part of the archive that might belong to the next unit.
+        if (depth < 2) {
+            archive.erase(0U, keepFrom - archiveStart);
+            archiveStart = keepFrom;
+        }
+    }
+
+    // Checks that the archive is complete.
+    void finish()
+    { parser.finish(); }
+
+private:
+    virtual void startElement(boost::string_ref name,
+                              const XmlAttrs &attrs) override
+    {
+        if (++depth == 2 && name == "unit") {
+            const std::string *attr = findXmlAttr(attrs, "filename");
+            fileName = (attr == nullptr ? std::string() : *attr);
+            unitStart = parser.getTokenStart();
+        }
+    }
+
+    virtual void endElement(boost::string_ref name) override
+    {
+        if (depth-- == 2 && name == "unit") {
+            keepFrom = parser.getTokenEnd();
+            if (!fileName.empty()) {
+                sink(fileName, archive.substr(unitStart - archiveStart,
+                                              keepFrom - unitStart));
+            }
+        }
+    }
+
+    virtual void text(boost::string_ref /*text*/) override
+    { }
+
+private:
+    XmlParser parser;              // Parser of the archive.
+    Sink sink;                     // Receiver of units.
+    std::string archive;           // Part of the archive that's kept around.
+    std::size_t archiveStart = 0U; // Offset of `archive` in the output.
+    std::size_t keepFrom = 0U;     // Start of data that might be needed.
+    std::size_t unitStart = 0U;    // Start of the current unit.
+    std::string fileName;          // File name of the current unit.
+    int depth = 0;                 // Current nesting level.
+};
+
+// Runs single srcml process on files that are either prefetched together or
+// requested to be parsed by several threads at the same time, which pays cost
+// of starting the process once per batch.  Thread whose request wasn't picked
+// up by a batch that is already running starts a new batch with all requests
+// queued so far.
+class SrcmlBatcher
+{
+    // Request to parse a file.
+    struct Request
+    {
+        boost::string_ref contents;  // Contents of the file.
+        const std::string &path;     // Path to the file.
+        const std::string &language; // Language of the file.
+        XmlHandler *handler;         // Receiver of the result or nullptr.
+        bool done;                   // Whether batch has processed this one.
+        bool found;                  // Whether the file was parsed.
+        std::string xml;             // Result of batch, if it was found.
+        std::exception_ptr error;    // Error of parsing the file, if any.
+    };
+
+    // Unit of a prefetched file.
+    struct Prefetched
+    {
+        std::string language; // Language of the file.
+        std::string contents; // Contents of the file at the time of parsing.
+        std::string xml;      // Unit extracted from the archive.
+        int generation;       // Number of prefetching that produced the unit.
+    };
+
+public:
+    // Retrieves the only instance of the class.
+    static SrcmlBatcher & get();
+
+public:
+    // Parses files in concurrent batches ahead of requests to parse them.
+    // Units that weren't requested since the previous prefetching are dropped.
+    void prefetch(const std::vector<std::string> &paths,
+                  const std::string &language);
+    // Parses the file as part of a batch.  Rethrows error of parsing it.
+    void parse(boost::string_ref contents, const std::string &path,
+               const std::string &language, XmlHandler &handler);
+
+private:
+    // Retrieves maximum number of batches that run at the same time.
+    static int getMaxRunning();
+    // Runs srcml on the batch and stores results in requests.  Doesn't throw.
+    static void run(const std::vector<Request *> &batch);
+    // Runs srcml on all files of the batch at once.  Requests of files that
+    // weren't parsed are left intact.
+    static void runBatch(const std::vector<Request *> &batch);
+
+private:
+    std::mutex mutex;                 // Protects fields below.
+    std::condition_variable finished; // Signaled when a batch is done.
+    std::vector<Request *> queue;     // Requests waiting for a batch.
+    int running = 0;                  // Number of batches being processed.
+    int generation = 0;               // Number of prefetchings done so far.
+    // Units of prefetched files that weren't requested yet by their paths.
+    std::unordered_map<std::string, Prefetched> prefetched;
+};
+
+}
+
+SrcmlTransformer::SrcmlTransformer(boost::string_ref contents,
                                    const std::string &path,
                                    TreeBuilder &tb,
                                    const std::string &language,
@@ -61,34 +237,68 @@ SrcmlTransformer::SrcmlTransformer(const std::string &contents,
 void
 SrcmlTransformer::transform()
 {
-    ti::XMLDocument doc;
-    toSrcmlForm(contents, path, language, doc);
-    if (doc.Error()) {
-        throw std::runtime_error("Failed to parse: " +
-                                 std::string(doc.ErrorStr()));
-    }
-
     left = contents;
     line = 1;
     col = 1;
     inCppDirective = 0;
+    frames.clear();
+    root = nullptr;
+    skipped = 0;
+
+    try {
+        toSrcmlForm(contents, path, language, *this);
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error("Failed to parse: " + std::string(e.what()));
+    }
 
-    tb.setRoot(visit(doc.RootElement(), 0));
+    tb.setRoot(root == nullptr ? tb.addNode() : root);
 }
 
-// Parses source file via SrcML and gets result in a form of XML DOM.
-static void toSrcmlForm(const std::string &contents,
+bool
+SrcmlTransformer::canPrefetch()
+{
+#ifdef HAVE_LIBSRCML
+    return false;
+#else
+    return true;
+#endif
+}
+
+void
+SrcmlTransformer::prefetch(const std::vector<std::string> &paths,
+                           const std::string &language)
+{
+#ifdef HAVE_LIBSRCML
+    // Library parses files without starting processes.
+    (void)paths, (void)language;
+#else
+    SrcmlBatcher::get().prefetch(paths, language);
+#endif
+}
+
+// Parses source file via SrcML and passes the result to the handler.
+static void toSrcmlForm(boost::string_ref contents,
                         const std::string &path,
                         const std::string &language,
-                        ti::XMLDocument &doc)
+                        XmlHandler &handler)
 {
-    if (toLibSrcmlForm(contents, language, doc)) {
+    if (toLibSrcmlForm(contents, language, handler)) {
         return;
     }
 #ifdef HAVE_LIBSRCML
     throw std::runtime_error("Failed to parse " + path);
 #endif
 
+    SrcmlBatcher::get().parse(contents, path, language, handler);
+}
+
+// Parses single file via srcml processing its output while it's being read.
+static void
+runSrcml(boost::string_ref contents,
+         const std::string &path,
+         const std::string &language,
+         XmlHandler &handler)
+{
     TempFile tmpFile(path);
 
     std::ofstream ofs(tmpFile);
@@ -103,18 +313,264 @@ static void toSrcmlForm(const std::string &contents,
         "srcml", "--language=" + language, "--src-encoding=utf8", tmpFile
     };
 
-    std::string xml = readCommandOutput(cmd, std::string());
-
-    if (doc.Parse(xml.data(), xml.size()) == ti::XML_SUCCESS &&
-        doc.RootElement() == nullptr) {
+    auto parse = [&](const std::string &input) {
+        ElementCounter counter(handler);
+        XmlParser parser(counter);
+        readCommandOutput(cmd, input, [&parser](boost::string_ref chunk) {
+            parser.feed(chunk);
+        });
+        parser.finish();
+        return counter.getCount() != 0;
+    };
 
+    if (!parse(std::string())) {
         // Work around srcml's issues with parsing files.  Sometimes it can't
         // read them from file (when extension is ".z" it thinks it's an
         // archive) and sometimes from stdin (bugs of previous versions), so try
         // both ways.
         cmd.pop_back();
-        xml = readCommandOutput(cmd, contents);
-        (void)doc.Parse(xml.data(), xml.size());
+        (void)parse(contents.to_string());
+    }
+}
+
+SrcmlBatcher &
+SrcmlBatcher::get()
+{
+    static SrcmlBatcher instance;
+    return instance;
+}
+
+void
+SrcmlBatcher::prefetch(const std::vector<std::string> &paths,
+                       const std::string &language)
+{
+    std::vector<std::string> readPaths;
+    std::vector<std::string> contents;
+    for (const std::string &path : paths) {
+        try {
+            FileContents file(path);
+            contents.push_back(file.str().to_string());
+            readPaths.push_back(path);
+        } catch (const std::runtime_error &) {
+            // Error is reported when the file is parsed.
+        }
+    }
+
+    std::vector<Request> requests;
+    requests.reserve(readPaths.size());
+    for (std::size_t i = 0U; i < readPaths.size(); ++i) {
+        requests.push_back(Request {
+            contents[i], readPaths[i], language, nullptr, false, false, {}, {}
+        });
+    }
+
+    // Files are split among as many batches as would run on request, but
+    // single file isn't parsed any faster ahead of time.
+    const std::size_t nBatches = std::min<std::size_t>(getMaxRunning(),
+                                                       requests.size()/2U);
+    std::vector<std::vector<Request *>> batches(nBatches);
+    for (std::size_t i = 0U; i < requests.size() && nBatches != 0U; ++i) {
+        batches[i*nBatches/requests.size()].push_back(&requests[i]);
+    }
+
+    auto runSafely = [](const std::vector<Request *> &batch) {
+        try {
+            runBatch(batch);
+        } catch (...) {
+            // Files without results are parsed on request.
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1U; i < nBatches; ++i) {
+        threads.emplace_back(runSafely, std::cref(batches[i]));
+    }
+    if (nBatches != 0U) {
+        runSafely(batches[0]);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Files of the previous prefetching might still be waiting to be parsed,
+    // older ones won't be requested.
+    ++generation;
+    for (auto it = prefetched.begin(); it != prefetched.end(); ) {
+        if (it->second.generation < generation - 1) {
+            it = prefetched.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (std::size_t i = 0U; i < requests.size(); ++i) {
+        if (requests[i].found) {
+            prefetched[readPaths[i]] = Prefetched {
+                language, std::move(contents[i]), std::move(requests[i].xml),
+                generation
+            };
+        }
+    }
+}
+
+void
+SrcmlBatcher::parse(boost::string_ref contents, const std::string &path,
+                    const std::string &language, XmlHandler &handler)
+{
+    static const int maxRunning = getMaxRunning();
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto it = prefetched.find(path);
+    if (it != prefetched.end()) {
+        Prefetched unit = std::move(it->second);
+        prefetched.erase(it);
+        lock.unlock();
+
+        // Unit is of no use if the file has changed since it was prefetched.
+        if (unit.language == language && unit.contents == contents) {
+            XmlParser parser(handler);
+            parser.feed(unit.xml);
+            parser.finish();
+            return;
+        }
+
+        lock.lock();
+    }
+
+    Request request {
+        contents, path, language, &handler, false, false, {}, {}
+    };
+
+    queue.push_back(&request);
+    while (!request.done) {
+        if (running >= maxRunning) {
+            finished.wait(lock);
+            continue;
+        }
+
+        // Take requests for the same language, others wait for a batch of
+        // their own.
+        std::vector<Request *> batch;
+        auto sameLanguage = [&](const Request *r) {
+            return r->language == language;
+        };
+        auto it = std::stable_partition(queue.begin(), queue.end(),
+                                        sameLanguage);
+        batch.assign(queue.begin(), it);
+        queue.erase(queue.begin(), it);
+
+        ++running;
+        lock.unlock();
+        run(batch);
+        lock.lock();
+        --running;
+
+        for (Request *r : batch) {
+            r->done = true;
+        }
+        finished.notify_all();
+    }
+    lock.unlock();
+
+    if (request.error) {
+        std::rethrow_exception(request.error);
+    }
+
+    // Unit extracted from an archive is transformed by the thread that needs
+    // it rather than by the one that ran the batch.
+    if (request.found) {
+        XmlParser parser(handler);
+        parser.feed(request.xml);
+        parser.finish();
+    }
+}
+
+int
+SrcmlBatcher::getMaxRunning()
+{
+    // Batches are limited in number so that requests have a chance to queue
+    // up, yet srcml processes still run in parallel on a machine with many
+    // cores.
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()/4));
+}
+
+void
+SrcmlBatcher::run(const std::vector<Request *> &batch)
+{
+    if (batch.size() > 1U) {
+        runBatch(batch);
+    }
+
+    // Single file is processed in a regular way, which has workarounds for
+    // its failures.
+    for (Request *request : batch) {
+        if (!request->found) {
+            try {
+                runSrcml(request->contents, request->path, request->language,
+                         *request->handler);
+            } catch (...) {
+                request->error = std::current_exception();
+            }
+        }
+    }
+}
+
+void
+SrcmlBatcher::runBatch(const std::vector<Request *> &batch)
+{
+    std::vector<std::unique_ptr<TempFile>> files;
+    std::vector<std::string> cmd = {
+        "srcml", "--language=" + batch.front()->language,
+        "--src-encoding=utf8"
+    };
+
+    for (const Request *request : batch) {
+        files.emplace_back(new TempFile(request->path));
+
+        std::ofstream ofs(*files.back());
+        if (!ofs) {
+            return;
+        }
+        ofs << request->contents;
+        ofs.close();
+
+        cmd.push_back(*files.back());
+    }
+
+    // Files of the batch turn into units of an archive.  Units are matched by
+    // their file names, files without units are parsed separately.
+    std::vector<std::string> xmls(batch.size());
+    std::vector<bool> found(batch.size());
+    auto sink = [&](const std::string &fileName, std::string xml) {
+        for (std::size_t i = 0U; i < batch.size(); ++i) {
+            if (!found[i] && files[i]->str() == fileName) {
+                xmls[i] = std::move(xml);
+                found[i] = true;
+                break;
+            }
+        }
+    };
+
+    try {
+        UnitSplitter splitter(sink);
+        readCommandOutput(cmd, std::string(),
+                          [&splitter](boost::string_ref chunk) {
+                              splitter.feed(chunk);
+                          });
+        splitter.finish();
+    } catch (const std::exception &) {
+        // Files without results are parsed separately.
+        return;
+    }
+
+    for (std::size_t i = 0U; i < batch.size(); ++i) {
+        if (found[i]) {
+            batch[i]->xml = std::move(xmls[i]);
+            batch[i]->found = true;
+        }
     }
 }
 
@@ -126,9 +582,9 @@ asUniquePtr(T *p, D &&d)
 }
 
 static bool
-toLibSrcmlForm(const std::string &contents,
+toLibSrcmlForm(boost::string_ref contents,
                const std::string &language,
-               ti::XMLDocument &doc)
+               XmlHandler &handler)
 {
 #ifdef HAVE_LIBSRCML
     auto archive = asUniquePtr(srcml_archive_create(), &srcml_archive_free);
@@ -182,55 +638,104 @@ toLibSrcmlForm(const std::string &contents,
     srcml_archive_close(archive.get());
     auto bufGuard = asUniquePtr(buffer, &std::free);
 
-    (void)doc.Parse(buffer, size);
+    XmlParser parser(handler);
+    parser.feed(boost::string_ref(buffer, size));
+    parser.finish();
     return true;
 #else
-    (void)contents, (void)language, (void)doc;
+    (void)contents, (void)language, (void)handler;
     return false;
 #endif
 }
 
-PNode *
-SrcmlTransformer::visit(ti::XMLNode *node, int level)
+void
+SrcmlTransformer::startElement(boost::string_ref name, const XmlAttrs &attrs)
 {
-    if (node == nullptr) {
-        return tb.addNode();
+    // Only the first top-level element is transformed.
+    if (skipped != 0 || (frames.empty() && root != nullptr)) {
+        ++skipped;
+        return;
+    }
+
+    bool firstChild = true;
+    if (!frames.empty()) {
+        Frame &parent = frames.back();
+        if (parent.hasPending) {
+            visitLeaf(false);
+        }
+        firstChild = (parent.children++ == 0);
     }
 
+    const std::string nameStr = name.to_string();
+
     SType stype = {};
-    auto it = map.find(node->Value());
+    auto it = map.find(nameStr);
     if (it != map.end()) {
         stype = it->second;
     }
 
-    bool cppDirective = boost::starts_with(node->Value(), "cpp:");
+    const std::string *type = findXmlAttr(attrs, "type");
+
+    bool cppDirective = boost::starts_with(name, "cpp:");
     inCppDirective += cppDirective;
 
-    PNode *pnode = tb.addNode({}, stype);
+    frames.push_back(Frame {
+        tb.addNode({}, stype), nameStr,
+        (type == nullptr ? std::string() : *type),
+        cppDirective, firstChild, 0, false, false, {}
+    });
+}
 
-    for (ti::XMLNode *child = node->FirstChild();
-         child != nullptr;
-         child = child->NextSibling()) {
-        if (ti::XMLElement *e = child->ToElement()) {
-            tb.append(pnode, visit(e, level + 1));
-        } else if (child->ToText() != nullptr) {
-            visitLeaf(node, pnode, child);
-        }
+void
+SrcmlTransformer::endElement(boost::string_ref /*name*/)
+{
+    if (skipped != 0) {
+        --skipped;
+        return;
+    }
+
+    if (frames.back().hasPending) {
+        visitLeaf(true);
     }
 
-    inCppDirective -= cppDirective;
+    PNode *pnode = frames.back().pnode;
+    inCppDirective -= frames.back().cppDirective;
+    frames.pop_back();
 
-    return pnode;
+    if (frames.empty()) {
+        root = pnode;
+    } else {
+        tb.append(frames.back().pnode, pnode);
+    }
 }
 
 void
-SrcmlTransformer::visitLeaf(ti::XMLNode *parent, PNode *pnode,
-                            ti::XMLNode *leaf)
+SrcmlTransformer::text(boost::string_ref text)
 {
-    boost::string_ref fullVal = processValue(leaf->Value());
+    if (skipped != 0 || frames.empty()) {
+        return;
+    }
+
+    Frame &frame = frames.back();
+    if (frame.hasPending) {
+        visitLeaf(false);
+    }
+
+    frame.hasPending = true;
+    frame.pendingFirst = (frame.children++ == 0);
+    frame.pending.assign(text.data(), text.size());
+}
+
+void
+SrcmlTransformer::visitLeaf(bool last)
+{
+    Frame &frame = frames.back();
+    frame.hasPending = false;
+
+    boost::string_ref fullVal = processValue(frame.pending);
 
     SType stype = {};
-    if (leaf != parent->FirstChild() || leaf->NextSibling() != nullptr) {
+    if (!frame.pendingFirst || !last) {
         stype = map.at("separator");
     }
 
@@ -248,11 +753,11 @@ SrcmlTransformer::visitLeaf(ti::XMLNode *parent, PNode *pnode,
         updatePosition(left.substr(0U, skipped), tabWidth, line, col);
         left.remove_prefix(skipped);
 
-        const Type type = determineType(parent->ToElement(), val);
+        const Type type = determineType(val);
 
         const auto offset = static_cast<std::uint32_t>(&left[0] - &contents[0]);
         const auto len = static_cast<std::uint32_t>(val.size());
-        tb.append(pnode,
+        tb.append(frame.pnode,
                   tb.addNode(Text{offset, len, 0, 0, static_cast<int>(type)},
                              Location{line, col, 0, 0}, stype));
 
@@ -279,11 +784,12 @@ processValue(boost::string_ref str)
 }
 
 Type
-SrcmlTransformer::determineType(ti::XMLElement *elem, boost::string_ref value)
+SrcmlTransformer::determineType(boost::string_ref value)
 {
-    boost::string_ref elemValue = elem->Value();
+    const Frame &elem = frames.back();
+    const std::string &elemValue = elem.name;
     if (elemValue == "literal") {
-        const std::string type = elem->Attribute("type");
+        const std::string &type = elem.type;
         if (type == "boolean") {
             return Type::IntConstants;
         } else if (type == "char") {
@@ -310,19 +816,23 @@ SrcmlTransformer::determineType(ti::XMLElement *elem, boost::string_ref value)
     } else if (elemValue == "operator") {
         return Type::Operators;
     } else if (elemValue == "name") {
-        const ti::XMLNode *parent = elem;
-        std::string parentValue;
-        std::string grandParentValue;
-        do {
-            parent = parent->Parent();
-            parentValue = (parent == nullptr ? "" : parent->Value());
-            grandParentValue = (parent->Parent() == nullptr)
-                             ? ""
-                             : parent->Parent()->Value();
-        } while (parentValue == "name" &&
-                 (elem != parent->FirstChild() ||
-                  (grandParentValue != "function" &&
-                   grandParentValue != "call")));
+        auto ancestor = [this](std::size_t i, std::size_t up) {
+            return (i < up ? boost::string_ref()
+                           : boost::string_ref(frames[i - up].name));
+        };
+
+        std::size_t i = frames.size() - 1U;
+        bool first = elem.firstChild;
+        boost::string_ref parentValue = ancestor(i, 1U);
+        boost::string_ref grandParentValue = ancestor(i, 2U);
+        while (parentValue == "name" &&
+               (!first || (grandParentValue != "function" &&
+                           grandParentValue != "call"))) {
+            --i;
+            first = false;
+            parentValue = ancestor(i, 1U);
+            grandParentValue = ancestor(i, 2U);
+        }
 
         if (keywords.find(value.to_string()) != keywords.cend()) {
             return Type::Keywords;
@@ -22,13 +22,11 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <boost/utility/string_ref.hpp>
 
-namespace tinyxml2 {
-    class XMLElement;
-    class XMLNode;
-}
+#include "XmlParser.hpp"
 
 class PNode;
 class TreeBuilder;
@@ -36,13 +34,28 @@ class TreeBuilder;
 enum class SType : std::uint8_t;
 enum class Type : std::uint8_t;
 
-// Uses srcml to parse a file and transforms the result into PTree.
-class SrcmlTransformer
+// Uses srcml to parse a file and transforms the result into PTree.  Output of
+// srcml is processed as a stream of elements without building its DOM.
+class SrcmlTransformer : private XmlHandler
 {
+    // Element that is being processed.
+    struct Frame
+    {
+        PNode *pnode;        // Node of the element.
+        std::string name;    // Name of the element.
+        std::string type;    // Value of "type" attribute.
+        bool cppDirective;   // Whether this is a preprocessor element.
+        bool firstChild;     // Whether this is the first child of its parent.
+        int children;        // Number of children seen so far.
+        bool hasPending;     // Whether `pending` holds a text.
+        bool pendingFirst;   // Whether pending text is the first child.
+        std::string pending; // Last text which wasn't added to the tree yet.
+    };
+
 public:
     // Remembers parameters to use them later.  `contents`, `map` and `keywords`
     // have to be lvalues.
-    SrcmlTransformer(const std::string &contents,
+    SrcmlTransformer(boost::string_ref contents,
                      const std::string &path,
                      TreeBuilder &tb,
                      const std::string &language,
@@ -50,21 +63,33 @@ public:
                      const std::unordered_set<std::string> &keywords,
                      int tabWidth);
 
+public:
+    // Checks whether prefetching files does anything.
+    static bool canPrefetch();
+    // Hints that the files are about to be transformed, which allows running
+    // srcml on several of them at once.
+    static void prefetch(const std::vector<std::string> &paths,
+                         const std::string &language);
+
 public:
     // Does all the work of transforming.
     void transform();
 
 private:
-    // Transforms single element into a node.
-    PNode * visit(tinyxml2::XMLNode *node, int level);
-    // Transforms text field.
-    void visitLeaf(tinyxml2::XMLNode *parent, PNode *pnode,
-                   tinyxml2::XMLNode *leaf);
-    // Determines type of a child of the specified element.
-    Type determineType(tinyxml2::XMLElement *elem, boost::string_ref value);
+    // Starts transforming an element into a node.
+    virtual void startElement(boost::string_ref name,
+                              const XmlAttrs &attrs) override;
+    // Finishes transforming an element and attaches it to its parent.
+    virtual void endElement(boost::string_ref name) override;
+    // Remembers text until it's known whether it's the last child.
+    virtual void text(boost::string_ref text) override;
+    // Transforms pending text of the current element into leaves.
+    void visitLeaf(bool last);
+    // Determines type of a child of the current element.
+    Type determineType(boost::string_ref value);
 
 private:
-    const std::string &contents;                       // Contents to parse.
+    boost::string_ref contents;                        // Contents to parse.
     const std::string &path;                           // Path to the file.
     boost::string_ref left;                            // Unparsed part.
     TreeBuilder &tb;                                   // Result builder.
@@ -75,6 +100,9 @@ private:
     int line;                                          // Current line.
     int col;                                           // Current column.
     int inCppDirective;                                // Level of cpp nesting.
+    std::vector<Frame> frames;                         // Open elements.
+    PNode *root;                                       // Root of the tree.
+    int skipped;                                       // Depth of ignored XML.
 };
 
 #endif // ZOGRASCOPE_SRCML_SRCMLTRANSFORMER_HPP_
@@ -0,0 +1,386 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "XmlParser.hpp"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+
+#include <stdexcept>
+#include <string>
+
+#include <boost/utility/string_ref.hpp>
+
+static bool isSpace(char c);
+static bool isBlank(boost::string_ref str);
+static void decode(boost::string_ref raw, bool entities, std::string &out);
+static std::size_t decodeCharRef(boost::string_ref raw, std::string &out);
+static void appendUtf8(unsigned long code, std::string &out);
+
+const std::string *
+findXmlAttr(const XmlAttrs &attrs, boost::string_ref name)
+{
+    for (const auto &attr : attrs) {
+        if (attr.first == name) {
+            return &attr.second;
+        }
+    }
+    return nullptr;
+}
+
+XmlParser::XmlParser(XmlHandler &handler) : handler(handler)
+{ }
+
+void
+XmlParser::feed(boost::string_ref chunk)
+{
+    buffer.append(chunk.data(), chunk.size());
+    process(false);
+}
+
+void
+XmlParser::finish()
+{
+    process(true);
+
+    if (!open.empty()) {
+        throw std::runtime_error("Unclosed XML element: " + open.back());
+    }
+    if (empty) {
+        throw std::runtime_error("Empty XML document");
+    }
+}
+
+void
+XmlParser::process(bool last)
+{
+    while (pos != buffer.size() && processToken(last)) {
+        // Keep processing.
+    }
+
+    // Drop processed part of the buffer.
+    buffer.erase(0U, pos);
+    consumed += pos;
+    pos = 0U;
+}
+
+bool
+XmlParser::processToken(bool last)
+{
+    boost::string_ref rest(buffer.data() + pos, buffer.size() - pos);
+    tokenStart = pos;
+
+    // Skips a construct that ends with the terminator.
+    auto skipTo = [&](boost::string_ref terminator) {
+        std::size_t end = rest.find(terminator);
+        if (end == boost::string_ref::npos) {
+            if (last) {
+                throw std::runtime_error("Unterminated XML construct");
+            }
+            return false;
+        }
+        tokenEnd = pos + end + terminator.size();
+        pos = tokenEnd;
+        return true;
+    };
+
+    if (rest.front() != '<') {
+        std::size_t end = rest.find('<');
+        if (end == boost::string_ref::npos) {
+            if (!last) {
+                return false;
+            }
+            end = rest.size();
+        }
+
+        tokenEnd = pos + end;
+        pos = tokenEnd;
+
+        // Whitespace between elements doesn't produce text nodes.
+        boost::string_ref raw = rest.substr(0U, end);
+        if (!isBlank(raw)) {
+            empty = false;
+            decode(raw, true, text);
+            handler.text(text);
+        }
+        return true;
+    }
+
+    // Make sure there is enough input to determine type of the construct.
+    static const boost::string_ref cdata = "<![CDATA[";
+    if (!last && rest.size() < cdata.size()) {
+        return false;
+    }
+
+    empty = false;
+
+    if (rest.starts_with("<!--")) {
+        return skipTo("-->");
+    }
+
+    if (rest.starts_with(cdata)) {
+        if (!skipTo("]]>")) {
+            return false;
+        }
+        decode(rest.substr(cdata.size(), tokenEnd - tokenStart - cdata.size()
+                                       - 3U),
+               false, text);
+        handler.text(text);
+        return true;
+    }
+
+    if (rest.starts_with("<?")) {
+        return skipTo("?>");
+    }
+
+    if (rest.starts_with("<!")) {
+        return skipTo(">");
+    }
+
+    if (rest.starts_with("</")) {
+        if (!skipTo(">")) {
+            return false;
+        }
+
+        boost::string_ref name = rest.substr(2U, tokenEnd - tokenStart - 3U);
+        while (!name.empty() && isSpace(name.back())) {
+            name.remove_suffix(1U);
+        }
+        if (open.empty() || name != open.back()) {
+            throw std::runtime_error("Mismatched XML closing tag: " +
+                                     name.to_string());
+        }
+
+        handler.endElement(name);
+        open.pop_back();
+        return true;
+    }
+
+    // Find end of the tag skipping over quoted attribute values.
+    char quote = '\0';
+    for (std::size_t i = 1U; i < rest.size(); ++i) {
+        const char c = rest[i];
+        if (quote != '\0') {
+            if (c == quote) {
+                quote = '\0';
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            processTag(pos + i + 1U);
+            return true;
+        }
+    }
+
+    if (last) {
+        throw std::runtime_error("Unterminated XML tag");
+    }
+    return false;
+}
+
+void
+XmlParser::processTag(std::size_t end)
+{
+    tokenEnd = end;
+
+    boost::string_ref tag(buffer.data() + pos + 1U, end - pos - 2U);
+    pos = end;
+
+    const bool selfClosing = (!tag.empty() && tag.back() == '/');
+    if (selfClosing) {
+        tag.remove_suffix(1U);
+    }
+
+    auto skipSpaces = [&tag]() {
+        while (!tag.empty() && isSpace(tag.front())) {
+            tag.remove_prefix(1U);
+        }
+    };
+    auto takeName = [&tag]() {
+        std::size_t len = 0U;
+        while (len < tag.size() && !isSpace(tag[len]) && tag[len] != '=') {
+            ++len;
+        }
+        boost::string_ref name = tag.substr(0U, len);
+        tag.remove_prefix(len);
+        return name;
+    };
+
+    boost::string_ref name = takeName();
+    if (name.empty()) {
+        throw std::runtime_error("XML element without a name");
+    }
+
+    attrs.clear();
+    while (skipSpaces(), !tag.empty()) {
+        boost::string_ref attrName = takeName();
+        skipSpaces();
+        if (attrName.empty() || tag.empty() || tag.front() != '=') {
+            throw std::runtime_error("Malformed XML attribute");
+        }
+        tag.remove_prefix(1U);
+        skipSpaces();
+
+        if (tag.empty() || (tag.front() != '"' && tag.front() != '\'')) {
+            throw std::runtime_error("Unquoted XML attribute value");
+        }
+        const char quote = tag.front();
+        tag.remove_prefix(1U);
+
+        const std::size_t valueEnd = tag.find(quote);
+        if (valueEnd == boost::string_ref::npos) {
+            throw std::runtime_error("Unterminated XML attribute value");
+        }
+
+        std::string value;
+        decode(tag.substr(0U, valueEnd), true, value);
+        attrs.emplace_back(attrName.to_string(), std::move(value));
+        tag.remove_prefix(valueEnd + 1U);
+    }
+
+    open.push_back(name.to_string());
+    handler.startElement(name, attrs);
+    if (selfClosing) {
+        handler.endElement(name);
+        open.pop_back();
+    }
+}
+
+// Checks whether character is a whitespace in the same sense as tinyxml2 uses.
+static bool
+isSpace(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) &&
+           (static_cast<unsigned char>(c) & 0x80) == 0;
+}
+
+// Checks whether string consists of whitespace only.
+static bool
+isBlank(boost::string_ref str)
+{
+    for (char c : str) {
+        if (!isSpace(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Normalizes line endings and optionally decodes entities of raw text.
+static void
+decode(boost::string_ref raw, bool entities, std::string &out)
+{
+    static const struct {
+        boost::string_ref pattern;
+        char value;
+    } namedEntities[] = {
+        { "quot;", '"' },
+        { "amp;", '&' },
+        { "apos;", '\'' },
+        { "lt;", '<' },
+        { "gt;", '>' },
+    };
+
+    out.clear();
+    out.reserve(raw.size());
+
+    for (std::size_t i = 0U; i < raw.size(); ) {
+        const char c = raw[i];
+
+        // Any of "\r\n", "\n\r" or "\r" becomes "\n".
+        if (c == '\r' || c == '\n') {
+            const char pair = (c == '\r' ? '\n' : '\r');
+            i += (i + 1U < raw.size() && raw[i + 1U] == pair ? 2U : 1U);
+            out += '\n';
+            continue;
+        }
+
+        if (entities && c == '&') {
+            boost::string_ref entity = raw.substr(i + 1U);
+            if (!entity.empty() && entity.front() == '#') {
+                if (std::size_t len = decodeCharRef(raw.substr(i), out)) {
+                    i += len;
+                    continue;
+                }
+            } else {
+                bool found = false;
+                for (const auto &named : namedEntities) {
+                    if (entity.starts_with(named.pattern)) {
+                        out += named.value;
+                        i += 1U + named.pattern.size();
+                        found = true;
+                        break;
+                    }
+                }
+                if (found) {
+                    continue;
+                }
+            }
+        }
+
+        out += c;
+        ++i;
+    }
+}
+
+// Decodes numeric character reference at the start of the string.  Returns
+// its length or zero if it's invalid.
+static std::size_t
+decodeCharRef(boost::string_ref raw, std::string &out)
+{
+    const bool hex = (raw.size() > 2U && (raw[2] == 'x' || raw[2] == 'X'));
+    const std::size_t start = (hex ? 3U : 2U);
+
+    const std::size_t end = raw.find(';');
+    if (end == boost::string_ref::npos || end == start) {
+        return 0U;
+    }
+
+    const std::string digits = raw.substr(start, end - start).to_string();
+    char *digitsEnd;
+    const unsigned long code = std::strtoul(digits.c_str(), &digitsEnd,
+                                            hex ? 16 : 10);
+    if (*digitsEnd != '\0' || !std::isxdigit(digits.front()) ||
+        code > 0x10FFFFUL) {
+        return 0U;
+    }
+
+    appendUtf8(code, out);
+    return end + 1U;
+}
+
+// Appends Unicode code point in UTF-8 encoding.
+static void
+appendUtf8(unsigned long code, std::string &out)
+{
+    if (code < 0x80UL) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800UL) {
+        out += static_cast<char>(0xC0UL | (code >> 6));
+        out += static_cast<char>(0x80UL | (code & 0x3FUL));
+    } else if (code < 0x10000UL) {
+        out += static_cast<char>(0xE0UL | (code >> 12));
+        out += static_cast<char>(0x80UL | ((code >> 6) & 0x3FUL));
+        out += static_cast<char>(0x80UL | (code & 0x3FUL));
+    } else {
+        out += static_cast<char>(0xF0UL | (code >> 18));
+        out += static_cast<char>(0x80UL | ((code >> 12) & 0x3FUL));
+        out += static_cast<char>(0x80UL | ((code >> 6) & 0x3FUL));
+        out += static_cast<char>(0x80UL | (code & 0x3FUL));
+    }
+}
@@ -0,0 +1,101 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ZOGRASCOPE_SRCML_XMLPARSER_HPP_
+#define ZOGRASCOPE_SRCML_XMLPARSER_HPP_
+
+#include <cstddef>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+// Attributes of an element as pairs of names and decoded values.
+using XmlAttrs = std::vector<std::pair<std::string, std::string>>;
+
+// Retrieves value of an attribute or `nullptr` if there is no such attribute.
+const std::string * findXmlAttr(const XmlAttrs &attrs, boost::string_ref name);
+
+// Receiver of events produced by XmlParser.  Strings passed to callbacks are
+// valid only during the call.
+class XmlHandler
+{
+public:
+    // Make destructor of derived classes virtual.
+    virtual ~XmlHandler() = default;
+
+public:
+    // Called on opening tag of an element.
+    virtual void startElement(boost::string_ref name,
+                              const XmlAttrs &attrs) = 0;
+    // Called on closing tag of an element.
+    virtual void endElement(boost::string_ref name) = 0;
+    // Called on text that isn't made of whitespace only.  Entities are
+    // decoded and line endings are normalized.
+    virtual void text(boost::string_ref text) = 0;
+};
+
+// Push parser of XML that reports elements and text to a handler as soon as
+// they are complete, so input can be processed while it's being read.  It
+// handles the subset of XML produced by srcml the same way tinyxml2 does:
+// comments, processing instructions and DTD are skipped.
+class XmlParser
+{
+public:
+    // Remembers the handler.
+    explicit XmlParser(XmlHandler &handler);
+
+public:
+    // Processes next piece of input.  Throws `std::runtime_error` if input is
+    // malformed.
+    void feed(boost::string_ref chunk);
+    // Processes the rest of input and checks that the document is complete.
+    // Throws `std::runtime_error` if input is malformed or empty.
+    void finish();
+
+    // Retrieves offset of the first byte of the token being reported.
+    std::size_t getTokenStart() const
+    { return consumed + tokenStart; }
+    // Retrieves offset of the byte that follows the token being reported.
+    std::size_t getTokenEnd() const
+    { return consumed + tokenEnd; }
+
+private:
+    // Processes input as far as possible.  `last` indicates that no more
+    // input is expected.
+    void process(bool last);
+    // Processes single token.  Returns `false` if more input is needed.
+    bool processToken(bool last);
+    // Processes opening tag at the current position, which ends at `end`.
+    void processTag(std::size_t end);
+
+private:
+    XmlHandler &handler;           // Receiver of events.
+    std::string buffer;            // Input that wasn't processed yet.
+    std::size_t pos = 0U;          // Position within the buffer.
+    std::size_t consumed = 0U;     // Offset of the buffer in the input.
+    std::size_t tokenStart = 0U;   // Start of current token in the buffer.
+    std::size_t tokenEnd = 0U;     // End of current token in the buffer.
+    std::vector<std::string> open; // Names of elements that are open.
+    XmlAttrs attrs;                // Attributes of current element.
+    std::string text;              // Decoded text.
+    bool empty = true;             // Whether nothing was found in input.
+};
+
+#endif // ZOGRASCOPE_SRCML_XMLPARSER_HPP_
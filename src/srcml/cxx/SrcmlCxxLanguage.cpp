@@ -28,31 +28,31 @@
 using namespace srcmlcxx;
 
 static void postProcessTree(PNode *node, TreeBuilder &tb,
-                            const std::string &contents);
+                            boost::string_ref contents);
 static bool isConditional(SType stype);
 static void postProcessIf(PNode *node, TreeBuilder &tb,
-                          const std::string &contents);
+                          boost::string_ref contents);
 static void postProcessIfStmt(PNode *node, TreeBuilder &tb,
-                              const std::string &contents);
+                              boost::string_ref contents);
 static void postProcessBlock(PNode *node, TreeBuilder &tb,
-                             const std::string &contents);
+                             boost::string_ref contents);
 static void postProcessEnumDecl(PNode *node, TreeBuilder &tb,
-                                const std::string &contents);
+                                boost::string_ref contents);
 static void postProcessEnum(PNode *node, TreeBuilder &tb,
-                            const std::string &contents);
+                            boost::string_ref contents);
 static void postProcessEnumClass(PNode *node, TreeBuilder &tb,
-                                 const std::string &contents);
+                                 boost::string_ref contents);
 static void postProcessParameterList(PNode *node, TreeBuilder &tb,
-                                     const std::string &contents);
+                                     boost::string_ref contents);
 static bool breakLeaf(PNode *node, TreeBuilder &tb,
-                      const std::string &contents, char left, char right,
+                      boost::string_ref contents, char left, char right,
                       SrcmlCxxSType newChild);
 static void takeWord(PNode *node, const PNode *of, int len);
 static void skipWord(PNode *node, const PNode *of, int len,
-                     const std::string &contents);
-static void dropLeadingWS(PNode *node, const std::string &contents);
+                     boost::string_ref contents);
+static void dropLeadingWS(PNode *node, boost::string_ref contents);
 static void postProcessConditional(PNode *node, TreeBuilder &tb,
-                                   const std::string &contents);
+                                   boost::string_ref contents);
 
 SrcmlCxxLanguage::SrcmlCxxLanguage()
 {
@@ -188,6 +188,18 @@ SrcmlCxxLanguage::SrcmlCxxLanguage()
     });
 }
 
+bool
+SrcmlCxxLanguage::canPrefetch()
+{
+    return SrcmlTransformer::canPrefetch();
+}
+
+void
+SrcmlCxxLanguage::prefetch(const std::vector<std::string> &fileNames)
+{
+    SrcmlTransformer::prefetch(fileNames, "C++");
+}
+
 Type
 SrcmlCxxLanguage::mapToken(int token) const
 {
@@ -195,7 +207,7 @@ SrcmlCxxLanguage::mapToken(int token) const
 }
 
 TreeBuilder
-SrcmlCxxLanguage::parse(const std::string &contents,
+SrcmlCxxLanguage::parse(boost::string_ref contents,
                         const std::string &fileName, int tabWidth,
                         bool /*debug*/, cpp17::pmr::monolithic &mr) const
 {
@@ -210,7 +222,7 @@ SrcmlCxxLanguage::parse(const std::string &contents,
 
 // Rewrites tree to be more diff-friendly.
 static void
-postProcessTree(PNode *node, TreeBuilder &tb, const std::string &contents)
+postProcessTree(PNode *node, TreeBuilder &tb, boost::string_ref contents)
 {
     if (node->stype == +SrcmlCxxSType::If) {
         postProcessIf(node, tb, contents);
@@ -259,7 +271,7 @@ isConditional(SType stype)
 
 // Rewrites if nodes to be more diff-friendly.
 static void
-postProcessIf(PNode *node, TreeBuilder &/*tb*/, const std::string &/*contents*/)
+postProcessIf(PNode *node, TreeBuilder &/*tb*/, boost::string_ref /*contents*/)
 {
     // Move else-if node to respective if-statement.
     while (node->children.back()->stype == +SrcmlCxxSType::Elseif) {
@@ -278,7 +290,7 @@ postProcessIf(PNode *node, TreeBuilder &/*tb*/, const std::string &/*contents*/)
 
 // Rewrites if statement nodes to be more diff-friendly.
 static void
-postProcessIfStmt(PNode *node, TreeBuilder &tb, const std::string &contents)
+postProcessIfStmt(PNode *node, TreeBuilder &tb, boost::string_ref contents)
 {
     // Move else or else-if nodes to respective if-statement splitting "else-if"
     // into else and if parts.
@@ -322,7 +334,7 @@ postProcessIfStmt(PNode *node, TreeBuilder &tb, const std::string &contents)
 
 // Rewrites block nodes to be more diff-friendly.
 static void
-postProcessBlock(PNode *node, TreeBuilder &tb, const std::string &contents)
+postProcessBlock(PNode *node, TreeBuilder &tb, boost::string_ref contents)
 {
     // Children: `{` block-content `}`
     if (node->children.size() == 3 &&
@@ -372,7 +384,7 @@ postProcessBlock(PNode *node, TreeBuilder &tb, const std::string &contents)
 // Rewrites enumeration class declaration nodes to be more diff-friendly.  This
 // breaks "enum\s+class" into two separate keyword tokens.
 static void
-postProcessEnumDecl(PNode *node, TreeBuilder &tb, const std::string &contents)
+postProcessEnumDecl(PNode *node, TreeBuilder &tb, boost::string_ref contents)
 {
     // Processing here is the same.
     postProcessEnumClass(node, tb, contents);
@@ -381,7 +393,7 @@ postProcessEnumDecl(PNode *node, TreeBuilder &tb, const std::string &contents)
 // Rewrites enumeration nodes to be more diff-friendly.  This turns ",\s*}" into
 // two separate tokens.
 static void
-postProcessEnum(PNode *node, TreeBuilder &tb, const std::string &contents)
+postProcessEnum(PNode *node, TreeBuilder &tb, boost::string_ref contents)
 {
     if (node->children.size() < 2) {
         return;
@@ -419,7 +431,7 @@ postProcessEnum(PNode *node, TreeBuilder &tb, const std::string &contents)
 // Rewrites enumeration class nodes to be more diff-friendly.  This breaks
 // "enum\s+class" into two separate keyword tokens.
 static void
-postProcessEnumClass(PNode *node, TreeBuilder &tb, const std::string &contents)
+postProcessEnumClass(PNode *node, TreeBuilder &tb, boost::string_ref contents)
 {
     PNode *originalKw = node->children.front();
     if (originalKw->value.len <= 4) {
@@ -443,7 +455,7 @@ postProcessEnumClass(PNode *node, TreeBuilder &tb, const std::string &contents)
 // Rewrites parameter list nodes to be more diff-friendly.
 static void
 postProcessParameterList(PNode *node, TreeBuilder &tb,
-                         const std::string &contents)
+                         boost::string_ref contents)
 {
     // Children: `()` (with any whitespace in between).
     if (breakLeaf(node, tb, contents, '(', ')', SrcmlCxxSType::None)) {
@@ -454,7 +466,7 @@ postProcessParameterList(PNode *node, TreeBuilder &tb,
 // Breaks pairs of glued single character tokens.  Returns `true` if node was
 // rewritten.
 static bool
-breakLeaf(PNode *node, TreeBuilder &tb, const std::string &contents,
+breakLeaf(PNode *node, TreeBuilder &tb, boost::string_ref contents,
           char left, char right, SrcmlCxxSType newChild)
 {
     // Children: `<left><right>` (with any whitespace in between).
@@ -502,7 +514,7 @@ takeWord(PNode *node, const PNode *of, int len)
 
 // Sets node label to label of a different node after dropping prefix from it.
 static void
-skipWord(PNode *node, const PNode *of, int len, const std::string &contents)
+skipWord(PNode *node, const PNode *of, int len, boost::string_ref contents)
 {
     assert(static_cast<int>(of->value.len) > len &&
            "Word length is too large.");
@@ -517,7 +529,7 @@ skipWord(PNode *node, const PNode *of, int len, const std::string &contents)
 
 // Corrects node data to exclude leading whitespace.
 static void
-dropLeadingWS(PNode *node, const std::string &contents)
+dropLeadingWS(PNode *node, boost::string_ref contents)
 {
     const char *pos = &contents[node->value.from];
     while (node->value.len > 0 && (*pos == '\n' || *pos == ' ')) {
@@ -537,7 +549,7 @@ dropLeadingWS(PNode *node, const std::string &contents)
 // level up.
 static void
 postProcessConditional(PNode *node, TreeBuilder &/*tb*/,
-                       const std::string &/*contents*/)
+                       boost::string_ref /*contents*/)
 {
     auto pred = [](const PNode *n) {
         return n->stype == +SrcmlCxxSType::Condition;
@@ -773,6 +785,12 @@ SrcmlCxxLanguage::classify(SType stype) const
     }
 }
 
+bool
+SrcmlCxxLanguage::isValidSType(SType stype) const
+{
+    return -stype <= SrcmlCxxSType::While;
+}
+
 const char *
 SrcmlCxxLanguage::toString(SType stype) const
 {
@@ -17,8 +17,10 @@
 #ifndef ZOGRASCOPE_SRCML_CXX_SRCMLCXXLANGUAGE_HPP_
 #define ZOGRASCOPE_SRCML_CXX_SRCMLCXXLANGUAGE_HPP_
 
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "Language.hpp"
 
@@ -29,11 +31,17 @@ public:
     // Initializes C++-specific data.
     SrcmlCxxLanguage();
 
+public:
+    // Checks whether prefetch() does anything.
+    static bool canPrefetch();
+    // Parses the files at once ahead of their parsing via `parse()`.
+    static void prefetch(const std::vector<std::string> &fileNames);
+
 public:
     // Maps language-specific token to an element of Type enumeration.
     virtual Type mapToken(int token) const override;
     // Parses source file into a tree.
-    virtual TreeBuilder parse(const std::string &contents,
+    virtual TreeBuilder parse(boost::string_ref contents,
                               const std::string &fileName,
                               int tabWidth,
                               bool debug,
@@ -82,6 +90,7 @@ public:
     // Maps language-specific stype to generic mtype.
     virtual MType classify(SType stype) const override;
     // Stringifies value of SType enumeration.
+    virtual bool isValidSType(SType stype) const override;
     virtual const char * toString(SType stype) const override;
 
 private:
@@ -17,14 +17,17 @@
 #include "Finder.hpp"
 
 #include <boost/range/adaptor/reversed.hpp>
-#include <boost/optional.hpp>
 
 #include "pmr/monolithic.hpp"
 
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <utility>
 
-#include "utils/optional.hpp"
+#include "utils/ArenaPool.hpp"
+#include "utils/time.hpp"
 #include "ColorScheme.hpp"
 #include "Grepper.hpp"
 #include "Matcher.hpp"
@@ -121,65 +124,70 @@ Finder::~Finder() = default;
 bool
 Finder::search()
 {
-    bool found = Traverser(paths, env.getCommonArgs().lang, env.getConfig(),
-                           [this](const std::string &path) {
-                               return process(path);
+    const CommonArgs &args = env.getCommonArgs();
+    bool found = Traverser(paths, args.lang, env.getConfig(),
+                           env.getTimeKeeper(), getParsingJobs(args),
+                           [this](const std::string &path, TimeReport &tr) {
+                               return prepare(path, tr);
                            }).search();
     report();
     return found;
 }
 
+std::function<bool(const std::string &path)>
+Finder::prepare(const std::string &path, TimeReport &tr)
+{
+    auto parsed = std::make_shared<ParsedFile>(arenas);
+    parsed->parse(env, tr, path);
+
+    return [this, parsed, &tr](const std::string &path) {
+        return !parsed->tree.isEmpty() && process(path, parsed->tree, tr);
+    };
+}
+
 bool
-Finder::process(const std::string &path)
+Finder::process(const std::string &path, Tree &tree, TimeReport &tr)
 {
     static ColorScheme cs;
 
-    cpp17::pmr::monolithic mr;
-    if (optional_t<Tree> &&t = buildTreeFromFile(env, path, &mr)) {
-        auto timer = env.getTimeKeeper().measure("looking: " + path);
-
-        Tree tree = *t;
-        Language &lang = *tree.getLanguage();
-        const bool countOnly = this->countOnly;
-        const bool noMatchers = matchers.empty();
-
-        auto grepHandler = [&](const std::vector<Node *> &match) {
-            if (!noMatchers || countOnly) {
-                return;
-            }
-
-            Node fakeRoot;
-            fakeRoot.children.assign(match.cbegin(), match.cend());
-
-            const Node *node = match.front();
-            std::cout << (cs[ColorGroup::Path] << path) << ':'
-                      << (cs[ColorGroup::LineNoPart] << node->line) << ':'
-                      << (cs[ColorGroup::ColNoPart] << node->col) << ": "
-                      << AutoNL { TermHighlighter(fakeRoot, lang, true,
-                                                  node->line).print() }
-                      << '\n';
-        };
-
-        if (noMatchers) {
-            return grepper.grep(tree.getRoot(), grepHandler);
-        }
+    auto timer = tr.measure("looking: " + path);
+
+    Language &lang = *tree.getLanguage();
+    const bool countOnly = this->countOnly;
+    const bool noMatchers = matchers.empty();
 
-        auto matchHandler = [&](Node *node) {
-            if (!grepper.grep(node, grepHandler) || countOnly) {
-                return;
-            }
+    auto grepHandler = [&](const std::vector<Node *> &match) {
+        if (!noMatchers || countOnly) {
+            return;
+        }
 
-            std::cout << (cs[ColorGroup::Path] << path) << ':'
-                      << (cs[ColorGroup::LineNoPart] << node->line) << ':'
-                      << (cs[ColorGroup::ColNoPart] << node->col) << ": "
-                      << AutoNL { TermHighlighter(*node, lang, true,
-                                                  node->line).print() }
-                      << '\n';
-        };
+        const Node *node = match.front();
+        std::cout << (cs[ColorGroup::Path] << path) << ':'
+                  << (cs[ColorGroup::LineNoPart] << node->line) << ':'
+                  << (cs[ColorGroup::ColNoPart] << node->col) << ": "
+                  << AutoNL { TermHighlighter(match, lang, true,
+                                              node->line).print() }
+                  << '\n';
+    };
 
-        return matchers.front().match(tree.getRoot(), lang, matchHandler);
+    if (noMatchers) {
+        return grepper.grep(tree.getRoot(), grepHandler);
     }
-    return false;
+
+    auto matchHandler = [&](Node *node) {
+        if (!grepper.grep(node, grepHandler) || countOnly) {
+            return;
+        }
+
+        std::cout << (cs[ColorGroup::Path] << path) << ':'
+                  << (cs[ColorGroup::LineNoPart] << node->line) << ':'
+                  << (cs[ColorGroup::ColNoPart] << node->col) << ": "
+                  << AutoNL { TermHighlighter(*node, lang, true,
+                                              node->line).print() }
+                  << '\n';
+    };
+
+    return matchers.front().match(tree.getRoot(), lang, matchHandler);
 }
 
 void
@@ -18,13 +18,17 @@
 #define ZOGRASCOPE_TOOLING_FINDER_HPP_
 
 #include <deque>
+#include <functional>
 #include <string>
 
+#include "utils/ArenaPool.hpp"
 #include "Grepper.hpp"
 #include "Matcher.hpp"
 
 class Environment;
 class Config;
+class TimeReport;
+class Tree;
 
 // Processes files and looks for matches in them.
 class Finder
@@ -40,8 +44,11 @@ public:
     bool search();
 
 private:
-    // Processes single file.
-    bool process(const std::string &path);
+    // Parses single file.  Returns function that processes it.
+    std::function<bool(const std::string &path)>
+    prepare(const std::string &path, TimeReport &tr);
+    // Processes single parsed file.
+    bool process(const std::string &path, Tree &tree, TimeReport &tr);
     // Prints report with statistics about results.
     void report();
 
@@ -51,6 +58,7 @@ private:
     std::vector<std::string> paths; // List of paths to process.
     std::deque<Matcher> matchers;   // Storage of matchers.
     Grepper grepper;                // Finder of consecutive tokens.
+    ArenaPool arenas;               // Memory for trees of files.
 };
 
 #endif // ZOGRASCOPE_TOOLING_FINDER_HPP_
@@ -19,17 +19,23 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/regex.hpp>
 
 #include <cassert>
+#include <cstddef>
 
-#include <regex>
+#include <algorithm>
+#include <deque>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "tree.hpp"
 
-// Finds specified pattern of tokens in a tree.
+// Finds sequences of consecutive tokens that match one of patterns.  Patterns
+// are matched simultaneously by a bit-parallel automaton (shift-and), which
+// tracks all partial matches at once including overlapping ones.
 class Grepper
 {
     class Expr;
@@ -38,11 +44,19 @@ public:
     // Constructs grepper for the specified pattern.
     Grepper(const std::vector<std::string> &pattern = {});
 
+public:
+    // Constructs grepper that looks for all of the patterns in a single pass.
+    static Grepper
+    anyOf(const std::vector<std::vector<std::string>> &patterns);
+
 public:
     // Matches leafs of `node` and invokes `handler` on full match.  Returns
     // `true` if at something was matched or pattern is empty, `false`
     // otherwise.  `handler` must be callable as if it has
-    // `void handler(std::vector<Node *> nodes)` signature.
+    // `void handler(std::vector<Node *> nodes)` signature.  Matches don't
+    // overlap, the search continues after the end of the last one.  Of
+    // several patterns that match at the same token only the first one is
+    // reported.
     template <typename F>
     bool grep(Node *node, F &&handler);
 
@@ -53,6 +67,8 @@ public:
     int getSeen() const;
     // Retrieves number of nodes of specified type which were matched.
     int getMatched() const;
+    // Retrieves index of the pattern whose match is passed to the handler.
+    int getMatchedPattern() const;
 
 private:
     // Implementation of `grep` that calls itself recursively after `grep` did
@@ -65,15 +81,31 @@ private:
     template <typename F>
     bool handle(Node *node, F &&handler);
 
+    // Adds pattern to the automaton.
+    void addPattern(const std::vector<std::string> &pattern);
+
 private:
-    std::vector<Expr> pattern; // Expressions to match against.
-    std::vector<Node *> match; // Currently matched nodes.
+    // Distinct expressions to match against, each one is evaluated once per
+    // token.
+    std::vector<Expr> exprs;
+    // Positions within patterns at which each of the expressions occurs.
+    std::vector<boost::dynamic_bitset<>> positions;
+    boost::dynamic_bitset<> always;  // Positions that match any token.
+    boost::dynamic_bitset<> starts;  // First positions of patterns.
+    boost::dynamic_bitset<> ends;    // Last positions of patterns.
+    std::vector<int> lengths;        // Lengths of patterns.
+    std::size_t maxLength = 0U;      // Length of the longest pattern.
+
+    boost::dynamic_bitset<> state;   // Positions reached by partial matches.
+    boost::dynamic_bitset<> accepts; // Positions accepting current token.
+    std::deque<Node *> recent;       // Last `maxLength` visited nodes.
+    std::vector<Node *> match;       // Currently matched nodes.
+    int matchedPattern = -1;         // Index of pattern of the match.
 
     int seen;    // Number of nodes of specified type seen.
     int matched; // Number of nodes of specified which were matched.
 };
 
-// Single token matching expression.
 class Grepper::Expr
 {
     // Type of the expression.
@@ -95,10 +127,16 @@ public:
     // Checks whether given string matches the expression.
     bool matches(boost::string_ref str) const;
 
+    // Checks whether expression matches any string.
+    bool isWildcard() const;
+
+    // Checks whether two expressions match the same strings.
+    bool operator==(const Expr &rhs) const;
+
 private:
-    std::string text;  // Text to match against (if not a regexp).
-    std::regex regexp; // Compiled regexp for regexp type.
-    Type type;         // Type of the expression.
+    std::string text;    // Text to match against (if not a regexp).
+    boost::regex regexp; // Compiled regexp for regexp type.
+    Type type;           // Type of the expression.
 };
 
 inline
@@ -139,18 +177,83 @@ Grepper::Expr::matches(boost::string_ref str) const
         case Type::Prefix:    return boost::starts_with(str, text);
         case Type::Suffix:    return boost::ends_with(str, text);
         case Type::Substring: return boost::contains(str, text);
-        case Type::Regexp:    return std::regex_match(str.begin(), str.end(),
-                                                      regexp);
+        case Type::Regexp:    return boost::regex_match(str.begin(), str.end(),
+                                                        regexp);
         case Type::Wildcard:  return true;
     }
     assert(false && "Type has impossible value.");
     return false;
 }
 
+inline bool
+Grepper::Expr::isWildcard() const
+{
+    return (type == Type::Wildcard);
+}
+
+inline bool
+Grepper::Expr::operator==(const Expr &rhs) const
+{
+    return (type == rhs.type && text == rhs.text);
+}
+
 inline
 Grepper::Grepper(const std::vector<std::string> &pattern)
-    : pattern(pattern.cbegin(), pattern.cend()), seen(0), matched(0)
+    : seen(0), matched(0)
+{
+    if (!pattern.empty()) {
+        addPattern(pattern);
+    }
+}
+
+inline Grepper
+Grepper::anyOf(const std::vector<std::vector<std::string>> &patterns)
 {
+    Grepper grepper;
+    for (const std::vector<std::string> &pattern : patterns) {
+        grepper.addPattern(pattern);
+    }
+    return grepper;
+}
+
+inline void
+Grepper::addPattern(const std::vector<std::string> &pattern)
+{
+    // Empty patterns are kept to preserve indexes of patterns.
+    lengths.push_back(pattern.size());
+    if (pattern.empty()) {
+        return;
+    }
+
+    const std::size_t first = starts.size();
+    const std::size_t size = first + pattern.size();
+
+    for (boost::dynamic_bitset<> &p : positions) {
+        p.resize(size);
+    }
+    always.resize(size);
+    starts.resize(size);
+    ends.resize(size);
+    starts.set(first);
+    ends.set(size - 1U);
+
+    for (std::size_t i = 0U; i < pattern.size(); ++i) {
+        Expr expr(pattern[i]);
+        if (expr.isWildcard()) {
+            always.set(first + i);
+            continue;
+        }
+
+        auto it = std::find(exprs.cbegin(), exprs.cend(), expr);
+        if (it == exprs.cend()) {
+            exprs.push_back(std::move(expr));
+            positions.emplace_back(size);
+            it = exprs.cend() - 1;
+        }
+        positions[it - exprs.cbegin()].set(first + i);
+    }
+
+    maxLength = std::max(maxLength, pattern.size());
 }
 
 template <typename F>
@@ -161,7 +264,9 @@ Grepper::grep(Node *node, F &&handler)
         return true;
     }
 
-    match.clear();
+    state.clear();
+    state.resize(starts.size());
+    recent.clear();
     return grepImpl(node, std::forward<F>(handler));
 }
 
@@ -194,28 +299,55 @@ Grepper::handle(Node *node, F &&handler)
 {
     ++seen;
 
-    if (!pattern[match.size()].matches(node->spelling)) {
-        match.clear();
+    recent.push_back(node);
+    if (recent.size() > maxLength) {
+        recent.pop_front();
+    }
+
+    accepts = always;
+    for (std::size_t i = 0U; i < exprs.size(); ++i) {
+        if (exprs[i].matches(node->spelling)) {
+            accepts |= positions[i];
+        }
+    }
+
+    // Extend all partial matches by one token and start a new one at each
+    // pattern.
+    state <<= 1;
+    state |= starts;
+    state &= accepts;
+
+    if (!state.intersects(ends)) {
         return false;
     }
 
-    match.push_back(node);
-    if (match.size() == pattern.size()) {
+    // Only the first of patterns ending at this token is reported.
+    std::size_t end = 0U;
+    for (std::size_t i = 0U; i < lengths.size(); ++i) {
+        end += lengths[i];
+        if (lengths[i] == 0 || !state.test(end - 1U)) {
+            continue;
+        }
+
         ++matched;
 
+        matchedPattern = i;
+        match.assign(recent.end() - lengths[i], recent.end());
         handler(match);
-        match.clear();
-
-        return true;
+        break;
     }
 
-    return false;
+    // Next match can't overlap with this one.
+    state.reset();
+    matchedPattern = -1;
+
+    return true;
 }
 
 inline bool
 Grepper::empty() const
 {
-    return pattern.empty();
+    return starts.empty();
 }
 
 inline int
@@ -230,4 +362,10 @@ Grepper::getMatched() const
     return matched;
 }
 
+inline int
+Grepper::getMatchedPattern() const
+{
+    return matchedPattern;
+}
+
 #endif // ZOGRASCOPE_TOOLING_GREPPER_HPP_
@@ -17,9 +17,12 @@
 #ifndef ZOGRASCOPE_TOOLING_MATCHER_HPP_
 #define ZOGRASCOPE_TOOLING_MATCHER_HPP_
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-
+#include <stdexcept>
 #include <utility>
+#include <vector>
 
 #include "Language.hpp"
 #include "mtypes.hpp"
@@ -28,17 +31,31 @@
 // Finds a node of specified type that matches another matcher.
 class Matcher
 {
+    // Set of levels of a chain of matchers as a bit mask.
+    using Levels = std::uint64_t;
+
+    // Chain of matchers compiled for a specific language.
+    struct Chain
+    {
+        Chain(const Language &lang, Matcher *first);
+
+        std::array<MType, 256> mtypes; // SType -> MType map of the language.
+        std::vector<Matcher *> levels; // Matchers from outer to inner one.
+    };
+
 public:
     // Constructs matcher that matches `mtype` and delegates nested matching to
     // `nested`.  `nested` matcher can be `nullptr`, in which case `handler`
-    // passed to `match()` is called.
+    // passed to `match()` is called.  Throws `std::invalid_argument` if the
+    // chain is too long.
     Matcher(MType mtype, Matcher *nested);
 
 public:
     // Matches children of `node` and invokes `handler` on the last match in the
     // chain.  Returns `true` if at something was matched, `false` otherwise.
     // `handler` must be callable as if it has `void handler(Node *node)`
-    // signature.
+    // signature.  All matchers of the chain are run in a single traversal of
+    // the tree and `handler` is invoked at most once per node.
     template <typename F>
     bool match(const Node *node, Language &lang, F &&handler);
 
@@ -49,50 +66,113 @@ public:
     // Retrieves number of nodes of specified type which were matched.
     int getMatched() const;
 
+private:
+    // Visits children of the node looking for nodes of levels in `active` set.
+    // Returns set of levels that were matched inside the subtree.
+    template <typename F>
+    static Levels visit(const Chain &chain, const Node *node, Levels active,
+                        F &handler);
+
 private:
     MType mtype;     // Type to match against.
     Matcher *nested; // Nested matcher, can be `nullptr`.
+    int depth;       // Number of matchers in the chain starting at this one.
     int seen;        // Number of nodes of specified type seen.
     int matched;     // Number of nodes of specified which were matched.
 };
 
+inline
+Matcher::Chain::Chain(const Language &lang, Matcher *first)
+{
+    for (std::size_t i = 0U; i < mtypes.size(); ++i) {
+        mtypes[i] = lang.classify(static_cast<SType>(i));
+    }
+
+    for (Matcher *matcher = first; matcher != nullptr;
+         matcher = matcher->nested) {
+        levels.push_back(matcher);
+    }
+}
+
 inline
 Matcher::Matcher(MType mtype, Matcher *nested)
-    : mtype(mtype), nested(nested), seen(0), matched(0)
+    : mtype(mtype), nested(nested),
+      depth(nested == nullptr ? 1 : nested->depth + 1), seen(0), matched(0)
 {
+    if (depth > static_cast<int>(sizeof(Levels)*8U)) {
+        throw std::invalid_argument("Too many nested matchers");
+    }
 }
 
 template <typename F>
 inline bool
 Matcher::match(const Node *node, Language &lang, F &&handler)
+{
+    Chain chain(lang, this);
+    return (visit(chain, node, 1U, handler) & 1U);
+}
+
+template <typename F>
+Matcher::Levels
+Matcher::visit(const Chain &chain, const Node *node, Levels active,
+               F &handler)
 {
     if (node->next != nullptr) {
-        return match(node->next, lang, std::forward<F>(handler));
+        return visit(chain, node->next, active, handler);
     }
 
-    bool foundMatch = false;
-    for (Node *child : node->children) {
-        if (lang.classify(child->stype) != mtype) {
-            foundMatch |= match(child, lang, std::forward<F>(handler));
-            continue;
-        }
+    const std::size_t last = chain.levels.size() - 1U;
 
-        ++seen;
-        if (nested == nullptr ||
-            nested->match(child, lang, std::forward<F>(handler))) {
-            ++matched;
-            foundMatch = true;
+    Levels found = 0U;
+    for (Node *child : node->children) {
+        const auto stype = static_cast<std::uint8_t>(child->stype);
+        const MType mtype = chain.mtypes[stype];
+
+        // Levels this node is seen at and levels active inside of it.
+        Levels seenAt = 0U, inner = 0U;
+        for (std::size_t i = 0U; i <= last; ++i) {
+            const Levels level = Levels(1U) << i;
+            if (!(active & level)) {
+                continue;
+            }
 
-            if (nested == nullptr) {
-                handler(child);
+            if (chain.levels[i]->mtype != mtype) {
+                inner |= level;
+                continue;
             }
 
+            ++chain.levels[i]->seen;
+            seenAt |= level;
+            if (i != last) {
+                inner |= level << 1;
+            }
             if (canNest(mtype)) {
-                match(child, lang, std::forward<F>(handler));
+                inner |= level;
             }
         }
+
+        const Levels lastLevel = Levels(1U) << last;
+        if (seenAt & lastLevel) {
+            handler(child);
+        }
+
+        // Subtree is skipped if nothing can be matched inside of it.
+        const Levels subFound = (inner == 0U)
+                              ? 0U
+                              : visit(chain, child, inner, handler);
+
+        // Node matches if it's the last one in the chain or the next matcher
+        // has found something inside of it.
+        const Levels matchedAt = seenAt & ((subFound >> 1) | lastLevel);
+        for (std::size_t i = 0U; i <= last; ++i) {
+            if (matchedAt & (Levels(1U) << i)) {
+                ++chain.levels[i]->matched;
+            }
+        }
+
+        found |= subFound | matchedAt;
     }
-    return foundMatch;
+    return found;
 }
 
 inline MType
@@ -23,17 +23,28 @@
 #  include <boost/filesystem/directory.hpp>
 #endif
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "tooling/Config.hpp"
+#include "utils/ThreadPool.hpp"
 #include "utils/iterators.hpp"
+#include "utils/time.hpp"
 #include "Language.hpp"
 
 namespace fs = boost::filesystem;
 
+// Maximum number of files per thread that are processed or wait to be
+// finished at the same time.  Bounds memory consumed by prepared files.
+constexpr int maxPendingPerJob = 4;
+// Minimal number of discovered files that are handed to languages at once to
+// be parsed in bulk.
+constexpr int minQueued = 32;
+
 Traverser::Traverser(const std::vector<std::string> &paths,
                      const std::string &language,
                      const Config &config,
@@ -44,13 +55,43 @@ Traverser::Traverser(const std::vector<std::string> &paths,
       callback(std::move(callback))
 { }
 
+Traverser::Traverser(const std::vector<std::string> &paths,
+                     const std::string &language,
+                     const Config &config,
+                     TimeReport &tr,
+                     int jobs,
+                     std::function<prepareCallbackPrototype> prepare)
+    : paths(paths),
+      language(language),
+      config(config),
+      tr(&tr),
+      jobs(jobs),
+      prepare(std::move(prepare))
+{ }
+
+Traverser::~Traverser() = default;
+
 bool
 Traverser::search()
 {
+    if (prepare && jobs > 1) {
+        // Calling thread also executes tasks while it waits for them.
+        pool.reset(new ThreadPool(jobs - 1));
+    }
+
     bool found = false;
     for (fs::path path : paths) {
         found |= search(path);
     }
+    found |= flush();
+    while (!pending.empty()) {
+        found |= finishOne();
+    }
+
+    pool.reset();
+
+    TimeReport::commitAll(reports);
+
     return found;
 }
 
@@ -64,7 +105,7 @@ Traverser::search(const boost::filesystem::path &path)
 
         if (Language::matches(file, language) ||
             Language::equal(config.lookupAttrs(file).lang, language)) {
-            return callback(file);
+            return visit(file);
         }
         return false;
     };
@@ -86,3 +127,103 @@ Traverser::search(const boost::filesystem::path &path)
     }
     return found;
 }
+
+bool
+Traverser::visit(const std::string &path)
+{
+    if (!prepare) {
+        return callback(path);
+    }
+
+    // Holding files back only delays their processing if they can't be
+    // prefetched concurrently.
+    if (pool == nullptr ||
+        (queued.empty() && !Language::canPrefetch(path, getLanguage(path)))) {
+        return schedule(path, {});
+    }
+
+    // Queue is at least as long as the pending list, so files of the previous
+    // batch are done or pending by the time next batch is prefetched.
+    queued.push_back(path);
+    if (queued.size() < static_cast<std::size_t>(std::max(minQueued,
+                                                  jobs*maxPendingPerJob))) {
+        return false;
+    }
+    return flush();
+}
+
+bool
+Traverser::flush()
+{
+    if (queued.empty()) {
+        return false;
+    }
+
+    std::vector<std::string> langs;
+    for (const std::string &path : queued) {
+        langs.push_back(getLanguage(path));
+    }
+
+    // Discovery of files continues while they are being prefetched.
+    const std::vector<std::string> &files = queued;
+    ThreadPool::Task prefetching = pool->submit([files, langs]() {
+        Language::prefetch(files, langs);
+    });
+
+    bool found = false;
+    for (const std::string &path : queued) {
+        found |= schedule(path, prefetching);
+    }
+    queued.clear();
+    return found;
+}
+
+bool
+Traverser::schedule(const std::string &path,
+                    const ThreadPool::Task &prefetching)
+{
+    if (pool == nullptr) {
+        return prepare(path, *tr)(path);
+    }
+
+    Pending file;
+    file.path = path;
+    file.finish = std::make_shared<std::function<callbackPrototype>>();
+    file.tr.reset(new TimeReport(*tr));
+
+    auto finish = file.finish;
+    TimeReport &fileTr = *file.tr;
+    file.task = pool->submit([this, path, finish, &fileTr, prefetching]() {
+        try {
+            pool->wait(prefetching);
+        } catch (...) {
+            // Prefetching is only a hint, the file is parsed regardless.
+        }
+        *finish = prepare(path, fileTr);
+    });
+    pending.push_back(std::move(file));
+
+    bool found = false;
+    while (pending.size() >= static_cast<std::size_t>(jobs*maxPendingPerJob)) {
+        found |= finishOne();
+    }
+    return found;
+}
+
+std::string
+Traverser::getLanguage(const std::string &path) const
+{
+    return (language.empty() ? config.lookupAttrs(path).lang : language);
+}
+
+bool
+Traverser::finishOne()
+{
+    Pending file = std::move(pending.front());
+    pending.pop_front();
+
+    reports.push_back(std::move(file.tr));
+
+    pool->wait(file.task);
+    return (*file.finish)(file.path);
+}
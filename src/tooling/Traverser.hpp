@@ -19,17 +19,37 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <deque>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "utils/ThreadPool.hpp"
+
 class Config;
+class TimeReport;
 
 // Discovers files matching specified arguments and invokes callback on them.
 class Traverser
 {
     // Callback type.  Should return `true` to indicate positive visitation.
     using callbackPrototype = bool(const std::string &path);
+    // Callback type for concurrent processing.  Is invoked on worker threads
+    // and returns callback that is invoked on calling thread in order in which
+    // files were discovered.
+    using prepareCallbackPrototype =
+        std::function<callbackPrototype>(const std::string &path,
+                                         TimeReport &tr);
+
+    // File that is being processed concurrently.
+    struct Pending
+    {
+        std::string path;                         // Path to the file.
+        ThreadPool::Task task;                    // Preparation of the file.
+        std::shared_ptr<std::function<callbackPrototype>> finish; // Its result.
+        std::unique_ptr<TimeReport> tr;           // Time report of the file.
+    };
 
 public:
     // Records arguments for future use.
@@ -37,6 +57,17 @@ public:
               const std::string &language,
               const Config &config,
               std::function<callbackPrototype> callback);
+    // Records arguments for processing files on the specified number of
+    // threads.  Each file gets its own nested time report, which is passed to
+    // both callbacks.
+    Traverser(const std::vector<std::string> &paths,
+              const std::string &language,
+              const Config &config,
+              TimeReport &tr,
+              int jobs,
+              std::function<prepareCallbackPrototype> prepare);
+    // To destruct fields that refer to time reports with complete type.
+    ~Traverser();
 
 public:
     // Processes all specified paths.  Returns `true` if something was found.
@@ -46,12 +77,35 @@ private:
     // Processes either single file or recursively discovered files in a
     // directory.
     bool search(const boost::filesystem::path &path);
+    // Processes single file or queues it for processing.  Returns `true` if
+    // processing of some file was finished positively.
+    bool visit(const std::string &path);
+    // Schedules queued files after letting languages parse them in bulk.
+    // Returns `true` if processing of some file was finished positively.
+    bool flush();
+    // Processes single file or schedules it for processing after the
+    // prefetching task.  Returns `true` if processing of some file was
+    // finished positively.
+    bool schedule(const std::string &path,
+                  const ThreadPool::Task &prefetching);
+    // Determines language of the file to be passed to the `Language` class.
+    std::string getLanguage(const std::string &path) const;
+    // Finishes processing of the oldest scheduled file.
+    bool finishOne();
 
 private:
-    std::vector<std::string> paths;            // List of paths to process.
-    std::string language;                      // Language to accept.
-    const Config &config;                      // Configuration.
-    std::function<callbackPrototype> callback; // Invoked per file.
+    std::vector<std::string> paths;                   // Paths to process.
+    std::string language;                             // Language to accept.
+    const Config &config;                             // Configuration.
+    std::function<callbackPrototype> callback;        // Invoked per file.
+
+    TimeReport *tr = nullptr;                         // Parent time report.
+    int jobs = 1;                                     // Number of threads.
+    std::function<prepareCallbackPrototype> prepare;  // Invoked per file.
+    std::vector<std::string> queued;                  // Files to be scheduled.
+    std::deque<Pending> pending;                      // Files being processed.
+    std::vector<std::unique_ptr<TimeReport>> reports; // Reports of processed.
+    std::unique_ptr<ThreadPool> pool;                 // Threads for processing.
 };
 
 #endif // ZOGRASCOPE_TOOLING_TRAVERSER_HPP_
@@ -0,0 +1,119 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "TreeCache.hpp"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cctype>
+#include <cstdint>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <utility>
+
+#include "utils/optional.hpp"
+#include "Language.hpp"
+#include "tree.hpp"
+
+namespace fs = boost::filesystem;
+
+// Version of the cache layout.  Increment to invalidate all existing entries
+// on every change of format of serialized trees or of the way trees are built.
+constexpr int cacheVersion = 2;
+
+TreeCache::TreeCache(std::string dir) : dir(std::move(dir))
+{ }
+
+std::string
+TreeCache::makeKey(boost::string_ref contents, const Language &lang,
+                   int tabWidth, bool fine)
+{
+    // FNV-1a.
+    std::uint64_t hash = 14695981039346656037U;
+    for (unsigned char c : contents) {
+        hash ^= c;
+        hash *= 1099511628211U;
+    }
+
+    std::string langName = typeid(lang).name();
+    for (char &c : langName) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            c = '_';
+        }
+    }
+
+    std::ostringstream oss;
+    oss << 'v' << cacheVersion << '-' << langName << '-' << tabWidth
+        << (fine ? "-f-" : "-c-") << contents.size() << '-'
+        << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return oss.str();
+}
+
+optional_t<Tree>
+TreeCache::load(const std::string &key, std::unique_ptr<Language> &lang,
+                cpp17::pmr::memory_resource *mr) const
+{
+    const fs::path path = fs::path(dir) / key;
+
+    try {
+        boost::system::error_code ec;
+        if (!fs::is_regular_file(path, ec) || fs::file_size(path, ec) == 0U) {
+            return {};
+        }
+
+        boost::iostreams::mapped_file_source file(path.string());
+        boost::string_ref data(file.data(), file.size());
+        return optional_t<Tree>(Tree::deserialize(lang, data, mr));
+    } catch (const std::exception &) {
+        return {};
+    }
+}
+
+void
+TreeCache::store(const std::string &key, const Tree &tree) const
+{
+    try {
+        fs::create_directories(dir);
+
+        const fs::path path = fs::path(dir) / key;
+        const fs::path tmp = fs::path(dir)
+                           / fs::unique_path(key + ".%%%%-%%%%.tmp");
+
+        {
+            std::ofstream file(tmp.string(), std::ios::binary);
+            const std::string data = tree.serialize();
+            if (!file.write(data.data(), data.size()) || !file.flush()) {
+                file.close();
+                fs::remove(tmp);
+                return;
+            }
+        }
+
+        // Renaming makes concurrent readers see either old or new entry.
+        fs::rename(tmp, path);
+    } catch (const std::exception &) {
+        // Failing to store a tree only means that it will be parsed again.
+    }
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ZOGRASCOPE_TOOLING_TREECACHE_HPP_
+#define ZOGRASCOPE_TOOLING_TREECACHE_HPP_
+
+#include <boost/utility/string_ref.hpp>
+
+#include <memory>
+#include <string>
+
+#include "utils/optional.hpp"
+
+namespace cpp17 {
+    namespace pmr {
+        class memory_resource;
+    }
+}
+
+class Language;
+class Tree;
+
+// On-disk storage of parsed trees keyed by contents of files and parameters of
+// parsing.  Any failure to read or write an entry is treated as a cache miss.
+class TreeCache
+{
+public:
+    // Remembers path to the directory, which is created on first store.
+    explicit TreeCache(std::string dir);
+
+public:
+    // Computes key that identifies tree built from the contents.
+    static std::string makeKey(boost::string_ref contents,
+                               const Language &lang, int tabWidth, bool fine);
+
+    // Retrieves tree by its key.  Takes ownership of the language on success.
+    optional_t<Tree> load(const std::string &key,
+                          std::unique_ptr<Language> &lang,
+                          cpp17::pmr::memory_resource *mr) const;
+
+    // Saves tree under the key replacing any previous entry atomically.
+    void store(const std::string &key, const Tree &tree) const;
+
+private:
+    std::string dir; // Directory with cache entries.
+};
+
+#endif // ZOGRASCOPE_TOOLING_TREECACHE_HPP_
@@ -16,7 +16,9 @@
 
 #include "common.hpp"
 
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
@@ -31,6 +33,7 @@
 #include "utils/fs.hpp"
 #include "utils/optional.hpp"
 #include "utils/time.hpp"
+#include "tooling/TreeCache.hpp"
 #include "Language.hpp"
 #include "TreeBuilder.hpp"
 #include "STree.hpp"
@@ -45,7 +48,7 @@ static optional_t<Tree> buildTreeFromFile(const CommonArgs &args,
                                           TimeReport &tr,
                                           const Attrs &attrs,
                                           const std::string &path,
-                                          const std::string &contents,
+                                          boost::string_ref contents,
                                           cpp17::pmr::memory_resource *mr);
 
 Environment::Environment(const po::options_description &extraOpts)
@@ -63,8 +66,16 @@ Environment::setup(const std::vector<std::string> &argv)
     args.dryRun = varMap.count("dry-run");
     args.color = varMap.count("color");
     args.timeReport = varMap.count("time-report");
+    args.timeProfile = varMap.count("time-profile");
+    args.traceFile = varMap["trace-file"].as<std::string>();
     args.noPager = varMap.count("no-pager");
     args.lang = varMap["lang"].as<std::string>();
+    args.jobs = varMap["jobs"].as<int>();
+    args.cacheDir = varMap["cache-dir"].as<std::string>();
+    if (args.jobs < 1) {
+        throw std::invalid_argument("value of --jobs must be positive: " +
+                                    std::to_string(args.jobs));
+    }
 
     if (varMap.count("debug")) {
         auto debugList = varMap["debug"].as<std::string>();
@@ -94,6 +105,10 @@ Environment::setup(const std::vector<std::string> &argv)
         }
     }
 
+    if (args.timeProfile || !args.traceFile.empty()) {
+        tr.setTracer(&tracer);
+    }
+
     if (args.color) {
         decor::enableDecorations();
     }
@@ -130,7 +145,17 @@ parseOptions(const std::vector<std::string> &args,
                                                 ->implicit_value("t"),
                         "display internal representation")
         ("time-report", "report time spent on different activities")
+        ("time-profile", "report flat profile of activities")
+        ("trace-file",  po::value<std::string>()->value_name("path")
+                                                ->default_value({}),
+                        "write trace of activities in Chrome's format")
         ("no-pager",    "never spawn a pager for output")
+        ("jobs,j",      po::value<int>()->value_name("n")
+                                        ->default_value(1),
+                        "number of threads to use")
+        ("cache-dir",   po::value<std::string>()->value_name("dir")
+                                                ->default_value({}),
+                        "directory for caching parsed trees")
         ("color",       "force colorization of output")
         ("lang",        po::value<std::string>()->value_name("name")
                                                 ->default_value({}),
@@ -162,6 +187,16 @@ Environment::teardown(bool error)
         tr.stop();
         std::cout << tr;
     }
+    if (args.timeProfile) {
+        tracer.printProfile(std::cout);
+    }
+    if (!args.traceFile.empty()) {
+        std::ofstream file(args.traceFile);
+        tracer.writeChromeTrace(file);
+        if (!file) {
+            std::cerr << "Failed to write trace to: " << args.traceFile << '\n';
+        }
+    }
 }
 
 void
@@ -185,11 +220,12 @@ buildTreeFromFile(Environment &env,
                   const std::string &path,
                   cpp17::pmr::memory_resource *mr)
 {
+    FileContents contents(path);
     return buildTreeFromFile(env.getCommonArgs(),
                              tr,
                              attrs,
                              path,
-                             readFile(path),
+                             contents.str(),
                              mr);
 }
 
@@ -197,7 +233,7 @@ optional_t<Tree> buildTreeFromFile(Environment &env,
                                    TimeReport &tr,
                                    const Attrs &attrs,
                                    const std::string &path,
-                                   const std::string &contents,
+                                   boost::string_ref contents,
                                    cpp17::pmr::memory_resource *mr)
 {
     return buildTreeFromFile(env.getCommonArgs(),
@@ -208,10 +244,20 @@ optional_t<Tree> buildTreeFromFile(Environment &env,
                              mr);
 }
 
+void
+ParsedFile::parse(Environment &env, TimeReport &tr, const std::string &path)
+{
+    Attrs attrs = env.getConfig().lookupAttrs(path);
+    if (optional_t<Tree> &&t = buildTreeFromFile(env, tr, attrs, path,
+                                                 mr.get())) {
+        tree = *t;
+    }
+}
+
 optional_t<Tree>
 buildTreeFromFile(Environment &env,
                   const std::string &path,
-                  const std::string &contents,
+                  boost::string_ref contents,
                   cpp17::pmr::memory_resource *mr)
 {
     Attrs attrs = env.getConfig().lookupAttrs(path);
@@ -228,7 +274,7 @@ static optional_t<Tree> buildTreeFromFile(const CommonArgs &args,
                                           TimeReport &tr,
                                           const Attrs &attrs,
                                           const std::string &path,
-                                          const std::string &contents,
+                                          boost::string_ref contents,
                                           cpp17::pmr::memory_resource *mr)
 {
     auto timer = tr.measure("parsing: " + path);
@@ -240,7 +286,28 @@ static optional_t<Tree> buildTreeFromFile(const CommonArgs &args,
 
     std::unique_ptr<Language> lang = Language::create(path, langName);
 
-    cpp17::pmr::monolithic localMR;
+    // Debugging output is produced only by actual parsing.
+    const bool useCache = !args.cacheDir.empty() && !args.debug &&
+                          !args.sdebug && !args.dumpSTree;
+
+    TreeCache cache(args.cacheDir);
+    std::string cacheKey;
+    if (useCache) {
+        cacheKey = TreeCache::makeKey(contents, *lang, attrs.tabWidth,
+                                      args.fine);
+        optional_t<Tree> cached = cache.load(cacheKey, lang, mr);
+        if (cached) {
+            return cached;
+        }
+    }
+
+    // Memory for intermediate representations is reused by all files parsed
+    // by a thread, which is safe because they don't outlive this function.
+    static thread_local cpp17::pmr::monolithic localMR;
+    struct Rewind
+    {
+        ~Rewind() { localMR.reset(16U*1024U*1024U); }
+    } rewindGuard;
 
     TreeBuilder tb =
         lang->parse(contents, path, attrs.tabWidth, args.debug, localMR);
@@ -254,9 +321,12 @@ static optional_t<Tree> buildTreeFromFile(const CommonArgs &args,
         t = Tree(std::move(lang), attrs.tabWidth, contents, tb.getRoot(), mr);
     } else {
         STree stree(std::move(tb), contents, args.dumpSTree, args.sdebug,
-                    *lang, localMR);
-        t = Tree(std::move(lang), attrs.tabWidth, contents, stree.getRoot(),
-                 mr);
+                    *lang);
+        t = Tree(std::move(lang), attrs.tabWidth, contents, stree, mr);
+    }
+
+    if (useCache) {
+        cache.store(cacheKey, t);
     }
 
     return optional_t<Tree>(std::move(t));
@@ -291,3 +361,9 @@ dumpTrees(const CommonArgs &args, Tree &treeA, Tree &treeB)
         treeB.dump();
     }
 }
+
+int
+getParsingJobs(const CommonArgs &args)
+{
+    return (args.debug || args.sdebug || args.dumpSTree ? 1 : args.jobs);
+}
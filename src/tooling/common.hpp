@@ -22,13 +22,15 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/utility/string_ref.hpp>
 
+#include "utils/ArenaPool.hpp"
+#include "utils/Tracer.hpp"
 #include "utils/optional.hpp"
 #include "utils/time.hpp"
 #include "Config.hpp"
 #include "integration.hpp"
-
-class Tree;
+#include "tree.hpp"
 
 namespace cpp17 {
     namespace pmr {
@@ -51,7 +53,11 @@ struct CommonArgs
     // TODO: probably drop this one completely
     bool fine;                    // Whether to build only fine-grained tree.
     bool timeReport;              // Print time report.
+    bool timeProfile;             // Print flat profile of stages.
+    std::string traceFile;        // Where to write trace of stages.
     bool noPager;                 // Don't spawn a pager.
+    int jobs;                     // Number of threads to use.
+    std::string cacheDir;         // Where to cache parsed trees.
 };
 
 class Environment
@@ -87,6 +93,7 @@ private:
     CommonArgs args;
 
     RedirectToPager redirectToPager;
+    Tracer tracer;
     TimeReport tr;
     Config config;
 };
@@ -110,17 +117,36 @@ optional_t<Tree> buildTreeFromFile(Environment &env,
                                    TimeReport &tr,
                                    const Attrs &attrs,
                                    const std::string &path,
-                                   const std::string &contents,
+                                   boost::string_ref contents,
                                    cpp17::pmr::memory_resource *mr);
 
 // Parses a file to build its tree.
 optional_t<Tree> buildTreeFromFile(Environment &env,
                                    const std::string &path,
-                                   const std::string &contents,
+                                   boost::string_ref contents,
                                    cpp17::pmr::memory_resource *mr);
 
+// Tree of a file that's kept together with its allocator until it's
+// processed.  Tools can derive from it to keep results of processing as well.
+struct ParsedFile
+{
+    // Takes an arena from the pool.
+    explicit ParsedFile(ArenaPool &arenas) : mr(arenas.take())
+    { }
+
+    // Parses the file.  The tree is left empty on failure.
+    void parse(Environment &env, TimeReport &tr, const std::string &path);
+
+    ArenaPool::Arena mr; // Memory of the tree.
+    Tree tree { mr.get() };
+};
+
 void dumpTree(const CommonArgs &args, Tree &tree);
 
 void dumpTrees(const CommonArgs &args, Tree &treeA, Tree &treeB);
 
+// Retrieves number of threads to parse files on.  Parsing is done on a single
+// thread when it prints debugging output.
+int getParsingJobs(const CommonArgs &args);
+
 #endif // ZOGRASCOPE_TOOLING_COMMON_HPP_
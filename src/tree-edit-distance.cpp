@@ -16,27 +16,28 @@
 
 #include "tree-edit-distance.hpp"
 
-#define BOOST_DISABLE_ASSERTS
-#include <boost/multi_array.hpp>
+#include <cstddef>
+#include <cstdint>
 
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "tree.hpp"
 
-struct Change
-{
-    int cost;
-    int i, j;
-};
-
 enum { Wdel = 1, Wins = 1, Wren = 1, Wch = 3 };
 
+// Maximum number of pairs of nodes for which table of tree distances is built,
+// which is 128 MiB of narrow cells.
+constexpr std::size_t maxPairs = 64U*1024U*1024U;
+
 static void
 lmld(Node &node, std::vector<int> &l)
 {
@@ -69,6 +70,21 @@ lmld(Node &root)
     return l;
 }
 
+// Counts nodes that take part in computing the distance.
+static std::size_t
+countNodes(const Node &node)
+{
+    if (node.satellite) {
+        return 0U;
+    }
+
+    std::size_t n = 1U;
+    for (const Node *child : node.children) {
+        n += countNodes(*child);
+    }
+    return n;
+}
+
 static int
 countLeaves(Node &node)
 {
@@ -179,12 +195,91 @@ renameCost(const Node *n1, const Node *n2)
     // return (identicalRename ? 0 : Wren);
 }
 
+// Dense table of costs indexed by post-order IDs of nodes of two trees.  Row
+// and column with index -1 are present to represent empty forests.  Cells are
+// of the smallest type that can hold any cost for given pair of trees, which
+// matters as tables are quadratic in size.
+template <typename C>
+class CostTable
+{
+public:
+    CostTable(int rows, int cols)
+        : width(cols + 1), cells(static_cast<std::size_t>(rows + 1)*width)
+    { }
+
+public:
+    C * operator[](int row)
+    {
+        return &cells[static_cast<std::size_t>(row + 1)*width + 1];
+    }
+
+    const C * operator[](int row) const
+    {
+        return &cells[static_cast<std::size_t>(row + 1)*width + 1];
+    }
+
+private:
+    std::size_t width;
+    std::vector<C> cells;
+};
+
+// Table of forest distances for a single pair of keyroots.  Rows and columns
+// are indexed by post-order IDs of nodes of two subtrees starting with IDs
+// preceding their leftmost leaves, which represent empty forests.  Storage is
+// reused for all pairs, so only the largest pair determines memory footprint.
+template <typename C>
+class ForestTable
+{
+    template <typename T>
+    class Row
+    {
+    public:
+        Row(T *cells, int base) : cells(cells), base(base)
+        { }
+
+    public:
+        T & operator[](int col) const
+        {
+            return cells[col - base];
+        }
+
+    private:
+        T *cells;
+        int base;
+    };
+
+public:
+    // Prepares table for rows in [rowFrom, rowTo] and columns in
+    // [colFrom, colTo].
+    void reset(int rowFrom, int rowTo, int colFrom, int colTo)
+    {
+        rowBase = rowFrom;
+        colBase = colFrom;
+        width = colTo - colFrom + 1;
+        cells.resize(static_cast<std::size_t>(rowTo - rowFrom + 1)*width);
+    }
+
+    Row<C> operator[](int row)
+    {
+        return Row<C>(&cells[static_cast<std::size_t>(row - rowBase)*width],
+                      colBase);
+    }
+
+private:
+    int rowBase = 0;
+    int colBase = 0;
+    std::size_t width = 0U;
+    std::vector<C> cells;
+};
+
+template <typename C>
 static void
 forestDist(int i, int j, const std::vector<int> &l1, const std::vector<int> &l2,
-           boost::multi_array<Change, 2> &td,
-           boost::multi_array<int, 2> &fd,
+           CostTable<C> &td, ForestTable<C> &fd,
            const std::vector<Node *> &po1, const std::vector<Node *> &po2)
 {
+    fd.reset(l1[i] - 1, i, l2[j] - 1, j);
+
     fd[l1[i] - 1][l2[j] - 1] = 0;
     for (int di = l1[i]; di <= i; ++di) {
         fd[di][l2[j] - 1] = fd[di - 1][l2[j] - 1] + Wdel;
@@ -194,47 +289,36 @@ forestDist(int i, int j, const std::vector<int> &l1, const std::vector<int> &l2,
     }
     for (int di = l1[i]; di <= i; ++di) {
         const int ldi = l1[di];
-        for (int dj = l2[j]; dj <= j; ++dj) {
-            const int ldj = l2[dj];
-            if (ldi == l1[i] && ldj == l2[j]) {
-                fd[di][dj] = std::min({
-                    fd[di - 1][dj] + Wdel,
-                    fd[di][dj - 1] + Wins,
-                    fd[di - 1][dj - 1] + renameCost(po1[di], po2[dj])
-                });
-                td[di][dj] = Change { fd[di][dj], i, j };
-            } else {
-                fd[di][dj] =
-                    std::min({ fd[di - 1][dj] + Wdel,
-                               fd[di][dj - 1] + Wins,
-                               fd[ldi - 1][ldj - 1] + td[di][dj].cost });
+        auto row = fd[di];
+        auto prevRow = fd[di - 1];
+        if (ldi == l1[i]) {
+            C *tdRow = td[di];
+            for (int dj = l2[j]; dj <= j; ++dj) {
+                const int ldj = l2[dj];
+                if (ldj == l2[j]) {
+                    row[dj] = std::min({
+                        prevRow[dj] + Wdel,
+                        row[dj - 1] + Wins,
+                        prevRow[dj - 1] + renameCost(po1[di], po2[dj])
+                    });
+                    tdRow[dj] = row[dj];
+                } else {
+                    row[dj] = std::min({ prevRow[dj] + Wdel,
+                                         row[dj - 1] + Wins,
+                                         fd[ldi - 1][ldj - 1] + tdRow[dj] });
+                }
+            }
+        } else {
+            const C *tdRow = td[di];
+            auto forestRow = fd[ldi - 1];
+            for (int dj = l2[j]; dj <= j; ++dj) {
+                const int ldj = l2[dj];
+                row[dj] = std::min({ prevRow[dj] + Wdel,
+                                     row[dj - 1] + Wins,
+                                     forestRow[ldj - 1] + tdRow[dj] });
             }
         }
     }
-
-    // for (int di = l1[i] - 1; di <= i; ++di) {
-    //     for (int dj = l2[j] - 1; dj <= j; ++dj) {
-    //         std::cout << std::setw(2) << fd[di][dj] << ' ';
-    //     }
-    //     std::cout << '\n';
-    // }
-
-    // std::cout << "--------\n";
-
-    // for (unsigned int i = 0; i < l1.size(); ++i) {
-    //     for (unsigned int j = 0; j < l2.size(); ++j) {
-    //         std::string mark;
-    //         // switch (td[i][j].state) {
-    //         //     case State::Unchanged: mark = "(U)"; break;
-    //         //     case State::Deleted:   mark = "(D)";  break;
-    //         //     case State::Inserted:  mark = "(I)"; break;
-    //         //     case State::Updated:   mark = "(R)";  break;
-    //         // }
-
-    //         std::cout << std::setw(2) << td[i][j].cost << mark << ' ';
-    //     }
-    //     std::cout << '\n';
-    // }
 }
 
 class BacktrackingQueue
@@ -269,10 +353,11 @@ private:
     std::map<pair, std::vector<pair>> queue;
 };
 
+template <typename C>
 static void
 backtrackForests(const std::vector<int> &l1, const std::vector<int> &l2,
-                 const boost::multi_array<Change, 2> &td,
-                 boost::multi_array<int, 2> &fd,
+                 const std::vector<int> &kr1, const std::vector<int> &kr2,
+                 const CostTable<C> &td, ForestTable<C> &fd,
                  const std::vector<Node *> &po1, const std::vector<Node *> &po2,
                  BacktrackingQueue &bq)
 {
@@ -282,6 +367,8 @@ backtrackForests(const std::vector<int> &l1, const std::vector<int> &l2,
     // This creates forest table identical to the one created on forward pass,
     // but it doesn't update tree table.  Tree table is fully calculated by now,
     // so we can just use its values.
+    fd.reset(l1[i] - 1, i, l2[j] - 1, j);
+
     fd[l1[i] - 1][l2[j] - 1] = 0;
     for (int di = l1[i]; di <= i; ++di) {
         fd[di][l2[j] - 1] = fd[di - 1][l2[j] - 1] + Wdel;
@@ -301,7 +388,7 @@ backtrackForests(const std::vector<int> &l1, const std::vector<int> &l2,
                 fd[di][dj] =
                     std::min({ fd[di - 1][dj] + Wdel,
                                fd[di][dj - 1] + Wins,
-                               fd[l1[di] - 1][l2[dj] - 1] + td[di][dj].cost });
+                               fd[l1[di] - 1][l2[dj] - 1] + td[di][dj] });
             }
         }
     }
@@ -334,7 +421,9 @@ backtrackForests(const std::vector<int> &l1, const std::vector<int> &l2,
                 } else if (fd[di][dj] == fd[di][dj - 1] + Wins) {
                     po2[dj--]->state = State::Inserted;
                 } else {
-                    bq.enqueue(td[di][dj].i, td[di][dj].j, di, dj);
+                    // Tree distance of this pair was computed for keyroots
+                    // that share leftmost leaves with the nodes.
+                    bq.enqueue(kr1[l1[di]], kr2[l2[dj]], di, dj);
                     di = l1[di] - 1;
                     dj = l2[dj] - 1;
                 }
@@ -343,36 +432,40 @@ backtrackForests(const std::vector<int> &l1, const std::vector<int> &l2,
     }
 }
 
-int
-ted(Node &T1, Node &T2)
+// Maps leftmost leaf descendants to keyroots they belong to.
+static std::vector<int>
+mapLeavesToKeyroots(const std::vector<int> &kr, const std::vector<int> &l)
 {
-    std::vector<Node *> po1 = postOrder(T1);
-    std::vector<Node *> po2 = postOrder(T2);
-
-    std::vector<int> l1 = lmld(T1);
-    std::vector<int> l2 = lmld(T2);
-
-    boost::multi_array<Change, 2> td(boost::extents[l1.size()][l2.size()]);
-    for (unsigned int i = 0; i < l1.size(); ++i) {
-        for (unsigned int j = 0; j < l2.size(); ++j) {
-            td[i][j].cost = -1;
-        }
+    std::vector<int> map(l.size(), -1);
+    for (int x : kr) {
+        map[l[x]] = x;
     }
+    return map;
+}
 
-    std::vector<int> k1 = makeKr(T1, l1);
-    std::vector<int> k2 = makeKr(T2, l2);
+template <typename C>
+static int
+ted(const std::vector<Node *> &po1, const std::vector<Node *> &po2,
+    const std::vector<int> &l1, const std::vector<int> &l2,
+    const std::vector<int> &k1, const std::vector<int> &k2)
+{
+    const int n1 = po1.size();
+    const int n2 = po2.size();
+
+    // Tree table doesn't store pairs of keyroots along with costs, because
+    // keyroot pair for any cell is determined by leftmost leaves of nodes.
+    CostTable<C> td(n1, n2);
+    ForestTable<C> fd;
 
-    using range = boost::multi_array_types::extent_range;
-    boost::multi_array<int, 2> fd(boost::extents[range(-1, po1.size())]
-                                                [range(-1, po2.size())]);
-    // int step = 0;
     for (int x : k1) {
         for (int y : k2) {
-            // std::cout << "step #" << ++step << '\n';
             forestDist(x, y, l1, l2, td, fd, po1, po2);
         }
     }
 
+    const std::vector<int> kr1 = mapLeavesToKeyroots(k1, l1);
+    const std::vector<int> kr2 = mapLeavesToKeyroots(k2, l2);
+
     // Mark nodes with states by backtracking through forest arrays.  We do this
     // in reversed order by regenerating only arrays that are actually needed to
     // recover solution.  Starting with cell containing the answer and figuring
@@ -380,10 +473,42 @@ ted(Node &T1, Node &T2)
     // is that we need to process multiple arrays.  The tracing splits on steps
     // where forests are processed based on information from tree array.
     BacktrackingQueue bq;
-    bq.enqueue(k1.back(), k2.back(), l1.size() - 1, l2.size() - 1);
+    bq.enqueue(k1.back(), k2.back(), n1 - 1, n2 - 1);
     while (bq.hasMore()) {
-        backtrackForests(l1, l2, td, fd, po1, po2, bq);
+        backtrackForests(l1, l2, kr1, kr2, td, fd, po1, po2, bq);
+    }
+
+    return td[n1 - 1][n2 - 1];
+}
+
+bool
+canTed(const Node &T1, const Node &T2)
+{
+    const std::size_t n1 = countNodes(T1);
+    return (n1 == 0U || countNodes(T2) <= maxPairs/n1);
+}
+
+int
+ted(Node &T1, Node &T2, bool wideCells)
+{
+    if (!canTed(T1, T2)) {
+        return -1;
     }
 
-    return td[l1.size() - 1][l2.size() - 1].cost;
+    std::vector<Node *> po1 = postOrder(T1);
+    std::vector<Node *> po2 = postOrder(T2);
+
+    std::vector<int> l1 = lmld(T1);
+    std::vector<int> l2 = lmld(T2);
+
+    std::vector<int> k1 = makeKr(T1, l1);
+    std::vector<int> k2 = makeKr(T2, l2);
+
+    // Any distance is bounded by the cost of deleting first tree and inserting
+    // second one, use it to pick narrower cells when possible.
+    const std::size_t maxCost = po1.size()*Wdel + po2.size()*Wins;
+    if (!wideCells && maxCost < std::numeric_limits<std::uint16_t>::max()) {
+        return ted<std::uint16_t>(po1, po2, l1, l2, k1, k2);
+    }
+    return ted<int>(po1, po2, l1, l2, k1, k2);
 }
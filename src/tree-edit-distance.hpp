@@ -24,6 +24,14 @@ class Tree;
 
 void printTree(const std::string &name, Tree &tree);
 
-int ted(Node &T1, Node &T2);
+// Checks whether ted() accepts the trees.  Its memory grows with product of
+// their sizes, so too large trees are refused.
+bool canTed(const Node &T1, const Node &T2);
+
+// Computes tree edit distance between two trees and marks their nodes with
+// results.  Costs are kept in the narrowest cells that can hold them unless
+// `wideCells` is set.  Returns -1 without marking anything if trees are too
+// large (see canTed()).
+int ted(Node &T1, Node &T2, bool wideCells = false);
 
 #endif // ZOGRASCOPE_TREE_EDIT_DISTANCE_HPP_
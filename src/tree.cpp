@@ -21,12 +21,17 @@
 #include <boost/utility/string_ref.hpp>
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 
 #include <algorithm>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -42,33 +47,40 @@
 
 // How many neighbours to consider on each side when computing overlap.
 constexpr int subtreeOverlapSize = 3;
-
-static void putNodeChild(Node &parent, Node *child, const Language *lang);
-static void preStringifyPTree(const std::string &contents,
+// Base of polynomial hash of text of subtrees.
+constexpr std::uint64_t textHashBase = 1099511628211U;
+
+static std::size_t countSNodes(const PNode *node);
+static std::size_t countPNodes(const PNode *node);
+static void putNodeChild(std::vector<Node *> &children, SType parent,
+                         Node *child, const Language *lang);
+static void preStringifyPTree(boost::string_ref contents,
                               PNode *node, const Language *lang, int tabWidth,
                               cpp17::pmr::vector<char> &stringified);
 static boost::string_ref
 stringifyPNode(const cpp17::pmr::vector<char> &stringified, const PNode *node);
-static void preStringifyPNode(const std::string &contents, PNode *node,
+static void preStringifyPNode(boost::string_ref contents, PNode *node,
                               const Language *lang, int tabWidth,
                               cpp17::pmr::vector<char> &stringified);
-static std::string stringifyPNodeSpelling(const std::string &contents,
+static std::string stringifyPNodeSpelling(boost::string_ref contents,
                                           const PNode *node, int tabWidth);
 static int maxStringifiedSize(boost::string_ref contents, int tabWidth);
 static void postOrder(Node &node, std::vector<Node *> &v);
+static std::uint64_t hashText(boost::string_ref text);
+static std::uint64_t appendTextHash(std::uint64_t hash, std::uint64_t tailHash,
+                                    int tailLength);
 static std::unordered_map<std::size_t, std::vector<int>>
 hashChildren(Node &node);
-static std::size_t hashNode(const Node *node);
 static void matchTrees(Node *x, Node *y);
-static int rateChildOverlap(int xi, const cpp17::pmr::vector<Node *> &c1,
-                            int yi, const cpp17::pmr::vector<Node *> &c2);
+static int rateChildOverlap(int xi, const NodeChildren &c1,
+                            int yi, const NodeChildren &c2);
 static void markAsMoved(Node *node, Language &lang);
 static void dumpTree(std::ostream &os, const Node *node, const Language *lang,
                      std::vector<bool> &trace, int depth);
 static void dumpNode(std::ostream &os, const Node *node, const Language *lang);
 
 Tree::Tree(std::unique_ptr<Language> lang, int tabWidth,
-           const std::string &contents, const PNode *node, allocator_type al)
+           boost::string_ref contents, const PNode *node, allocator_type al)
     : lang(std::move(lang)), nodes(al), stringified(al), internPool(al),
       tabWidth(tabWidth)
 {
@@ -77,54 +89,73 @@ Tree::Tree(std::unique_ptr<Language> lang, int tabWidth,
 
     preStringifyPTree(contents, const_cast<PNode *>(node), this->lang.get(),
                       tabWidth, stringified);
-    root = materializePNode(contents, node);
+    makeTable(countPNodes(node));
+    std::vector<Node *> stack;
+    root = materializePNode(contents, node, stack);
+    finishTable();
+    fingerprint(*root);
 
     assert(stringified.data() == buf && "Stringified buffer got relocated!");
     (void)buf;
 }
 
 Tree::Tree(std::unique_ptr<Language> lang, int tabWidth,
-           const std::string &contents, const SNode *node, allocator_type al)
+           boost::string_ref contents, const STree &stree, allocator_type al)
     : lang(std::move(lang)), nodes(al), stringified(al), internPool(al),
       tabWidth(tabWidth)
 {
     stringified.reserve(maxStringifiedSize(contents, tabWidth));
     const char *buf = stringified.data();
 
-    preStringifyPTree(contents, node->value, this->lang.get(), tabWidth,
-                      stringified);
-    root = materializeSNode(contents, node, nullptr);
+    const PNode *node = stree.getRoot();
+    preStringifyPTree(contents, const_cast<PNode *>(node), this->lang.get(),
+                      tabWidth, stringified);
+    makeTable(countSNodes(node));
+    std::vector<Node *> stack;
+    root = materializeSNode(contents, node, nullptr, stack);
+    finishTable();
+    fingerprint(*root);
 
     assert(stringified.data() == buf && "Stringified buffer got relocated!");
     (void)buf;
 }
 
 Node *
-Tree::materializeSNode(const std::string &contents, const SNode *node,
-                       const SNode *parent)
+Tree::materializeSNode(boost::string_ref contents, const PNode *node,
+                       const PNode *parent, std::vector<Node *> &stack)
 {
-    Node &n = *nodes.make();
-    n.stype = node->value->stype;
+    Node &n = makeNode();
+    n.stype = node->stype;
     n.satellite = lang->isSatellite(n.stype);
 
-    if (node->children.empty()) {
-        const PNode *leftmostLeaf = node->value->leftmostChild();
+    if (STree::isLeaf(node)) {
+        const PNode *leftmostLeaf = node->leftmostChild();
 
-        n.label = stringifyPNode(stringified, node->value);
+        n.label = stringifyPNode(stringified, node);
         n.line = leftmostLeaf->line;
         n.col = leftmostLeaf->col;
-        n.next = materializePNode(contents, node->value);
+        n.next = materializePNode(contents, node, stack);
         n.next->last = true;
         n.type = n.next->type;
         n.leaf = (n.line != 0 && n.col != 0);
         return &n;
     }
 
-    n.children.reserve(node->children.size());
-    for (SNode *child : node->children) {
-        Node *newChild = materializeSNode(contents, child, node);
-        putNodeChild(n, newChild, lang.get());
+    // Children of this node are collected at the top of the stack.
+    const PNode *valueChild = nullptr;
+    const std::size_t stackBase = stack.size();
+    for (std::size_t i = 0U; i < node->children.size(); ++i) {
+        const PNode *child = STree::getChild(node->children[i]);
+        if (valueChild == nullptr && lang->isValueNode(child->stype)) {
+            valueChild = child;
+            n.valueChild = i;
+        }
+
+        Node *newChild = materializeSNode(contents, child, node, stack);
+        putNodeChild(stack, n.stype, newChild, lang.get());
     }
+    makeChildren(n, stack.data() + stackBase, stack.size() - stackBase);
+    stack.resize(stackBase);
 
     // The check below can be true if putNodeChild() decided to not add any
     // children.
@@ -133,28 +164,20 @@ Tree::materializeSNode(const std::string &contents, const SNode *node,
         n.col = n.children.front()->col;
     }
 
-    auto valueChild = std::find_if(node->children.begin(), node->children.end(),
-                                   [this](const SNode *node) {
-                                       const SType stype = node->value->stype;
-                                       return lang->isValueNode(stype);
-                                   });
-    if (valueChild != node->children.end()) {
-        n.label = stringifyPNode(stringified, (*valueChild)->value);
-        n.valueChild = valueChild - node->children.begin();
-    } else {
-        n.valueChild = -1;
+    if (valueChild != nullptr) {
+        n.label = stringifyPNode(stringified, valueChild);
     }
 
     // Move certain nodes onto the next layer.
-    SType parentSType = (parent == nullptr ? SType{} : parent->value->stype);
+    SType parentSType = (parent == nullptr ? SType{} : parent->stype);
     if (lang->isLayerBreak(parentSType, n.stype)) {
-        Node &nextLevel = *nodes.make();
+        Node &nextLevel = makeNode();
         nextLevel.next = &n;
         nextLevel.stype = n.stype;
         nextLevel.line = n.line;
         nextLevel.col = n.col;
 
-        int len = node->value->value.postponedTo;
+        int len = node->value.postponedTo;
         nextLevel.label = n.label.empty() ? intern(printSubTree(n, false, len))
                                           : n.label;
         return &nextLevel;
@@ -163,12 +186,40 @@ Tree::materializeSNode(const std::string &contents, const SNode *node,
     return &n;
 }
 
+// Computes upper bound on number of nodes produced by materializing SNode-tree.
+static std::size_t
+countSNodes(const PNode *node)
+{
+    if (STree::isLeaf(node)) {
+        return 1U + countPNodes(node);
+    }
+
+    // Node and, possibly, its copy on the next layer.
+    std::size_t count = 2U;
+    for (const PNode *child : node->children) {
+        count += countSNodes(STree::getChild(child));
+    }
+    return count;
+}
+
+// Computes upper bound on number of nodes produced by materializing PNode-tree.
+static std::size_t
+countPNodes(const PNode *node)
+{
+    std::size_t count = 1U;
+    for (const PNode *child : node->children) {
+        count += countPNodes(child);
+    }
+    return count;
+}
+
 // Adds child or its children (when child is spliced) to the parent node.
 static void
-putNodeChild(Node &parent, Node *child, const Language *lang)
+putNodeChild(std::vector<Node *> &children, SType parent, Node *child,
+             const Language *lang)
 {
-    if (!lang->shouldSplice(parent.stype, child)) {
-        parent.children.emplace_back(child);
+    if (!lang->shouldSplice(parent, child)) {
+        children.emplace_back(child);
         return;
     }
 
@@ -178,7 +229,7 @@ putNodeChild(Node &parent, Node *child, const Language *lang)
             // Unless it's empty (has neither children nor value).
             if (!child->next->children.empty() ||
                 !child->next->label.empty()) {
-                parent.children.emplace_back(child);
+                children.emplace_back(child);
             }
             return;
         }
@@ -187,19 +238,19 @@ putNodeChild(Node &parent, Node *child, const Language *lang)
     }
 
     for (auto x : child->children) {
-        putNodeChild(parent, x, lang);
+        putNodeChild(children, parent, x, lang);
     }
 }
 
 // Turns tree into a string.  Stores boundaries of nodes label in
 // value.postponedFrom (start index) and value.postponedTo (length).
 static void
-preStringifyPTree(const std::string &contents, PNode *node,
+preStringifyPTree(boost::string_ref contents, PNode *node,
                   const Language *lang, int tabWidth,
                   cpp17::pmr::vector<char> &stringified)
 {
     struct {
-        const std::string &contents;
+        boost::string_ref contents;
         const Language *lang;
         int tabWidth;
         cpp17::pmr::vector<char> &out;
@@ -226,17 +277,20 @@ preStringifyPTree(const std::string &contents, PNode *node,
 }
 
 Node *
-Tree::materializePNode(const std::string &contents, const PNode *node)
+Tree::materializePNode(boost::string_ref contents, const PNode *node,
+                       std::vector<Node *> &stack)
 {
     const Type type = lang->mapToken(node->value.token);
 
     if (type == Type::Virtual && node->children.size() == 1U) {
-        return materializePNode(contents, node->children[0]);
+        return materializePNode(contents, node->children[0], stack);
     }
 
-    Node &n = *nodes.make();
+    Node &n = makeNode();
     n.label = stringifyPNode(stringified, node);
-    if (lang->shouldDropLeadingWS(node->stype)) {
+    // Leading whitespace can be dropped only after a new line.
+    if (lang->shouldDropLeadingWS(node->stype) &&
+        n.label.find('\n') != boost::string_ref::npos) {
         n.spelling = intern(stringifyPNodeSpelling(contents, node, tabWidth));
     } else {
         n.spelling = n.label;
@@ -247,14 +301,94 @@ Tree::materializePNode(const std::string &contents, const PNode *node)
     n.stype = node->stype;
     n.leaf = (n.line != 0 && n.col != 0);
 
-    n.children.reserve(node->children.size());
+    // Indices of children must be contiguous, so children are built first.
+    const std::size_t stackBase = stack.size();
     for (const PNode *child : node->children) {
-        n.children.push_back(materializePNode(contents, child));
+        Node *newChild = materializePNode(contents, child, stack);
+        stack.push_back(newChild);
     }
+    makeChildren(n, stack.data() + stackBase, stack.size() - stackBase);
+    stack.resize(stackBase);
 
     return &n;
 }
 
+void
+Tree::fingerprint(Node &node)
+{
+    Fingerprint &fp = node.fingerprint;
+
+    // Text and structure of a node with next layer are defined by that layer.
+    if (node.next != nullptr) {
+        fingerprint(*node.next);
+
+        const Fingerprint &nextFp = node.next->fingerprint;
+        fp.structure = nextFp.structure;
+        fp.text = nextFp.text;
+        fp.code = nextFp.code;
+        fp.textLength = nextFp.textLength;
+        fp.codeLength = nextFp.codeLength;
+    } else {
+        fp.structure = boost::hash_range(node.label.begin(), node.label.end());
+        if (node.leaf) {
+            fp.text = hashText(node.label);
+            fp.textLength = node.label.size();
+            if (node.type != Type::Comments) {
+                fp.code = fp.text;
+                fp.codeLength = fp.textLength;
+            }
+        }
+    }
+
+    const bool langSatellite = lang->isSatellite(node.stype);
+
+    fp.size = 1;
+    fp.leafCount = (node.children.empty() && !langSatellite);
+    for (Node *child : node.children) {
+        fingerprint(*child);
+
+        const Fingerprint &childFp = child->fingerprint;
+        if (node.next == nullptr) {
+            boost::hash_combine(fp.structure, childFp.structure);
+            fp.text = appendTextHash(fp.text, childFp.text, childFp.textLength);
+            fp.code = appendTextHash(fp.code, childFp.code, childFp.codeLength);
+            fp.textLength += childFp.textLength;
+            fp.codeLength += childFp.codeLength;
+        }
+        fp.size += childFp.size;
+        if (!langSatellite) {
+            fp.leafCount += childFp.leafCount;
+        }
+    }
+}
+
+// Computes polynomial hash of a string.  Unlike most hashes, hash of
+// concatenation of strings can be derived from hashes of its parts.
+static std::uint64_t
+hashText(boost::string_ref text)
+{
+    std::uint64_t hash = 0U;
+    for (char c : text) {
+        hash = hash*textHashBase + static_cast<unsigned char>(c);
+    }
+    return hash;
+}
+
+// Computes hash of concatenation of two strings given their hashes and length
+// of the second string.
+static std::uint64_t
+appendTextHash(std::uint64_t hash, std::uint64_t tailHash, int tailLength)
+{
+    std::uint64_t factor = 1U;
+    for (std::uint64_t power = textHashBase; tailLength != 0; power *= power) {
+        if (tailLength & 1) {
+            factor *= power;
+        }
+        tailLength >>= 1;
+    }
+    return hash*factor + tailHash;
+}
+
 // Turns PNode into a string.
 static boost::string_ref
 stringifyPNode(const cpp17::pmr::vector<char> &stringified, const PNode *node)
@@ -266,7 +400,7 @@ stringifyPNode(const cpp17::pmr::vector<char> &stringified, const PNode *node)
 // Turns node into a string.  Stores boundaries of this node's label in
 // value.postponedFrom (start index) and value.postponedTo (length).
 static void
-preStringifyPNode(const std::string &contents, PNode *node,
+preStringifyPNode(boost::string_ref contents, PNode *node,
                   const Language *lang, int tabWidth,
                   cpp17::pmr::vector<char> &stringified)
 {
@@ -311,10 +445,10 @@ preStringifyPNode(const std::string &contents, PNode *node,
 
 // Computes node label only expanding tabs in it.
 static std::string
-stringifyPNodeSpelling(const std::string &contents, const PNode *node,
+stringifyPNodeSpelling(boost::string_ref contents, const PNode *node,
                        int tabWidth)
 {
-    boost::string_ref sr(contents.c_str() + node->value.from, node->value.len);
+    boost::string_ref sr(contents.data() + node->value.from, node->value.len);
 
     std::string str;
     str.reserve(maxStringifiedSize(sr, tabWidth));
@@ -355,6 +489,7 @@ std::vector<Node *>
 postOrder(Node &root)
 {
     std::vector<Node *> v;
+    v.reserve(root.fingerprint.size);
     root.parent = &root;
     postOrder(root, v);
     return v;
@@ -420,8 +555,8 @@ reduceTreesCoarse(Node *T1, Node *T2)
             std::swap(pair.from, pair.to);
             std::swap(n, m);
         }
-        const cpp17::pmr::vector<Node *> &ci = (swap ? T2 : T1)->children;
-        const cpp17::pmr::vector<Node *> &cj = (swap ? T1 : T2)->children;
+        const NodeChildren &ci = (swap ? T2 : T1)->children;
+        const NodeChildren &cj = (swap ? T1 : T2)->children;
 
         // Match here is obvious, skip computing the overlap.
         if (n == 1 && m == 1) {
@@ -468,28 +603,12 @@ hashChildren(Node &node)
     for (int i = 0, n = node.children.size(); i < n; ++i) {
         Node *child = node.children[i];
         if (!child->satellite) {
-            hashes[hashNode(child)].push_back(i);
+            hashes[child->fingerprint.structure].push_back(i);
         }
     }
     return hashes;
 }
 
-// Hashes all descendants of the node together.
-static std::size_t
-hashNode(const Node *node)
-{
-    if (node->next != nullptr) {
-        return hashNode(node->next);
-    }
-
-    std::size_t hash = boost::hash_range(node->label.begin(),
-                                         node->label.end());
-    for (const Node *child : node->children) {
-        boost::hash_combine(hash, hashNode(child));
-    }
-    return hash;
-}
-
 // Matches corresponding nodes of two trees.  Assumption is that matched nodes
 // have exactly the same structure.
 static void
@@ -517,8 +636,8 @@ matchTrees(Node *x, Node *y)
 // resolves ties quite well.  Holes at the ends (too far left or right) of both
 // arguments are considered a match to match border nodes to border nodes.
 static int
-rateChildOverlap(int xi, const cpp17::pmr::vector<Node *> &c1,
-                 int yi, const cpp17::pmr::vector<Node *> &c2)
+rateChildOverlap(int xi, const NodeChildren &c1,
+                 int yi, const NodeChildren &c2)
 {
     // TODO: maybe try matching true satellitels (separators) with each other by
     //       value
@@ -578,9 +697,11 @@ printSubTree(const Node &root, bool withComments, int size_hint)
         }
     } visitor { withComments, {} };
 
-    if (size_hint > 0) {
-        visitor.out.reserve(size_hint);
+    if (size_hint <= 0) {
+        size_hint = withComments ? root.fingerprint.textLength
+                                 : root.fingerprint.codeLength;
     }
+    visitor.out.reserve(size_hint);
     visitor.run(root);
 
     return visitor.out;
@@ -626,6 +747,13 @@ Tree::markInPreOrder()
     }
 }
 
+void
+Tree::link(Tree &other)
+{
+    table->link(*other.table);
+    other.table->link(*table);
+}
+
 void
 Tree::markTreeAsMoved(Node *node)
 {
@@ -793,3 +921,350 @@ Tree::intern(std::string &&str)
     internPool.push_back(std::move(str));
     return internPool.back();
 }
+
+void
+Tree::makeTable(std::size_t capacity)
+{
+    // Storage is allocated as an array of nodes for proper alignment with the
+    // header occupying end of the leading part of it.
+    const std::size_t headerSlots = (sizeof(NodeTable) + sizeof(Node) - 1U)
+                                  / sizeof(Node);
+    Node *storage = nodes.allocate<Node>(headerSlots + capacity);
+    char *header = reinterpret_cast<char *>(storage + headerSlots)
+                 - sizeof(NodeTable);
+    table = new(header) NodeTable();
+    this->capacity = capacity;
+}
+
+Node &
+Tree::makeNode()
+{
+    assert(table->size < capacity && "Node table is full!");
+    Node *node = new(table->at(table->size)) Node();
+    node->id = table->size++;
+    return *node;
+}
+
+void
+Tree::makeChildren(Node &node, Node *const *children, std::size_t count)
+{
+    node.children.first = childIds.size();
+    node.children.count = count;
+    for (std::size_t i = 0U; i < count; ++i) {
+        childIds.push_back(children[i]->id);
+    }
+    // Children are inspected while the rest of the tree is being built.
+    table->childIds = childIds.data();
+}
+
+void
+Tree::finishTable()
+{
+    std::uint32_t *ids = nodes.allocate<std::uint32_t>(childIds.size());
+    std::copy(childIds.cbegin(), childIds.cend(), ids);
+    table->childIds = ids;
+    childIds = std::vector<std::uint32_t>();
+    capacity = table->size;
+}
+
+namespace {
+
+// Magic number that starts serialized trees.
+constexpr std::uint32_t serializationMagic = 0x7473737AU; // "zsst"
+
+// Kind of storage of a string.
+enum class StrRef : std::uint8_t
+{
+    Stringified, // Offset and length within stringified buffer.
+    Interned,    // Index, offset and length within interned string.
+    Inline       // Length and contents follow.
+};
+
+// Appends values of trivial types to a string.
+class Writer
+{
+public:
+    explicit Writer(std::string &out) : out(out)
+    { }
+
+public:
+    template <typename T>
+    void write(T value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void writeString(boost::string_ref str)
+    {
+        write<std::uint32_t>(str.size());
+        out.append(str.data(), str.size());
+    }
+
+private:
+    std::string &out; // Output buffer.
+};
+
+// Reads what was written by the Writer and checks bounds along the way.
+class Reader
+{
+public:
+    explicit Reader(boost::string_ref data) : data(data)
+    { }
+
+public:
+    template <typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    boost::string_ref readString()
+    {
+        const std::uint32_t size = read<std::uint32_t>();
+        return boost::string_ref(take(size), size);
+    }
+
+    // Checks whether all data was consumed.
+    bool atEnd() const
+    {
+        return data.empty();
+    }
+
+private:
+    // Consumes specified number of bytes.
+    const char * take(std::size_t size)
+    {
+        if (size > data.size()) {
+            throw std::runtime_error("Serialized tree is truncated");
+        }
+        const char *ptr = data.data();
+        data.remove_prefix(size);
+        return ptr;
+    }
+
+private:
+    boost::string_ref data; // Unprocessed data.
+};
+
+}
+
+std::string
+Tree::serialize() const
+{
+    std::string out;
+    Writer w(out);
+
+    w.write(serializationMagic);
+    w.write<std::int32_t>(tabWidth);
+
+    w.writeString(boost::string_ref(stringified.data(), stringified.size()));
+
+    // Interned strings are looked up by address of their last character.
+    std::map<const char *, std::uint32_t> interned;
+    w.write<std::uint32_t>(internPool.size());
+    for (std::uint32_t i = 0U; i < internPool.size(); ++i) {
+        const std::string &str = internPool[i];
+        if (!str.empty()) {
+            interned.emplace(&str.back(), i);
+        }
+        w.writeString(str);
+    }
+
+    // Nodes go into a separate buffer, because their number isn't known in
+    // advance.
+    std::string nodesOut;
+    Writer nw(nodesOut);
+
+    auto writeRef = [&](boost::string_ref str) {
+        const char *const begin = stringified.data();
+        const char *const end = begin + stringified.size();
+        if (!str.empty() && str.data() >= begin && str.end() <= end) {
+            nw.write(StrRef::Stringified);
+            nw.write<std::uint32_t>(str.data() - begin);
+            nw.write<std::uint32_t>(str.size());
+            return;
+        }
+
+        if (!str.empty()) {
+            auto it = interned.lower_bound(str.data());
+            if (it != interned.end()) {
+                const std::string &s = internPool[it->second];
+                if (str.data() >= s.data() &&
+                    str.end() <= s.data() + s.size()) {
+                    nw.write(StrRef::Interned);
+                    nw.write<std::uint32_t>(it->second);
+                    nw.write<std::uint32_t>(str.data() - s.data());
+                    nw.write<std::uint32_t>(str.size());
+                    return;
+                }
+            }
+        }
+
+        nw.write(StrRef::Inline);
+        nw.writeString(str);
+    };
+
+    // Nodes are written in post-order, so that every node refers only to nodes
+    // that precede it.
+    std::unordered_map<const Node *, std::int32_t> ids;
+    std::function<std::int32_t(const Node *)> visit =
+        [&](const Node *node) -> std::int32_t {
+        if (node == nullptr) {
+            return -1;
+        }
+
+        auto it = ids.find(node);
+        if (it != ids.end()) {
+            return it->second;
+        }
+
+        const std::int32_t next = visit(node->next);
+        std::vector<std::int32_t> children;
+        children.reserve(node->children.size());
+        for (const Node *child : node->children) {
+            children.push_back(visit(child));
+        }
+
+        writeRef(node->label);
+        writeRef(node->spelling);
+        nw.write(next);
+        nw.write<std::uint32_t>(children.size());
+        for (std::int32_t child : children) {
+            nw.write(child);
+        }
+        nw.write<std::int32_t>(node->valueChild);
+        nw.write<std::int32_t>(node->poID);
+        nw.write<std::int32_t>(node->line);
+        nw.write<std::int32_t>(node->col);
+        nw.write(static_cast<std::uint8_t>(node->type));
+        nw.write(static_cast<std::uint8_t>(node->stype));
+        nw.write(static_cast<std::uint8_t>(node->state));
+        nw.write<std::uint8_t>(node->satellite << 0 | node->moved << 1 |
+                              node->last << 2 | node->leaf << 3);
+
+        const std::int32_t id = ids.size();
+        ids.emplace(node, id);
+        return id;
+    };
+
+    const std::int32_t rootId = visit(root);
+    w.write<std::uint32_t>(ids.size());
+    out += nodesOut;
+    w.write(rootId);
+    return out;
+}
+
+Tree
+Tree::deserialize(std::unique_ptr<Language> &lang, boost::string_ref data,
+                  allocator_type al)
+{
+    auto check = [](bool cond) {
+        if (!cond) {
+            throw std::runtime_error("Serialized tree is malformed");
+        }
+    };
+
+    Reader r(data);
+    check(r.read<std::uint32_t>() == serializationMagic);
+
+    Tree tree(al);
+    tree.tabWidth = r.read<std::int32_t>();
+
+    boost::string_ref str = r.readString();
+    tree.stringified.assign(str.begin(), str.end());
+
+    const std::uint32_t internedCount = r.read<std::uint32_t>();
+    for (std::uint32_t i = 0U; i < internedCount; ++i) {
+        str = r.readString();
+        tree.internPool.emplace_back(str.begin(), str.end());
+    }
+
+    auto readRef = [&]() -> boost::string_ref {
+        switch (r.read<StrRef>()) {
+            case StrRef::Stringified:
+            {
+                const std::uint32_t offset = r.read<std::uint32_t>();
+                const std::uint32_t size = r.read<std::uint32_t>();
+                check(offset <= tree.stringified.size() &&
+                      size <= tree.stringified.size() - offset);
+                return boost::string_ref(tree.stringified.data() + offset,
+                                         size);
+            }
+            case StrRef::Interned:
+            {
+                const std::uint32_t index = r.read<std::uint32_t>();
+                const std::uint32_t offset = r.read<std::uint32_t>();
+                const std::uint32_t size = r.read<std::uint32_t>();
+                check(index < tree.internPool.size());
+                const std::string &s = tree.internPool[index];
+                check(offset <= s.size() && size <= s.size() - offset);
+                return boost::string_ref(s.data() + offset, size);
+            }
+            case StrRef::Inline:
+                str = r.readString();
+                if (str.empty()) {
+                    return boost::string_ref();
+                }
+                return tree.intern(str.to_string());
+        }
+        check(false);
+        return boost::string_ref();
+    };
+
+    // Nodes were written in post-order, hence every node refers only to those
+    // nodes that were already read and their IDs match positions in the table.
+    std::uint32_t n = 0U;
+    auto readId = [&]() -> Node * {
+        const std::int32_t id = r.read<std::int32_t>();
+        check(id >= -1 && id < static_cast<std::int64_t>(n));
+        return (id == -1 ? nullptr : tree.table->at(id));
+    };
+
+    const std::uint32_t nodeCount = r.read<std::uint32_t>();
+    check(nodeCount <= data.size());
+    tree.makeTable(nodeCount);
+    std::vector<Node *> children;
+    for (; n < nodeCount; ++n) {
+        Node &node = tree.makeNode();
+        node.label = readRef();
+        node.spelling = readRef();
+        node.next = readId();
+        const std::uint32_t childCount = r.read<std::uint32_t>();
+        check(childCount <= n);
+        children.clear();
+        for (std::uint32_t i = 0U; i < childCount; ++i) {
+            children.push_back(readId());
+            check(children.back() != nullptr);
+        }
+        tree.makeChildren(node, children.data(), childCount);
+        node.valueChild = r.read<std::int32_t>();
+        check(node.valueChild >= -1 &&
+              node.valueChild < static_cast<int>(childCount));
+        node.poID = r.read<std::int32_t>();
+        node.line = r.read<std::int32_t>();
+        node.col = r.read<std::int32_t>();
+        const std::uint8_t type = r.read<std::uint8_t>();
+        check(type <= static_cast<std::uint8_t>(Type::Other));
+        node.type = static_cast<Type>(type);
+        node.stype = static_cast<SType>(r.read<std::uint8_t>());
+        check(lang->isValidSType(node.stype));
+        const std::uint8_t state = r.read<std::uint8_t>();
+        check(state <= static_cast<std::uint8_t>(State::Updated));
+        node.state = static_cast<State>(state);
+        const std::uint8_t flags = r.read<std::uint8_t>();
+        node.satellite = flags & (1 << 0);
+        node.moved = flags & (1 << 1);
+        node.last = flags & (1 << 2);
+        node.leaf = flags & (1 << 3);
+    }
+    tree.finishTable();
+
+    tree.root = readId();
+    check(tree.root != nullptr && r.atEnd());
+
+    tree.lang = std::move(lang);
+    tree.fingerprint(*tree.root);
+    return tree;
+}
@@ -19,10 +19,14 @@
 
 #include <boost/utility/string_ref.hpp>
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 
+#include <iterator>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "pmr/pmr_deque.hpp"
@@ -41,22 +45,187 @@ enum class State : std::uint8_t
 };
 
 class PNode;
-class SNode;
+class STree;
 
 enum class SType : std::uint8_t;
 
+// Summary of a subtree which is computed once after the tree is built.
+struct Fingerprint
+{
+    std::size_t structure = 0; // Hash of labels of all nodes of the subtree.
+    std::uint64_t text = 0;    // Hash of text of the subtree with comments.
+    std::uint64_t code = 0;    // Hash of text of the subtree without comments.
+    int textLength = 0;        // Length of text of the subtree with comments.
+    int codeLength = 0;        // Length of text of the subtree without comments.
+    int size = 0;              // Number of nodes of this layer of the subtree.
+    int leafCount = 0;         // Number of leaves of this layer of the subtree
+                               // excluding satellites defined by the language.
+};
+
+struct Node;
+struct NodeTable;
+
+// Fields of a node that refer to other nodes.
+enum class NodeField
+{
+    Parent,  // Parent within the same layer.
+    Next,    // Root of the next layer.
+    Relative // Matching node of the tree this one was compared against.
+};
+
+// Reference to a node stored as 32-bit index of the node in a table.  Parent
+// and next layer are in the table of the node holding the link, relatives are
+// in the table linked to it.  Link finds its node by its offset within the
+// node, so it can't be copied out of a node.
+template <NodeField F>
+class NodeLink
+{
+public:
+    // Constructs null link.
+    NodeLink() = default;
+    // No copying out of a node.
+    NodeLink(const NodeLink &rhs) = delete;
+
+    // Points this link at the node another link points at.
+    NodeLink & operator=(const NodeLink &rhs)
+    {
+        return *this = rhs.get();
+    }
+    // Points the link at a node or makes it null if `node` is `nullptr`.
+    NodeLink & operator=(Node *node);
+
+public:
+    operator Node *() const { return get(); }
+    Node * operator->() const { return get(); }
+    Node & operator*() const { return *get(); }
+
+private:
+    // Retrieves node pointed at by this link or `nullptr`.
+    Node * get() const;
+    // Retrieves node that holds this link.
+    Node * getOwner() const;
+
+private:
+    std::uint32_t index = ~std::uint32_t(); // Index of the node or all ones.
+};
+
+// Sequence of children of a node, which is a range of an array of indices of
+// children shared by all nodes of a tree.  Like links, it can't be copied out
+// of a node.
+class NodeChildren
+{
+    friend class Tree;
+
+public:
+    // Random access iterator that turns indices into nodes.
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Node *;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Node *const *;
+        using reference = Node *;
+
+    public:
+        const_iterator() = default;
+        const_iterator(Node *first, const std::uint32_t *id)
+            : first(first), id(id)
+        { }
+
+    public:
+        Node * operator*() const;
+        Node * operator[](difference_type n) const;
+
+        const_iterator & operator++() { ++id; return *this; }
+        const_iterator & operator--() { --id; return *this; }
+        const_iterator operator++(int) { return const_iterator(first, id++); }
+        const_iterator operator--(int) { return const_iterator(first, id--); }
+        const_iterator & operator+=(difference_type n)
+        { id += n; return *this; }
+        const_iterator & operator-=(difference_type n)
+        { id -= n; return *this; }
+
+        const_iterator operator+(difference_type n) const
+        { return const_iterator(first, id + n); }
+        const_iterator operator-(difference_type n) const
+        { return const_iterator(first, id - n); }
+        difference_type operator-(const const_iterator &rhs) const
+        { return id - rhs.id; }
+
+        bool operator==(const const_iterator &rhs) const
+        { return id == rhs.id; }
+        bool operator!=(const const_iterator &rhs) const
+        { return id != rhs.id; }
+        bool operator<(const const_iterator &rhs) const
+        { return id < rhs.id; }
+        bool operator>(const const_iterator &rhs) const
+        { return id > rhs.id; }
+        bool operator<=(const const_iterator &rhs) const
+        { return id <= rhs.id; }
+        bool operator>=(const const_iterator &rhs) const
+        { return id >= rhs.id; }
+
+    private:
+        Node *first = nullptr;             // First node of the table.
+        const std::uint32_t *id = nullptr; // Current index.
+    };
+
+    using iterator = const_iterator;
+    using value_type = Node *;
+    using reference = Node *;
+    using const_reference = Node *;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+public:
+    // Constructs an empty sequence.
+    NodeChildren() = default;
+    // No copying out of a node.
+    NodeChildren(const NodeChildren &rhs) = delete;
+    // No assigning.
+    NodeChildren & operator=(const NodeChildren &rhs) = delete;
+
+public:
+    const_iterator begin() const;
+    const_iterator end() const { return begin() + count; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0U; }
+
+    Node * operator[](std::size_t i) const { return begin()[i]; }
+    Node * front() const { return begin()[0]; }
+    Node * back() const { return begin()[count - 1U]; }
+
+    // Replaces child at the specified position with a node of the same tree.
+    void replace(std::size_t i, Node *node);
+
+private:
+    // Retrieves node that holds this sequence.
+    const Node & getOwner() const;
+
+private:
+    std::uint32_t first = 0U; // Position of the range in the array of indices.
+    std::uint32_t count = 0U; // Number of children.
+};
+
 struct Node
 {
-    using allocator_type = cpp17::pmr::polymorphic_allocator<cpp17::byte>;
+    // Nodes are constructed only in tables of trees.
+    friend class Tree;
 
     boost::string_ref label;
     // Leafs whose label is modified for the purpose of processing have
     // non-empty spelling that matches unmodified label.
     boost::string_ref spelling;
-    cpp17::pmr::vector<Node *> children;
-    Node *relative = nullptr;
-    Node *parent = nullptr;
-    Node *next = nullptr;
+    NodeChildren children;
+    NodeLink<NodeField::Relative> relative;
+    NodeLink<NodeField::Parent> parent;
+    NodeLink<NodeField::Next> next;
+    std::uint32_t id = 0U; // Position of the node in the table of its tree.
+    Fingerprint fingerprint;
     int valueChild = -1;
     int poID = -1; // Post-order ID.
     int line = 0;
@@ -69,38 +238,18 @@ struct Node
     bool last : 1; // This is root of a tree from the last layer.
     bool leaf : 1; // This node corresponds to something in the source.
 
-    Node(allocator_type al = {})
-        : children(al),
-          type(Type::Virtual),
+private:
+    Node()
+        : type(Type::Virtual),
           stype(),
           state(State::Unchanged),
           satellite(false), moved(false), last(false), leaf(false)
     {
     }
+
+public:
     Node(const Node &rhs) = delete;
-    Node(Node &&rhs) = default;
-    Node(Node &&rhs, allocator_type al = {})
-        : label(std::move(rhs.label)),
-          spelling(std::move(rhs.spelling)),
-          children(std::move(rhs.children), al),
-          relative(rhs.relative),
-          parent(rhs.parent),
-          next(rhs.next),
-          valueChild(rhs.valueChild),
-          poID(rhs.poID),
-          line(rhs.line),
-          col(rhs.col),
-          type(rhs.type),
-          stype(rhs.stype),
-          state(rhs.state),
-          satellite(rhs.satellite),
-          moved(rhs.moved),
-          last(rhs.last),
-          leaf(rhs.leaf)
-    {
-    }
     Node & operator=(const Node &rhs) = delete;
-    Node & operator=(Node &&rhs) = default;
 
     bool hasValue() const
     {
@@ -118,6 +267,133 @@ struct Node
     }
 };
 
+// Links and children find nodes holding them via offsets of their fields.
+static_assert(std::is_standard_layout<Node>::value,
+              "Offsets of fields of Node must be well-defined.");
+
+// Header of a contiguous array of all nodes of a tree, which immediately
+// follows it in memory.  Nodes refer to each other by their positions in the
+// array.
+struct NodeTable
+{
+    NodeTable *peer = nullptr;            // Table of relatives of nodes.
+    std::uint32_t *childIds = nullptr;    // Indices of children of all nodes.
+    std::uint32_t size = 0U;              // Number of nodes in the array.
+
+    // Retrieves table of a node that belongs to a tree.
+    static NodeTable & of(const Node &node)
+    {
+        Node *first = const_cast<Node *>(&node - node.id);
+        return reinterpret_cast<NodeTable *>(first)[-1];
+    }
+
+    // Retrieves node by its position.
+    Node * at(std::uint32_t index)
+    {
+        return reinterpret_cast<Node *>(this + 1) + index;
+    }
+
+    // Makes nodes of the other table relatives of nodes of this one.
+    // Relatives from the previously linked table are dropped.
+    void link(NodeTable &other)
+    {
+        if (peer != &other) {
+            for (std::uint32_t i = 0U; i < size; ++i) {
+                at(i)->relative = nullptr;
+            }
+            peer = &other;
+        }
+    }
+};
+
+static_assert(sizeof(NodeTable)%alignof(Node) == 0,
+              "Nodes must be aligned when placed after NodeTable.");
+
+template <NodeField F>
+inline NodeLink<F> &
+NodeLink<F>::operator=(Node *node)
+{
+    if (node == nullptr) {
+        index = ~std::uint32_t();
+        return *this;
+    }
+
+    NodeTable &table = NodeTable::of(*getOwner());
+    NodeTable &target = NodeTable::of(*node);
+    if (F == NodeField::Relative) {
+        // Happens on the first match unless trees were linked in advance.
+        table.link(target);
+    } else {
+        assert(&table == &target && "Links must stay within a tree!");
+    }
+
+    index = node->id;
+    return *this;
+}
+
+template <NodeField F>
+inline Node *
+NodeLink<F>::get() const
+{
+    if (index == ~std::uint32_t()) {
+        return nullptr;
+    }
+
+    NodeTable &table = NodeTable::of(*getOwner());
+    return (F == NodeField::Relative ? table.peer : &table)->at(index);
+}
+
+template <NodeField F>
+inline Node *
+NodeLink<F>::getOwner() const
+{
+    const std::size_t offset = (F == NodeField::Parent)
+                             ? offsetof(Node, parent)
+                             : (F == NodeField::Next)
+                             ? offsetof(Node, next)
+                             : offsetof(Node, relative);
+    const char *self = reinterpret_cast<const char *>(this);
+    return const_cast<Node *>(reinterpret_cast<const Node *>(self - offset));
+}
+
+inline Node *
+NodeChildren::const_iterator::operator*() const
+{
+    return first + *id;
+}
+
+inline Node *
+NodeChildren::const_iterator::operator[](difference_type n) const
+{
+    return first + id[n];
+}
+
+inline NodeChildren::const_iterator
+NodeChildren::begin() const
+{
+    if (count == 0U) {
+        return const_iterator();
+    }
+
+    NodeTable &table = NodeTable::of(getOwner());
+    return const_iterator(table.at(0U), table.childIds + first);
+}
+
+inline void
+NodeChildren::replace(std::size_t i, Node *node)
+{
+    NodeTable &table = NodeTable::of(getOwner());
+    assert(&table == &NodeTable::of(*node) && "Children must be of the tree!");
+    table.childIds[first + i] = node->id;
+}
+
+inline const Node &
+NodeChildren::getOwner() const
+{
+    const char *self = reinterpret_cast<const char *>(this);
+    return *reinterpret_cast<const Node *>(self - offsetof(Node, children));
+}
+
 class Tree
 {
     using allocator_type = cpp17::pmr::polymorphic_allocator<cpp17::byte>;
@@ -129,15 +405,22 @@ public:
     Tree(const Tree &rhs) = delete;
     Tree(Tree &&rhs) = default;
     Tree(std::unique_ptr<Language> lang, int tabWidth,
-         const std::string &contents, const PNode *node,
+         boost::string_ref contents, const PNode *node,
          allocator_type al = {});
     Tree(std::unique_ptr<Language> lang, int tabWidth,
-         const std::string &contents, const SNode *node,
+         boost::string_ref contents, const STree &stree,
          allocator_type al = {});
 
     Tree & operator=(const Tree &rhs) = delete;
     Tree & operator=(Tree &&rhs) = default;
 
+public:
+    // Reconstructs tree from the result of serialize().  Takes ownership of
+    // the language only on success.  Throws `std::runtime_error` if data is
+    // malformed.
+    static Tree deserialize(std::unique_ptr<Language> &lang,
+                            boost::string_ref data, allocator_type al = {});
+
 public:
     // Checks whether the tree is empty and thus shouldn't be used.
     bool isEmpty() const
@@ -167,6 +450,11 @@ public:
         return lang.get();
     }
 
+    // Makes nodes of the trees relatives of each other's nodes dropping
+    // relatives from other trees.  Happens on the first assignment of a
+    // relative, but must be done in advance if it can happen concurrently.
+    void link(Tree &other);
+
     // Marks nodes of the subtree as moved if that makes sense for them.
     void markTreeAsMoved(Node *node);
 
@@ -176,24 +464,50 @@ public:
     // Dumps tree on standard output for debugging purposes.
     void dump() const;
 
+    // Converts freshly built tree into binary form that doesn't depend on its
+    // location in memory.  Language isn't stored.
+    std::string serialize() const;
+
     // Propagates states (both added/deleted and moved flags) across layers of
     // the tree.
     void propagateStates();
 
 private:
-    // Turns SNode-subtree into a corresponding Node-subtree.
-    Node * materializeSNode(const std::string &contents,
-                            const SNode *node, const SNode *parent);
-    // Turns PNode-subtree into a corresponding Node-subtree.
-    Node * materializePNode(const std::string &contents, const PNode *node);
+    // Turns SNode-subtree of a parse tree into a corresponding Node-subtree.
+    // `stack` is a temporary storage for children of nodes being materialized.
+    Node * materializeSNode(boost::string_ref contents,
+                            const PNode *node, const PNode *parent,
+                            std::vector<Node *> &stack);
+    // Turns PNode-subtree into a corresponding Node-subtree.  `stack` is a
+    // temporary storage for children of nodes being materialized.
+    Node * materializePNode(boost::string_ref contents, const PNode *node,
+                            std::vector<Node *> &stack);
+
+    // Computes fingerprints of all nodes of the subtree.
+    void fingerprint(Node &node);
 
     // Interns a string.
     boost::string_ref intern(std::string &&str);
 
+    // Allocates table for at most `capacity` nodes.
+    void makeTable(std::size_t capacity);
+    // Constructs next node of the table.
+    Node & makeNode();
+    // Appends indices of children to the array and assigns them to the node.
+    void makeChildren(Node &node, Node *const *children, std::size_t count);
+    // Moves array of indices of children into storage of the tree.
+    void finishTable();
+
 private:
     std::unique_ptr<Language> lang;
-    // Storage of all nodes managed by this unit.
+    // Storage of all nodes managed by this unit and of indices of children.
     Pool<Node> nodes;
+    // Header of contiguous array of nodes of this tree.
+    NodeTable *table = nullptr;
+    // Maximum number of nodes of the table being built.
+    std::size_t capacity = 0U;
+    // Indices of children while the table is being built.
+    std::vector<std::uint32_t> childIds;
     Node *root = nullptr;
     // Storage of most labels and spelling.
     cpp17::pmr::vector<char> stringified;
@@ -207,7 +521,8 @@ std::vector<Node *> postOrder(Node &root);
 
 void reduceTreesCoarse(Node *T1, Node *T2);
 
-// Turns tree defined by the node into a string.
+// Turns tree defined by the node into a string.  Size hint defaults to length
+// of text from the fingerprint.
 std::string printSubTree(const Node &root, bool withComments,
                          int size_hint = -1);
 
@@ -16,10 +16,14 @@
 
 #include "TSTransformer.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/utility/string_ref.hpp>
 #include "tree_sitter/api.h"
@@ -28,41 +32,124 @@
 #include "TreeBuilder.hpp"
 #include "types.hpp"
 
+static TSParser * getParser(const TSLanguage &language);
+static bool applyEdit(TSTree *tree, std::string &contents,
+                      const TSTextEdit &edit);
+static TSPoint advancePoint(TSPoint point, boost::string_ref text);
 static bool isSeparator(Type type);
 
-TSTransformer::TSTransformer(const std::string &contents,
-                             const TSLanguage &tsLanguage,
-                             TreeBuilder &tb,
+TSParseTree::TSParseTree() : tree(nullptr, &ts_tree_delete), language(nullptr)
+{ }
+
+TSSymbolTable::TSSymbolTable(const TSLanguage &language,
                            const std::unordered_map<std::string, SType> &stypes,
                              const std::unordered_map<std::string, Type> &types,
-                             const std::unordered_set<std::string> &badNodes,
+                             const std::unordered_set<std::string> &badNodes)
+    : separator(stypes.at("separator"))
+{
+    auto makeEntry = [&](const char name[]) {
+        Entry entry = {};
+
+        auto it = stypes.find(name);
+        if (it != stypes.end()) {
+            entry.stype = it->second;
+            entry.hasSType = true;
+        }
+
+        auto typeIt = types.find(name);
+        if (typeIt != types.end()) {
+            entry.type = typeIt->second;
+            entry.hasType = true;
+        }
+
+        entry.bad = (badNodes.find(name) != badNodes.end());
+        return entry;
+    };
+
+    // Several symbols can share the same name, they all get the same entry.
+    const std::uint32_t count = ts_language_symbol_count(&language);
+    entries.reserve(count);
+    for (std::uint32_t i = 0U; i < count; ++i) {
+        const TSSymbol symbol = static_cast<TSSymbol>(i);
+        entries.push_back(makeEntry(ts_language_symbol_name(&language,
+                                                            symbol)));
+    }
+
+    error = makeEntry(ts_language_symbol_name(&language,
+                                              static_cast<TSSymbol>(-1)));
+}
+
+const TSSymbolTable::Entry &
+TSSymbolTable::operator[](TSSymbol symbol) const
+{
+    if (symbol < entries.size()) {
+        return entries[symbol];
+    }
+    return error;
+}
+
+TSTransformer::TSTransformer(boost::string_ref contents,
+                             const TSLanguage &tsLanguage,
+                             TreeBuilder &tb,
+                             const TSSymbolTable &symbols,
                              int tabWidth,
                              bool debug)
-    : contents(contents), tsLanguage(tsLanguage), tb(tb), stypes(stypes),
-      types(types), badNodes(badNodes), tabWidth(tabWidth), debug(debug)
+    : contents(contents), tsLanguage(tsLanguage), tb(tb), symbols(symbols),
+      tabWidth(tabWidth), debug(debug)
 { }
 
 void
 TSTransformer::transform()
 {
-    std::unique_ptr<TSParser , void(*)(TSParser *)> parser(ts_parser_new(),
-                                                           &ts_parser_delete);
-    ts_parser_set_language(parser.get(), &tsLanguage);
-
-    std::unique_ptr<TSTree, void(*)(TSTree *)> tree(
-        ts_parser_parse_string(parser.get(), NULL,
-                               contents.c_str(), contents.size()),
-        &ts_tree_delete
-    );
+    std::unique_ptr<TSTree, void(*)(TSTree *)> tree(parse(nullptr),
+                                                    &ts_tree_delete);
+    build(tree.get());
+}
+
+void
+TSTransformer::transform(TSParseTree &prev,
+                         const std::vector<TSTextEdit> &edits)
+{
+    bool reuse = (!prev.empty() && prev.language == &tsLanguage);
+    for (const TSTextEdit &edit : edits) {
+        if (!reuse) {
+            break;
+        }
+        reuse = applyEdit(prev.tree.get(), prev.contents, edit);
+    }
+    reuse = (reuse && prev.contents == contents);
+
+    TSTree *tree = parse(reuse ? prev.tree.get() : nullptr);
+    prev.tree.reset(tree);
+    prev.language = &tsLanguage;
+    prev.contents = contents.to_string();
+
+    build(tree);
+}
+
+TSTree *
+TSTransformer::parse(const TSTree *oldTree)
+{
+    TSParser *parser = getParser(tsLanguage);
+
+    TSTree *tree = ts_parser_parse_string(parser, oldTree, contents.data(),
+                                          contents.size());
     if (tree == nullptr) {
+        // Make the parser usable for the next document.
+        ts_parser_reset(parser);
         throw std::runtime_error("Failed to build a tree");
     }
+    return tree;
+}
 
+void
+TSTransformer::build(const TSTree *tree)
+{
     position = 0;
     line = 1;
     col = 1;
 
-    tb.setRoot(visit(ts_tree_root_node(tree.get()), Type::Other));
+    tb.setRoot(visit(ts_tree_root_node(tree), Type::Other));
 
     if (debug) {
         for (const std::string &type : badSTypes) {
@@ -77,21 +164,20 @@ TSTransformer::transform()
 PNode *
 TSTransformer::visit(const TSNode &node, Type defType)
 {
+    const TSSymbolTable::Entry &info = symbols[ts_node_symbol(node)];
+
     SType stype = {};
-    const char *type = ts_node_type(node);
-    auto it = stypes.find(type);
-    if (it != stypes.end()) {
-        stype = it->second;
+    if (info.hasSType) {
+        stype = info.stype;
     } else if (debug) {
         uint32_t from = ts_node_start_byte(node);
         uint32_t to = ts_node_end_byte(node);
-        boost::string_ref val(contents.c_str() + from, to - from);
-        badSTypes.insert(type + (": `" + val.to_string() + '`'));
+        boost::string_ref val(contents.data() + from, to - from);
+        badSTypes.insert(ts_node_type(node) + (": `" + val.to_string() + '`'));
     }
 
-    auto typeIt = types.find(type);
-    if (typeIt != types.end()) {
-        defType = typeIt->second;
+    if (info.hasType) {
+        defType = info.type;
     }
 
     PNode *pnode = tb.addNode({}, stype);
@@ -100,13 +186,7 @@ TSTransformer::visit(const TSNode &node, Type defType)
     for (uint32_t i = 0; i < childCount; ++i) {
         const TSNode child = ts_node_child(node, i);
         if (ts_node_child_count(child) == 0) {
-            SType stype = {};
-            auto it = stypes.find(ts_node_type(child));
-            if (it != stypes.end()) {
-                stype = it->second;
-            }
-
-            visitLeaf(stype, pnode, child, defType);
+            visitLeaf(symbols[ts_node_symbol(child)], pnode, child, defType);
         } else {
             tb.append(pnode, visit(child, defType));
         }
@@ -116,29 +196,30 @@ TSTransformer::visit(const TSNode &node, Type defType)
 }
 
 void
-TSTransformer::visitLeaf(SType stype,
+TSTransformer::visitLeaf(const TSSymbolTable::Entry &info,
                          PNode *pnode,
                          const TSNode &leaf,
                          Type defType)
 {
-    if (badNodes.find(ts_node_type(leaf)) != badNodes.end()) {
+    if (info.bad) {
         return;
     }
 
     uint32_t from = ts_node_start_byte(leaf);
     uint32_t to = ts_node_end_byte(leaf);
 
-    boost::string_ref skipped(contents.c_str() + position, from - position);
+    boost::string_ref skipped(contents.data() + position, from - position);
     updatePosition(skipped, tabWidth, line, col);
 
-    boost::string_ref val(contents.c_str() + from, to - from);
-    Type type = determineType(leaf);
+    boost::string_ref val(contents.data() + from, to - from);
+    Type type = determineType(leaf, info);
     if (type == Type::Other) {
         type = defType;
     }
 
+    SType stype = (info.hasSType ? info.stype : SType{});
     if (stype == SType{} && isSeparator(type)) {
-        stype = stypes.at("separator");
+        stype = symbols.getSeparator();
     }
 
     const std::uint32_t len = to - from;
@@ -150,24 +231,87 @@ TSTransformer::visitLeaf(SType stype,
 }
 
 Type
-TSTransformer::determineType(const TSNode &node)
+TSTransformer::determineType(const TSNode &node,
+                             const TSSymbolTable::Entry &info)
 {
-    const char *type = ts_node_type(node);
-    auto it = types.find(type);
-    if (it != types.cend()) {
-        return it->second;
+    if (info.hasType) {
+        return info.type;
     }
 
     if (debug) {
+        const char *type = ts_node_type(node);
         uint32_t from = ts_node_start_byte(node);
         uint32_t to = ts_node_end_byte(node);
-        boost::string_ref val(contents.c_str() + from, to - from);
+        boost::string_ref val(contents.data() + from, to - from);
         badTypes.insert(type + (": `" + val.to_string() + '`'));
     }
 
     return Type::Other;
 }
 
+// Retrieves parser for the language that is owned by the calling thread.
+// Parsers are created on first use and live until the thread exits.
+static TSParser *
+getParser(const TSLanguage &language)
+{
+    using ParserPtr = std::unique_ptr<TSParser, void(*)(TSParser *)>;
+    static thread_local std::unordered_map<const TSLanguage *,
+                                           ParserPtr> parsers;
+
+    auto it = parsers.find(&language);
+    if (it == parsers.end()) {
+        ParserPtr parser(ts_parser_new(), &ts_parser_delete);
+        if (!ts_parser_set_language(parser.get(), &language)) {
+            throw std::runtime_error("Incompatible tree-sitter language");
+        }
+        it = parsers.emplace(&language, std::move(parser)).first;
+    }
+    return it->second.get();
+}
+
+// Applies edit to the contents and informs the tree about it.  Returns
+// `false` if the edit is out of bounds.
+static bool
+applyEdit(TSTree *tree, std::string &contents, const TSTextEdit &edit)
+{
+    if (edit.start > edit.oldEnd || edit.oldEnd > contents.size()) {
+        return false;
+    }
+
+    boost::string_ref text = contents;
+
+    TSInputEdit inputEdit;
+    inputEdit.start_byte = edit.start;
+    inputEdit.old_end_byte = edit.oldEnd;
+    inputEdit.new_end_byte = edit.start + edit.text.size();
+    inputEdit.start_point = advancePoint({ 0, 0 },
+                                         text.substr(0U, edit.start));
+    inputEdit.old_end_point =
+        advancePoint(inputEdit.start_point,
+                     text.substr(edit.start, edit.oldEnd - edit.start));
+    inputEdit.new_end_point = advancePoint(inputEdit.start_point, edit.text);
+    ts_tree_edit(tree, &inputEdit);
+
+    contents.replace(edit.start, edit.oldEnd - edit.start, edit.text);
+    return true;
+}
+
+// Computes position in rows and byte columns after the text that starts at
+// the specified point.
+static TSPoint
+advancePoint(TSPoint point, boost::string_ref text)
+{
+    const std::size_t lastNl = text.rfind('\n');
+    if (lastNl == boost::string_ref::npos) {
+        point.column += text.size();
+        return point;
+    }
+
+    point.row += std::count(text.begin(), text.end(), '\n');
+    point.column = text.size() - (lastNl + 1U);
+    return point;
+}
+
 // Determines whether type is a separator.
 static bool
 isSeparator(Type type)
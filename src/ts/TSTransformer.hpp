@@ -17,11 +17,15 @@
 #ifndef ZOGRASCOPE_TS_TSTRANSFORMER_HPP_
 #define ZOGRASCOPE_TS_TSTRANSFORMER_HPP_
 
+#include <boost/utility/string_ref.hpp>
+
 #include <cstdint>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "tree_sitter/api.h"
 
@@ -31,41 +35,116 @@ class TreeBuilder;
 enum class SType : std::uint8_t;
 enum class Type : std::uint8_t;
 
+// Replacement of a range of bytes of contents with a text.
+struct TSTextEdit
+{
+    std::uint32_t start;  // Offset of the first replaced byte.
+    std::uint32_t oldEnd; // Offset past the last replaced byte.
+    std::string text;     // Replacement.
+};
+
+// Tree produced by tree-sitter along with contents it was built for, which
+// is kept between parses of the same buffer to reparse it incrementally.
+class TSParseTree
+{
+    friend class TSTransformer;
+
+public:
+    // Constructs an empty tree.
+    TSParseTree();
+
+public:
+    // Checks whether there is no tree to reuse.
+    bool empty() const
+    { return tree == nullptr; }
+
+private:
+    std::unique_ptr<TSTree, void(*)(TSTree *)> tree; // Tree-sitter's tree.
+    const TSLanguage *language;                      // Language of the tree.
+    std::string contents;                            // Contents of the tree.
+};
+
+// Properties of nodes of a tree-sitter language indexed by their symbols, which
+// spares looking up names of node types in maps.
+class TSSymbolTable
+{
+public:
+    // Properties of a single symbol.
+    struct Entry
+    {
+        SType stype;   // SType of the node if `hasSType` is set.
+        Type type;     // Type of the node if `hasType` is set.
+        bool hasSType; // Whether SType is known.
+        bool hasType;  // Whether Type is known.
+        bool bad;      // Whether node is to be ignored.
+    };
+
+public:
+    // Constructs an empty table.
+    TSSymbolTable() = default;
+    // Maps every symbol of the language by its name.  "separator" key of
+    // `stypes` specifies SType of separators.
+    TSSymbolTable(const TSLanguage &language,
+                  const std::unordered_map<std::string, SType> &stypes,
+                  const std::unordered_map<std::string, Type> &types,
+                  const std::unordered_set<std::string> &badNodes);
+
+public:
+    // Retrieves properties of a symbol.
+    const Entry & operator[](TSSymbol symbol) const;
+
+    // Retrieves SType of separators.
+    SType getSeparator() const
+    { return separator; }
+
+private:
+    std::vector<Entry> entries; // Properties of symbols.
+    Entry error {};             // Properties of the error symbol.
+    SType separator {};         // SType of separators.
+};
+
 // Uses tree-sitter to parse a file and transforms the result into PTree.
+// Parsers are reused by each thread.
 class TSTransformer
 {
 public:
-    // Remembers parameters to use them later.  `contents`, `styles` and `types`
-    // have to be lvalues.
-    TSTransformer(const std::string &contents,
+    // Remembers parameters to use them later.  `contents` and `symbols` have
+    // to be lvalues.
+    TSTransformer(boost::string_ref contents,
                   const TSLanguage &tsLanguage,
                   TreeBuilder &tb,
-                  const std::unordered_map<std::string, SType> &stypes,
-                  const std::unordered_map<std::string, Type> &types,
-                  const std::unordered_set<std::string> &badNodes,
+                  const TSSymbolTable &symbols,
                   int tabWidth,
                   bool debug);
 
 public:
     // Does all the work of transforming.
     void transform();
+    // Same as transform(), but reparses only parts of the contents that are
+    // affected by `edits`, which turn contents of `prev` into the current
+    // ones when applied in order.  Falls back to parsing from scratch if
+    // `prev` is empty or doesn't match.  Updates `prev` on success.
+    void transform(TSParseTree &prev, const std::vector<TSTextEdit> &edits);
 
 private:
+    // Parses contents reusing old tree if it's not `nullptr`.
+    TSTree * parse(const TSTree *oldTree);
+    // Transforms parse tree into PTree.
+    void build(const TSTree *tree);
     // Transforms a single node while propagating last node type to leafs
     // without type.
     PNode * visit(const TSNode &node, Type defType);
     // Transforms a leaf.
-    void visitLeaf(SType stype, PNode *pnode, const TSNode &leaf, Type defType);
+    void visitLeaf(const TSSymbolTable::Entry &info, PNode *pnode,
+                   const TSNode &leaf, Type defType);
     // Determines type of a child of the specified node.
-    Type determineType(const TSNode &node);
+    Type determineType(const TSNode &node, const TSSymbolTable::Entry &info);
 
 private:
-    const std::string &contents;                          // Contents to parse.
+    boost::string_ref contents;                           // Contents to parse.
     const TSLanguage &tsLanguage;                         // Language to use.
     TreeBuilder &tb;                                      // Result builder.
-    const std::unordered_map<std::string, SType> &stypes; // Node type -> SType.
-    const std::unordered_map<std::string, Type> &types;   // Node type -> Type.
-    const std::unordered_set<std::string> &badNodes;      // Nodes to ignore.
+    const TSSymbolTable &symbols;                         // Node properties.
     std::unordered_set<std::string> badSTypes;            // Missing stypes.
     std::unordered_set<std::string> badTypes;             // Missing types.
     int line;                                             // Current line.
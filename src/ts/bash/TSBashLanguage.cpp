@@ -18,6 +18,10 @@
 
 #include <cassert>
 
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "ts/bash/TSBashSType.hpp"
 #include "ts/TSTransformer.hpp"
 #include "TreeBuilder.hpp"
@@ -31,7 +35,7 @@ extern "C" const TSLanguage *tree_sitter_bash(void);
 
 TsBashLanguage::TsBashLanguage() : tsLanguage(*tree_sitter_bash())
 {
-    stypes = {
+    std::unordered_map<std::string, SType> stypes = {
         { "separator", +TSBashSType::Separator },
         { "comment", +TSBashSType::Comment },
 
@@ -98,7 +102,7 @@ TsBashLanguage::TsBashLanguage() : tsLanguage(*tree_sitter_bash())
         { "variable_name", +TSBashSType::VariableName },
     };
 
-    types = {
+    std::unordered_map<std::string, Type> types = {
         { "comment", Type::Comments },
         { "command_name", Type::Directives },
 
@@ -185,7 +189,9 @@ TsBashLanguage::TsBashLanguage() : tsLanguage(*tree_sitter_bash())
     // Unused: "!", "#", "%", "&", "/", ":", ":-", ":?", ";", ";&", ";;", ";;&",
     //         "<", "<&", "<<", "<<-", "<<<", "?", "`"
 
-    badNodes = { "\n" };
+    std::unordered_set<std::string> badNodes = { "\n" };
+
+    symbols = TSSymbolTable(tsLanguage, stypes, types, badNodes);
 }
 
 Type
@@ -193,18 +199,29 @@ TsBashLanguage::mapToken(int token) const
 { return static_cast<Type>(token); }
 
 TreeBuilder
-TsBashLanguage::parse(const std::string &contents,
+TsBashLanguage::parse(boost::string_ref contents,
                       const std::string &/*fileName*/, int tabWidth, bool debug,
                       cpp17::pmr::monolithic &mr) const
 {
     TreeBuilder tb(mr);
-    TSTransformer t(contents, tsLanguage, tb, stypes, types, badNodes, tabWidth,
-                    debug);
+    TSTransformer t(contents, tsLanguage, tb, symbols, tabWidth, debug);
     t.transform();
 
     return tb;
 }
 
+TreeBuilder
+TsBashLanguage::reparse(boost::string_ref contents, TSParseTree &prev,
+                        const std::vector<TSTextEdit> &edits, int tabWidth,
+                        bool debug, cpp17::pmr::monolithic &mr) const
+{
+    TreeBuilder tb(mr);
+    TSTransformer t(contents, tsLanguage, tb, symbols, tabWidth, debug);
+    t.transform(prev, edits);
+
+    return tb;
+}
+
 bool
 TsBashLanguage::isTravellingNode(const Node */*x*/) const
 { return false; }
@@ -315,6 +332,12 @@ TsBashLanguage::classify(SType stype) const
     }
 }
 
+bool
+TsBashLanguage::isValidSType(SType stype) const
+{
+    return -stype <= TSBashSType::VariableName;
+}
+
 const char *
 TsBashLanguage::toString(SType stype) const
 {
@@ -17,13 +17,11 @@
 #ifndef ZOGRASCOPE_TS_BASH_TSBASHLANGUAGE_HPP_
 #define ZOGRASCOPE_TS_BASH_TSBASHLANGUAGE_HPP_
 
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
+#include "ts/TSTransformer.hpp"
 #include "Language.hpp"
 
-struct TSLanguage;
-
 // Bash-specific routines.
 class TsBashLanguage : public Language
 {
@@ -35,11 +33,19 @@ public:
     // Maps language-specific token to an element of Type enumeration.
     virtual Type mapToken(int token) const override;
     // Parses source file into a tree.
-    virtual TreeBuilder parse(const std::string &contents,
+    virtual TreeBuilder parse(boost::string_ref contents,
                               const std::string &fileName,
                               int tabWidth,
                               bool debug,
                               cpp17::pmr::monolithic &mr) const override;
+    // Parses edited source file into a tree reusing unchanged parts of its
+    // previous parse tree, which gets updated.
+    TreeBuilder reparse(boost::string_ref contents,
+                        TSParseTree &prev,
+                        const std::vector<TSTextEdit> &edits,
+                        int tabWidth,
+                        bool debug,
+                        cpp17::pmr::monolithic &mr) const;
 
     // Checks whether node doesn't have fixed position within a tree and can
     // move between internal nodes as long as post-order of leafs is preserved.
@@ -84,13 +90,12 @@ public:
     // Maps language-specific stype to generic mtype.
     virtual MType classify(SType stype) const override;
     // Stringifies value of SType enumeration.
+    virtual bool isValidSType(SType stype) const override;
     virtual const char * toString(SType stype) const override;
 
 private:
     const TSLanguage &tsLanguage;                  // Language description.
-    std::unordered_map<std::string, SType> stypes; // Maps nodes to STypes.
-    std::unordered_map<std::string, Type> types;   // Maps nodes to Types.
-    std::unordered_set<std::string> badNodes;      // Lists nodes to ignore.
+    TSSymbolTable symbols;                         // Properties of nodes.
 };
 
 #endif // ZOGRASCOPE_TS_BASH_TSBASHLANGUAGE_HPP_
@@ -18,6 +18,10 @@
 
 #include <cassert>
 
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "ts/lua/TSLuaSType.hpp"
 #include "ts/TSTransformer.hpp"
 #include "TreeBuilder.hpp"
@@ -31,7 +35,7 @@ extern "C" const TSLanguage *tree_sitter_lua(void);
 
 TsLuaLanguage::TsLuaLanguage() : tsLanguage(*tree_sitter_lua())
 {
-    stypes = {
+    std::unordered_map<std::string, SType> stypes = {
         { "separator", +TSLuaSType::Separator },
         { "comment", +TSLuaSType::Comment },
 
@@ -92,7 +96,7 @@ TsLuaLanguage::TsLuaLanguage() : tsLanguage(*tree_sitter_lua())
         { "or", +TSLuaSType::BinaryOperator },
     };
 
-    types = {
+    std::unordered_map<std::string, Type> types = {
         { "comment", Type::Comments },
         { "shebang", Type::Directives },
 
@@ -166,6 +170,7 @@ TsLuaLanguage::TsLuaLanguage() : tsLanguage(*tree_sitter_lua())
         { "vararg_expression", Type::Other },
     };
 
+    symbols = TSSymbolTable(tsLanguage, stypes, types, {});
 }
 
 Type
@@ -173,18 +178,29 @@ TsLuaLanguage::mapToken(int token) const
 { return static_cast<Type>(token); }
 
 TreeBuilder
-TsLuaLanguage::parse(const std::string &contents,
+TsLuaLanguage::parse(boost::string_ref contents,
                      const std::string &/*fileName*/, int tabWidth, bool debug,
                      cpp17::pmr::monolithic &mr) const
 {
     TreeBuilder tb(mr);
-    TSTransformer t(contents, tsLanguage, tb, stypes, types, badNodes, tabWidth,
-                    debug);
+    TSTransformer t(contents, tsLanguage, tb, symbols, tabWidth, debug);
     t.transform();
 
     return tb;
 }
 
+TreeBuilder
+TsLuaLanguage::reparse(boost::string_ref contents, TSParseTree &prev,
+                       const std::vector<TSTextEdit> &edits, int tabWidth,
+                       bool debug, cpp17::pmr::monolithic &mr) const
+{
+    TreeBuilder tb(mr);
+    TSTransformer t(contents, tsLanguage, tb, symbols, tabWidth, debug);
+    t.transform(prev, edits);
+
+    return tb;
+}
+
 bool
 TsLuaLanguage::isTravellingNode(const Node */*x*/) const
 { return false; }
@@ -352,6 +368,12 @@ TsLuaLanguage::classify(SType stype) const
     }
 }
 
+bool
+TsLuaLanguage::isValidSType(SType stype) const
+{
+    return -stype <= TSLuaSType::UnaryOperator;
+}
+
 const char *
 TsLuaLanguage::toString(SType stype) const
 {
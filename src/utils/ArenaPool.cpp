@@ -0,0 +1,56 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "ArenaPool.hpp"
+
+#include <cstddef>
+
+#include <memory>
+#include <mutex>
+
+#include "pmr/monolithic.hpp"
+
+ArenaPool::ArenaPool(std::size_t maxRetained) : maxRetained(maxRetained)
+{ }
+
+ArenaPool::Arena
+ArenaPool::take()
+{
+    std::unique_ptr<cpp17::pmr::monolithic> arena;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free.empty()) {
+            arena = std::move(free.back());
+            free.pop_back();
+        }
+    }
+
+    if (arena == nullptr) {
+        arena.reset(new cpp17::pmr::monolithic());
+    }
+    return Arena(arena.release(), Returner(this));
+}
+
+void
+ArenaPool::put(cpp17::pmr::monolithic *arena)
+{
+    std::unique_ptr<cpp17::pmr::monolithic> owned(arena);
+    owned->reset(maxRetained);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    free.push_back(std::move(owned));
+}
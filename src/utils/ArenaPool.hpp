@@ -0,0 +1,78 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ZOGRASCOPE_UTILS_ARENAPOOL_HPP_
+#define ZOGRASCOPE_UTILS_ARENAPOOL_HPP_
+
+#include <cstddef>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "pmr/monolithic.hpp"
+
+// Set of arenas that are reused instead of being destroyed, which saves
+// allocating and freeing the same blocks of memory for every processed file.
+// Can be used by several threads at the same time.
+class ArenaPool
+{
+    // Returns arena to the pool.
+    class Returner
+    {
+    public:
+        // Remembers the pool.
+        explicit Returner(ArenaPool *pool = nullptr) : pool(pool)
+        { }
+
+    public:
+        // Puts arena back into the pool.
+        void operator()(cpp17::pmr::monolithic *arena) const
+        { pool->put(arena); }
+
+    private:
+        ArenaPool *pool; // Owner of the arena.
+    };
+
+public:
+    // Arena which returns to the pool on destruction.  The pool must outlive
+    // it.
+    using Arena = std::unique_ptr<cpp17::pmr::monolithic, Returner>;
+
+public:
+    // Arenas keep at most `maxRetained` bytes of memory between uses.
+    explicit ArenaPool(std::size_t maxRetained = 16U*1024U*1024U);
+
+    ArenaPool(const ArenaPool &rhs) = delete;
+    ArenaPool & operator=(const ArenaPool &rhs) = delete;
+
+public:
+    // Retrieves an empty arena creating one if there are no free arenas.
+    Arena take();
+
+private:
+    // Resets the arena and puts it into the list of free ones.
+    void put(cpp17::pmr::monolithic *arena);
+
+private:
+    const std::size_t maxRetained; // Limit on memory kept by an arena.
+    std::mutex mutex;              // Protects the list of free arenas.
+    // Arenas that aren't in use.
+    std::vector<std::unique_ptr<cpp17::pmr::monolithic>> free;
+};
+
+#endif // ZOGRASCOPE_UTILS_ARENAPOOL_HPP_
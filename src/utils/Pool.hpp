@@ -17,6 +17,8 @@
 #ifndef ZOGRASCOPE_UTILS_POOL_HPP_
 #define ZOGRASCOPE_UTILS_POOL_HPP_
 
+#include <cstddef>
+
 #include <utility>
 
 #include "pmr/polymorphic_allocator.hpp"
@@ -52,6 +54,15 @@ public:
         return data;
     }
 
+    // Allocates uninitialized storage for an array of objects of another
+    // type, which share lifetime with objects made by the pool.
+    template <typename U>
+    U * allocate(std::size_t n)
+    {
+        return static_cast<U *>(alloc.resource()->allocate(n*sizeof(U),
+                                                           alignof(U)));
+    }
+
 private:
     allocator_type alloc; // Allocator used for objects.
 };
@@ -0,0 +1,124 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "utils/ThreadPool.hpp"
+
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+struct ThreadPool::Job
+{
+    std::function<void()> f;  // Code of the task.
+    bool done;                // Whether the task has finished.
+    std::exception_ptr error; // Exception thrown by the task, if any.
+};
+
+ThreadPool::ThreadPool(int nWorkers) : stopping(false)
+{
+    workers.reserve(nWorkers);
+    for (int i = 0; i < nWorkers; ++i) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool::Task
+ThreadPool::submit(std::function<void()> f)
+{
+    Task task = std::make_shared<Job>();
+    task->f = std::move(f);
+    task->done = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(task);
+    }
+    changed.notify_one();
+
+    return task;
+}
+
+void
+ThreadPool::wait(const Task &task)
+{
+    if (!task) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!task->done) {
+        if (queue.empty()) {
+            changed.wait(lock);
+        } else {
+            runNext(lock);
+        }
+    }
+
+    if (task->error) {
+        std::rethrow_exception(task->error);
+    }
+}
+
+void
+ThreadPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (!queue.empty()) {
+            runNext(lock);
+        } else if (stopping) {
+            break;
+        } else {
+            changed.wait(lock);
+        }
+    }
+}
+
+void
+ThreadPool::runNext(std::unique_lock<std::mutex> &lock)
+{
+    Task task = std::move(queue.front());
+    queue.pop_front();
+
+    lock.unlock();
+    try {
+        task->f();
+    } catch (...) {
+        task->error = std::current_exception();
+    }
+    // Release resources captured by the task.
+    task->f = {};
+    lock.lock();
+
+    task->done = true;
+    changed.notify_all();
+}
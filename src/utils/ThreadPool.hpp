@@ -0,0 +1,75 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ZOGRASCOPE_UTILS_THREADPOOL_HPP_
+#define ZOGRASCOPE_UTILS_THREADPOOL_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Set of threads that execute submitted tasks.  A thread that waits for a task
+// executes queued tasks in the meantime, so tasks can submit and wait for
+// other tasks without exhausting the pool.
+class ThreadPool
+{
+    struct Job;
+
+public:
+    // Handle of a submitted task.  Empty handle designates completed task.
+    using Task = std::shared_ptr<Job>;
+
+public:
+    // Starts specified number of worker threads.  Pool with no workers still
+    // functions, tasks are executed by threads that wait for them.
+    explicit ThreadPool(int nWorkers);
+
+    // Stops worker threads after the queue is emptied.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &rhs) = delete;
+    ThreadPool & operator=(const ThreadPool &rhs) = delete;
+
+public:
+    // Queues a task for execution.
+    Task submit(std::function<void()> f);
+
+    // Waits for the task to finish executing other tasks in the meantime.
+    // Rethrows exception thrown by the task, if any.
+    void wait(const Task &task);
+
+private:
+    // Loop of a worker thread.
+    void work();
+    // Takes a job from the queue and runs it.  The lock is released while the
+    // job is executing.
+    void runNext(std::unique_lock<std::mutex> &lock);
+
+private:
+    std::mutex mutex;                 // Protects all fields below.
+    std::condition_variable changed;  // Signaled on queue and job changes.
+    std::deque<Task> queue;           // Jobs to be executed.
+    bool stopping;                    // Whether workers should quit.
+    std::vector<std::thread> workers; // Worker threads.
+};
+
+#endif // ZOGRASCOPE_UTILS_THREADPOOL_HPP_
@@ -0,0 +1,369 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "utils/Tracer.hpp"
+
+#include <boost/scope_exit.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+// Single recorded event.
+struct Event
+{
+    std::uint64_t time;     // Raw timestamp.
+    Tracer::StageId stage; // Stage identifier.
+    bool begin;            // Whether this is beginning or end of the stage.
+    std::string subject;   // What beginning of the stage processes, if known.
+};
+
+// Per-thread state of a stage that's being replayed.
+struct OpenStage
+{
+    Tracer::StageId stage; // Stage identifier.
+    std::uint64_t start;   // Raw timestamp of the beginning.
+    std::uint64_t nested;  // Time spent in nested stages.
+};
+
+// Aggregated statistics of a stage.
+struct StageStats
+{
+    Tracer::StageId stage;    // Stage identifier.
+    std::uint64_t self = 0U;  // Raw time spent in the stage itself.
+    std::uint64_t total = 0U; // Raw time spent in the stage and nested ones.
+    int calls = 0;            // Number of times the stage was entered.
+};
+
+// Buffer of a thread that's currently used by the thread.
+struct ThreadBuffer
+{
+    std::uint64_t tracerId; // Identifier of the tracer that owns the buffer.
+    void *buffer;           // Pointer to the buffer.
+};
+
+}
+
+// Process-wide table of interned stage names.  Names are stored only as keys
+// of the map, which doesn't move them.
+static std::mutex namesMutex;
+static std::vector<const std::string *> names;
+static std::unordered_map<std::string, Tracer::StageId> nameIds;
+
+// Source of identifiers of tracers.
+static std::atomic<std::uint64_t> nextTracerId(1U);
+
+// Buffer of this thread, which stays valid while its tracer exists.
+static thread_local ThreadBuffer threadBuffer = { 0U, nullptr };
+
+static std::uint64_t readTicks();
+static std::int64_t readNs();
+static void writeJsonString(std::ostream &os, boost::string_ref str);
+
+struct Tracer::Buffer
+{
+    // Allocates storage for events.
+    explicit Buffer(int tid) : tid(tid), events(bufferCapacity)
+    { }
+
+    const int tid;                      // Number of the thread.
+    std::vector<Event> events;          // Ring buffer of events.
+    std::atomic<std::uint64_t> head {0}; // Number of recorded events.
+
+    // Invokes visitor for each event that's still in the buffer.
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        const std::uint64_t end = head.load(std::memory_order_acquire);
+        const std::uint64_t start = (end > bufferCapacity)
+                                  ? end - bufferCapacity
+                                  : 0U;
+        for (std::uint64_t i = start; i < end; ++i) {
+            f(events[i%bufferCapacity]);
+        }
+    }
+};
+
+Tracer::Tracer()
+    : id(nextTracerId++), startTicks(readTicks()), startNs(readNs())
+{ }
+
+Tracer::~Tracer() = default;
+
+Tracer::StageId
+Tracer::intern(boost::string_ref name)
+{
+    // Each thread remembers names it has seen to avoid locking.
+    static thread_local std::unordered_map<std::string, StageId> cache;
+
+    std::string key = name.to_string();
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(namesMutex);
+    auto inserted = nameIds.emplace(key, names.size());
+    if (inserted.second) {
+        names.push_back(&inserted.first->first);
+    }
+    const StageId stage = inserted.first->second;
+    cache.emplace(std::move(key), stage);
+    return stage;
+}
+
+std::string
+Tracer::getName(StageId stage)
+{
+    std::lock_guard<std::mutex> lock(namesMutex);
+    return *names.at(stage);
+}
+
+void
+Tracer::begin(StageId stage, boost::string_ref subject)
+{
+    Buffer &buffer = getBuffer();
+    const std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    Event &event = buffer.events[head%bufferCapacity];
+    // Storage of the subject is reused when the slot is overwritten.
+    event.subject.assign(subject.data(), subject.size());
+    event.time = readTicks();
+    event.stage = stage;
+    event.begin = true;
+    buffer.head.store(head + 1U, std::memory_order_release);
+}
+
+void
+Tracer::end(StageId stage)
+{
+    const std::uint64_t time = readTicks();
+    Buffer &buffer = getBuffer();
+    const std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    Event &event = buffer.events[head%bufferCapacity];
+    event.subject.clear();
+    event.time = time;
+    event.stage = stage;
+    event.begin = false;
+    buffer.head.store(head + 1U, std::memory_order_release);
+}
+
+Tracer::Buffer &
+Tracer::getBuffer()
+{
+    if (threadBuffer.tracerId != id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.emplace_back(new Buffer(buffers.size() + 1));
+        threadBuffer = { id, buffers.back().get() };
+    }
+    return *static_cast<Buffer *>(threadBuffer.buffer);
+}
+
+void
+Tracer::writeChromeTrace(std::ostream &os) const
+{
+    const double nsPerTick = getNsPerTick();
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    BOOST_SCOPE_EXIT_ALL(&) { os.flags(flags); os.precision(precision); };
+
+    os << std::fixed << std::setprecision(3);
+    os << "{\"traceEvents\":[";
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    bool first = true;
+    for (const std::unique_ptr<Buffer> &buffer : buffers) {
+        // Ends of stages whose beginnings were overwritten are dropped.
+        int depth = 0;
+        buffer->forEach([&](const Event &event) {
+            if (event.begin) {
+                ++depth;
+            } else if (depth == 0) {
+                return;
+            } else {
+                --depth;
+            }
+
+            os << (first ? "\n" : ",\n");
+            first = false;
+
+            os << "{\"name\":";
+            writeJsonString(os, getName(event.stage));
+            os << ",\"ph\":\"" << (event.begin ? 'B' : 'E') << '"'
+               << ",\"ts\":" << (event.time - startTicks)*nsPerTick/1000.0;
+            if (!event.subject.empty()) {
+                os << ",\"args\":{\"subject\":";
+                writeJsonString(os, event.subject);
+                os << '}';
+            }
+            os << ",\"pid\":1,\"tid\":" << buffer->tid << '}';
+        });
+    }
+
+    os << "\n]}\n";
+}
+
+void
+Tracer::printProfile(std::ostream &os) const
+{
+    std::vector<StageStats> stats;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (const std::unique_ptr<Buffer> &buffer : buffers) {
+        std::vector<OpenStage> open;
+        buffer->forEach([&](const Event &event) {
+            if (event.begin) {
+                open.push_back({ event.stage, event.time, 0U });
+                return;
+            }
+
+            if (open.empty()) {
+                return;
+            }
+
+            const OpenStage closed = open.back();
+            open.pop_back();
+
+            if (closed.stage >= stats.size()) {
+                stats.resize(closed.stage + 1U);
+            }
+
+            const std::uint64_t duration = event.time - closed.start;
+            StageStats &s = stats[closed.stage];
+            s.self += duration - std::min(duration, closed.nested);
+            ++s.calls;
+
+            // Time of recursive invocations is already accounted for.
+            auto sameStage = [&closed](const OpenStage &outer) {
+                return outer.stage == closed.stage;
+            };
+            if (std::none_of(open.cbegin(), open.cend(), sameStage)) {
+                s.total += duration;
+            }
+
+            if (!open.empty()) {
+                open.back().nested += duration;
+            }
+        });
+    }
+    lock.unlock();
+
+    for (Tracer::StageId i = 0U; i < stats.size(); ++i) {
+        stats[i].stage = i;
+    }
+
+    stats.erase(std::remove_if(stats.begin(), stats.end(),
+                               [](const StageStats &s) {
+                                   return s.calls == 0;
+                               }),
+                stats.end());
+    std::stable_sort(stats.begin(), stats.end(),
+                     [](const StageStats &a, const StageStats &b) {
+                         return a.self > b.self;
+                     });
+
+    const double msPerTick = getNsPerTick()/1000000.0;
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    char fill = os.fill();
+    BOOST_SCOPE_EXIT_ALL(&) {
+        os.flags(flags);
+        os.precision(precision);
+        os.fill(fill);
+    };
+
+    os << std::fixed << std::setprecision(3) << std::right << std::setfill(' ');
+    os << std::setw(12) << "self, ms" << std::setw(12) << "total, ms"
+       << std::setw(8) << "calls" << "  stage\n";
+    for (const StageStats &s : stats) {
+        os << std::setw(12) << s.self*msPerTick
+           << std::setw(12) << s.total*msPerTick
+           << std::setw(8) << s.calls
+           << "  " << getName(s.stage) << '\n';
+    }
+}
+
+double
+Tracer::getNsPerTick() const
+{
+    const std::uint64_t ticks = readTicks() - startTicks;
+    const std::int64_t ns = readNs() - startNs;
+    if (ticks == 0U || ns <= 0) {
+        return 1.0;
+    }
+    return static_cast<double>(ns)/ticks;
+}
+
+// Reads raw timestamp, which is cheaper than querying a clock where time stamp
+// counter is available.
+static std::uint64_t
+readTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return readNs();
+#endif
+}
+
+// Reads monotonic time in nanoseconds.
+static std::int64_t
+readNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+          .count();
+}
+
+// Writes string as a quoted JSON string.
+static void
+writeJsonString(std::ostream &os, boost::string_ref str)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    os << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"':  os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20U) {
+                    // Other control characters are invalid inside strings.
+                    os << "\\u00" << hexDigits[(c >> 4) & 0xF]
+                       << hexDigits[c & 0xF];
+                } else {
+                    os << c;
+                }
+                break;
+        }
+    }
+    os << '"';
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ZOGRASCOPE_UTILS_TRACER_HPP_
+#define ZOGRASCOPE_UTILS_TRACER_HPP_
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+// Recorder of beginnings and ends of stages.  Every thread writes events into a
+// ring buffer of its own without taking any locks, so recording is cheap and
+// can be done from any thread.  Once the buffer is full, the oldest events are
+// overwritten.  Exporting should be done after traced threads are done.
+class Tracer
+{
+    struct Buffer;
+
+public:
+    // Identifier of an interned stage name.
+    using StageId = std::uint32_t;
+
+    // Number of events that are kept per thread.
+    static const std::size_t bufferCapacity = 1U << 16;
+
+public:
+    // Remembers starting time.
+    Tracer();
+
+    // No copying.
+    Tracer(const Tracer&) = delete;
+    // No assigning.
+    Tracer & operator=(const Tracer&) = delete;
+
+    // Destructs buffers.
+    ~Tracer();
+
+public:
+    // Maps stage name to its identifier, which stays the same throughout the
+    // lifetime of the process.  Names are never freed, so they shouldn't
+    // include anything that varies, like paths.  Thread-safe.
+    static StageId intern(boost::string_ref name);
+    // Retrieves name of an interned stage.  Thread-safe.
+    static std::string getName(StageId stage);
+
+public:
+    // Records beginning of a stage on the current thread.  Non-empty `subject`
+    // names what the stage processes (e.g., a file).
+    void begin(StageId stage, boost::string_ref subject = {});
+    // Records end of a stage on the current thread.
+    void end(StageId stage);
+
+    // Writes recorded events in JSON format of Chrome's trace events.
+    void writeChromeTrace(std::ostream &os) const;
+    // Prints flat profile, which lists time spent in each stage on its own and
+    // together with nested stages.  Stages are sorted by self time.
+    void printProfile(std::ostream &os) const;
+
+private:
+    // Retrieves buffer of the current thread.
+    Buffer & getBuffer();
+    // Measures duration of a tick of raw time in nanoseconds.
+    double getNsPerTick() const;
+
+private:
+    const std::uint64_t id;                      // Unique id of this object.
+    std::uint64_t startTicks;                    // Raw time of construction.
+    std::int64_t startNs;                        // Clock time of construction.
+    mutable std::mutex mutex;                    // Protects list of buffers.
+    std::vector<std::unique_ptr<Buffer>> buffers; // Buffers of all threads.
+};
+
+#endif // ZOGRASCOPE_UTILS_TRACER_HPP_
@@ -17,6 +17,10 @@
 #include "fs.hpp"
 
 #include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstring>
 
 #include <fstream>
 #include <iterator>
@@ -60,3 +64,43 @@ readFile(const std::string &path)
 
     return normalizeEols({ std::istreambuf_iterator<char>{ifile}, {} });
 }
+
+FileContents::FileContents(const std::string &path)
+{
+    if (fs::is_directory(path)) {
+        throw std::runtime_error("Not a regular file: " + path);
+    }
+
+    // Empty files can't be mapped and other failures to map a file are
+    // handled by regular reading, which reports errors.
+    boost::system::error_code ec;
+    if (fs::file_size(path, ec) != 0U && !ec) {
+        try {
+            mapping.open(path);
+        } catch (const std::exception &) {
+            mapping.close();
+        }
+    }
+
+    if (!mapping.is_open()) {
+        buffer = readFile(path);
+        contents = buffer;
+        return;
+    }
+
+    const char *const data = mapping.data();
+    const std::size_t size = mapping.size();
+    for (const char *cr = data;
+         (cr = static_cast<const char *>(std::memchr(cr, '\r',
+                                                     data + size - cr)));
+         ++cr) {
+        if (cr + 1 != data + size && cr[1] == '\n') {
+            buffer = normalizeEols(std::string(data, size));
+            contents = buffer;
+            mapping.close();
+            return;
+        }
+    }
+
+    contents = boost::string_ref(data, size);
+}
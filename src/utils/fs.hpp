@@ -17,6 +17,9 @@
 #ifndef ZOGRASCOPE_UTILS_FS_HPP_
 #define ZOGRASCOPE_UTILS_FS_HPP_
 
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_ref.hpp>
+
 #include <string>
 
 // Temporary file in RAII-style.
@@ -51,4 +54,28 @@ private:
 // specifies a directory or file reading has failed.
 std::string readFile(const std::string &path);
 
+// Contents of a file with normalized line endings, which is memory-mapped
+// instead of being read into memory when no normalization is necessary.
+class FileContents
+{
+public:
+    // Opens or reads the file.  Throws `std::runtime_error` if `path`
+    // parameter specifies a directory or file reading has failed.
+    explicit FileContents(const std::string &path);
+
+    // Contents is referred to by string_ref and can't be copied or moved.
+    FileContents(const FileContents &rhs) = delete;
+    FileContents & operator=(const FileContents &rhs) = delete;
+
+public:
+    // Retrieves contents of the file, which lives as long as this object.
+    boost::string_ref str() const
+    { return contents; }
+
+private:
+    boost::iostreams::mapped_file_source mapping; // Mapping of the file.
+    std::string buffer;                           // Fallback storage.
+    boost::string_ref contents;                   // Contents of the file.
+};
+
 #endif // ZOGRASCOPE_UTILS_FS_HPP_
@@ -17,14 +17,18 @@
 #include "utils/strings.hpp"
 
 #include <climits>
+#include <cmath>
 
+#include <algorithm>
 #include <iterator>
 #include <limits>
 #include <utility>
 
 #include <boost/utility/string_ref.hpp>
 
-#include "utils/CountIterator.hpp"
+static int countCommon(const unsigned short *a, int n,
+                       const unsigned short *b, int m);
+static std::vector<DiceString *> pointersTo(std::vector<DiceString> &strings);
 
 float
 DiceString::compare(DiceString &other)
@@ -36,18 +40,57 @@ DiceString::compare(DiceString &other)
         return 0.0f;
     }
 
-    const std::vector<unsigned short> &bigrams = getBigrams();
-    const std::vector<unsigned short> &otherBigrams = other.getBigrams();
-    const int common = std::set_intersection(bigrams.cbegin(), bigrams.cend(),
-                                             otherBigrams.cbegin(),
-                                             otherBigrams.cend(),
-                                             CountIterator())
-                      .getCount();
+    const cpp17::pmr::vector<unsigned short> &bigrams = getBigrams();
+    const cpp17::pmr::vector<unsigned short> &otherBigrams = other.getBigrams();
+    const int common = countCommon(bigrams.data(), bigrams.size(),
+                                   otherBigrams.data(), otherBigrams.size());
 
     return (2.0f*common)/(bigrams.size() + otherBigrams.size());
 }
 
-const std::vector<unsigned short> &
+// Counts number of common elements of two sorted sequences of unique elements.
+static int
+countCommon(const unsigned short *a, int n, const unsigned short *b, int m)
+{
+    if (n > m) {
+        std::swap(a, b);
+        std::swap(n, m);
+    }
+
+    // Sets whose ranges don't overlap have nothing in common.
+    if (a[n - 1] < b[0] || b[m - 1] < a[0]) {
+        return 0;
+    }
+
+    const unsigned short *const aEnd = a + n;
+    const unsigned short *const bEnd = b + m;
+    int common = 0;
+
+    // Looking up elements of much smaller set in the larger one is faster than
+    // going through both of them.
+    if (n*16 < m) {
+        for (; a != aEnd && b != bEnd; ++a) {
+            b = std::lower_bound(b, bEnd, *a);
+            if (b != bEnd && *b == *a) {
+                ++common;
+                ++b;
+            }
+        }
+        return common;
+    }
+
+    // Merging without branches that depend on data, which are hard to predict.
+    while (a != aEnd && b != bEnd) {
+        const unsigned short x = *a;
+        const unsigned short y = *b;
+        common += (x == y);
+        a += (x <= y);
+        b += (x >= y);
+    }
+    return common;
+}
+
+const cpp17::pmr::vector<unsigned short> &
 DiceString::getBigrams()
 {
     if (!bigrams.empty() || s.length() < 2U) {
@@ -60,29 +103,35 @@ DiceString::getBigrams()
               | static_cast<unsigned char>(s[at + 1U]);
     };
 
-    // Using std::sort is fine for very small number of elements.
+    // Using std::sort is fine for very small number of elements.  Sorting is
+    // done in a scratch buffer to allocate exactly as much storage as needed.
     if (s.length() < 10000) {
-        bigrams.reserve(s.length() - 1U);
+        thread_local std::vector<unsigned short> scratch;
+        scratch.clear();
         for (std::size_t i = 0U; i < s.length() - 1U; ++i) {
-            bigrams.push_back(makeBigram(s, i));
+            scratch.push_back(makeBigram(s, i));
         }
-        std::sort(bigrams.begin(), bigrams.end());
-        bigrams.erase(std::unique(bigrams.begin(), bigrams.end()),
-                      bigrams.end());
+        std::sort(scratch.begin(), scratch.end());
+        scratch.erase(std::unique(scratch.begin(), scratch.end()),
+                      scratch.end());
 
+        bigrams.assign(scratch.cbegin(), scratch.cend());
         return bigrams;
     }
 
     // But for string of tenths of thousands characters this works faster (exact
     // threshold yet to be determined).
 
-    const int maxBigrams = std::numeric_limits<unsigned short>::max();
+    const int maxBigrams = std::numeric_limits<unsigned short>::max() + 1;
     thread_local std::vector<bool> present(maxBigrams);
 
-    bigrams.reserve(s.length() - 1U);
+    int count = 0;
     for (std::size_t i = 0U; i < s.length() - 1U; ++i) {
-        present[makeBigram(s, i)] = true;
+        const int bigram = makeBigram(s, i);
+        count += !present[bigram];
+        present[bigram] = true;
     }
+    bigrams.reserve(count);
     for (int i = 0; i < maxBigrams; ++i) {
         if (present[i]) {
             bigrams.push_back(i);
@@ -93,16 +142,140 @@ DiceString::getBigrams()
     return bigrams;
 }
 
+DiceIndex::DiceIndex(std::vector<DiceString> &strings, float threshold)
+    : DiceIndex(pointersTo(strings), threshold)
+{
+}
+
+DiceIndex::DiceIndex(const std::vector<DiceString *> &strings, float threshold)
+    : threshold(threshold), seen(strings.size()), stamp(0)
+{
+    sizes.reserve(strings.size());
+    for (DiceString *str : strings) {
+        const cpp17::pmr::vector<unsigned short> &bigrams = str->getBigrams();
+        sizes.push_back(bigrams.size());
+        for (unsigned short bigram : bigrams) {
+            ++frequencies[bigram];
+        }
+    }
+
+    for (int i = 0, n = strings.size(); i < n; ++i) {
+        if (sizes[i] == 0) {
+            shortStrings.push_back(i);
+            continue;
+        }
+
+        const std::vector<unsigned short> ordered =
+            order(strings[i]->getBigrams());
+        const int prefix = prefixLength(ordered.size());
+        for (int j = 0; j < prefix; ++j) {
+            postings[ordered[j]].push_back(i);
+        }
+    }
+}
+
+// Makes list of pointers to elements of a vector.
+static std::vector<DiceString *>
+pointersTo(std::vector<DiceString> &strings)
+{
+    std::vector<DiceString *> pointers;
+    pointers.reserve(strings.size());
+    for (DiceString &str : strings) {
+        pointers.push_back(&str);
+    }
+    return pointers;
+}
+
+std::vector<int>
+DiceIndex::lookup(DiceString &s)
+{
+    const cpp17::pmr::vector<unsigned short> &bigrams = s.getBigrams();
+    if (bigrams.empty()) {
+        return shortStrings;
+    }
+
+    ++stamp;
+
+    std::vector<int> candidates;
+    const std::vector<unsigned short> ordered = order(bigrams);
+    const int prefix = prefixLength(ordered.size());
+    for (int i = 0; i < prefix; ++i) {
+        auto it = postings.find(ordered[i]);
+        if (it == postings.end()) {
+            continue;
+        }
+
+        for (int candidate : it->second) {
+            if (seen[candidate] != stamp &&
+                sizesCompatible(ordered.size(), sizes[candidate])) {
+                seen[candidate] = stamp;
+                candidates.push_back(candidate);
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    return candidates;
+}
+
+std::vector<unsigned short>
+DiceIndex::order(const cpp17::pmr::vector<unsigned short> &bigrams) const
+{
+    auto frequency = [this](unsigned short bigram) {
+        auto it = frequencies.find(bigram);
+        return (it == frequencies.end() ? 0 : it->second);
+    };
+
+    std::vector<std::pair<int, unsigned short>> keyed;
+    keyed.reserve(bigrams.size());
+    for (unsigned short bigram : bigrams) {
+        keyed.emplace_back(frequency(bigram), bigram);
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    std::vector<unsigned short> ordered;
+    ordered.reserve(keyed.size());
+    for (const auto &entry : keyed) {
+        ordered.push_back(entry.second);
+    }
+    return ordered;
+}
+
+int
+DiceIndex::prefixLength(int size) const
+{
+    // Given string of `size` bigrams, any string similar enough to it shares
+    // at least t*size/(2 - t) bigrams with it.  The value is rounded down and
+    // slightly decreased to stay on the safe side of floating-point errors.
+    const double t = threshold;
+    const int minCommon = std::floor(t*size/(2.0 - t) - 1e-4);
+    return size - std::max(minCommon, 1) + 1;
+}
+
+bool
+DiceIndex::sizesCompatible(int a, int b) const
+{
+    // Similarity can't exceed 2*min(a, b)/(a + b).
+    const double t = threshold - 1e-4;
+    return 2.0*std::min(a, b) >= t*(a + b);
+}
+
 std::string &&
 normalizeEols(std::string &&str)
 {
-    for (std::size_t pos = str.find('\r');
-         pos != std::string::npos;
-         pos = str.find('\r', pos)) {
-        if (pos < str.size() - 1 && str[pos + 1] == '\n') {
-            str.erase(pos, 1U);
+    std::size_t pos = str.find('\r');
+    if (pos == std::string::npos) {
+        return std::move(str);
+    }
+
+    // Compact the string in a single pass.
+    std::size_t out = pos;
+    for (; pos < str.size(); ++pos) {
+        if (str[pos] != '\r' || pos + 1 == str.size() || str[pos + 1] != '\n') {
+            str[out++] = str[pos];
         }
     }
+    str.resize(out);
 
     return std::move(str);
 }
@@ -19,12 +19,23 @@
 
 #include <boost/utility/string_ref.hpp>
 
+#include <unordered_map>
 #include <vector>
 
+#include "pmr/pmr_vector.hpp"
+
+// String that computes Dice's coefficient of its bigrams with other strings.
+// Bigrams are computed lazily and are allocated via the allocator, so that
+// caller can place them into an arena.
 class DiceString
 {
+    friend class DiceIndex;
+
+    using allocator_type = cpp17::pmr::polymorphic_allocator<cpp17::byte>;
+
 public:
-    DiceString(boost::string_ref s) : s(s)
+    DiceString(boost::string_ref s, allocator_type al = {})
+        : s(s), bigrams(al)
     {
     }
 
@@ -37,11 +48,53 @@ public:
     }
 
 private:
-    const std::vector<unsigned short> & getBigrams();
+    const cpp17::pmr::vector<unsigned short> & getBigrams();
 
 private:
     boost::string_ref s;
-    std::vector<unsigned short> bigrams;
+    cpp17::pmr::vector<unsigned short> bigrams; // Sorted unique bigrams.
+};
+
+// Index of a set of strings for looking up those of them which might be similar
+// to a given string without comparing it against every element of the set.
+// Implements prefix filtering: bigrams of each string are ordered from rare to
+// frequent ones and only as many of them are indexed as is necessary to
+// guarantee that any pair of strings with similarity not less than the
+// threshold shares at least one indexed bigram.
+class DiceIndex
+{
+public:
+    // Indexes the strings, which must outlive the index.  Threshold must be in
+    // (0.0, 1.0] range.
+    DiceIndex(std::vector<DiceString> &strings, float threshold);
+    // Same as above, but for strings that are stored elsewhere.
+    DiceIndex(const std::vector<DiceString *> &strings, float threshold);
+
+public:
+    // Retrieves sorted list of indexes of strings whose similarity with `s`
+    // might be not less than the threshold.  Strings shorter than two
+    // characters are candidates only to each other.
+    std::vector<int> lookup(DiceString &s);
+
+private:
+    // Orders bigrams from rare to frequent ones.
+    std::vector<unsigned short>
+    order(const cpp17::pmr::vector<unsigned short> &bigrams) const;
+    // Computes number of leading ordered bigrams of a string with `size`
+    // bigrams that need to be examined.
+    int prefixLength(int size) const;
+    // Checks whether sizes of bigram sets allow reaching the threshold.
+    bool sizesCompatible(int a, int b) const;
+
+private:
+    float threshold;                            // Minimal similarity.
+    std::vector<int> sizes;                     // Number of bigrams.
+    std::unordered_map<int, int> frequencies;   // Number of strings a bigram
+                                                // appears in.
+    std::unordered_map<int, std::vector<int>> postings; // Bigram -> strings.
+    std::vector<int> shortStrings;              // Strings without bigrams.
+    std::vector<int> seen;                      // Marks for deduplication.
+    int stamp;                                  // Current mark value.
 };
 
 // Splits string in two parts at the leftmost delimiter.  Returns a pair of
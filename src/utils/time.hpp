@@ -20,11 +20,15 @@
 #include <chrono>
 #include <iosfwd>
 #include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <boost/utility/string_ref.hpp>
+
+#include "utils/Tracer.hpp"
 #include "utils/trees.hpp"
 
 class TimeReport
@@ -39,6 +43,8 @@ class TimeReport
     {
         bool measuring;
         bool foreign; // The measurement came from nested report.
+        bool traced;  // Beginning of the measurement was passed to a tracer.
+        Tracer::StageId tracedAs; // Stage known to the tracer, if traced.
         std::string stage;
         clock::time_point start;
         clock::time_point end;
@@ -46,9 +52,9 @@ class TimeReport
 
         std::vector<Measure> children;
 
-        Measure(std::string &&stage, Measure *parent)
-            : measuring(true), foreign(false), stage(std::move(stage)),
-              start(clock::now()), parent(parent)
+        Measure(std::string stage, Measure *parent)
+            : measuring(true), foreign(false), traced(false), tracedAs(0U),
+              stage(std::move(stage)), start(clock::now()), parent(parent)
         {
         }
 
@@ -66,9 +72,11 @@ class TimeReport
 public:
     TimeReport() = default;
     // Constructs nested time report object that moves its children to the
-    // `parent` in destructor or in `commit()`.
+    // `parent` in destructor or in `commit()`.  Tracer of the parent is
+    // inherited.
     explicit TimeReport(TimeReport &parent)
-        : parent(parent.current), parentIndex(parent.current->children.size())
+        : tracer(parent.tracer), parent(parent.current),
+          parentIndex(parent.current->children.size())
     { }
     // For nested time report, moves measurements into linked parent time
     // report.
@@ -80,22 +88,59 @@ public:
     }
 
 public:
+    // Specifies tracer that receives beginnings and ends of stages started
+    // after this call.  Null pointer disables tracing.
+    void setTracer(Tracer *tracer)
+    {
+        this->tracer = tracer;
+    }
+
     ProxyTimer measure(const std::string &stage);
 
-    void start(std::string stage)
+    void start(const std::string &stage)
     {
-        current->children.emplace_back(std::move(stage), current);
+        current->children.emplace_back(stage, current);
         current = &current->children.back();
+        if (tracer != nullptr) {
+            // Tracer keeps stage names forever, so what follows ": " (like
+            // path of a file) is passed as a subject of the stage.
+            boost::string_ref name = stage;
+            boost::string_ref subject;
+            const std::string::size_type colon = stage.find(": ");
+            if (colon != std::string::npos) {
+                name = name.substr(0U, colon);
+                subject = boost::string_ref(stage).substr(colon + 2U);
+            }
+
+            current->tracedAs = Tracer::intern(name);
+            current->traced = true;
+            tracer->begin(current->tracedAs, subject);
+        }
     }
 
     void stop()
     {
+        if (tracer != nullptr && current->traced && current->measuring) {
+            tracer->end(current->tracedAs);
+        }
         current->stop();
         if (current->parent != nullptr) {
             current = current->parent;
         }
     }
 
+    // Commits nested reports that were created from the same position of the
+    // same parent report and destroys them.
+    static void commitAll(std::vector<std::unique_ptr<TimeReport>> &nested)
+    {
+        // All nested reports get inserted at the same position, committing
+        // them in reverse order preserves order in which they were created.
+        while (!nested.empty()) {
+            nested.back()->commit();
+            nested.pop_back();
+        }
+    }
+
     // Moves measurements into linked parent time report, if any.  The moved
     // measurements are marked as foreign.
     void commit()
@@ -116,6 +161,7 @@ public:
 private:
     Measure root {"Overall", nullptr};
     Measure *current {&root};
+    Tracer *tracer = nullptr;
 
     // For nested time report object.
     Measure *parent = nullptr;
@@ -148,12 +194,12 @@ public:
     }
 
 public:
-    void measure(std::string stage)
+    void measure(const std::string &stage)
     {
         tr->stop();
         done = true;
 
-        *this = tr->measure(std::move(stage));
+        *this = tr->measure(stage);
     }
 
 private:
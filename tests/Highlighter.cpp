@@ -16,7 +16,11 @@
 
 #include "Catch/catch.hpp"
 
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
 
 #include "utils/strings.hpp"
 #include "utils/time.hpp"
@@ -60,13 +64,40 @@ int f() { return 10; }
     CHECK(hi.print(1, 2) == "/* line1\n");
     CHECK(hi.print(4, 2) == "// line4\n/* line5");
     CHECK(hi.print(7, 1) == " * line7 */");
-    CHECK(hi.print(7, 1) == "");
-    CHECK(hi.print(6, 3) == "// line8");
+    CHECK(hi.print(7, 1) == " * line7 */");
+    CHECK(hi.print(6, 3) == " * line6\n * line7 */\n// line8");
     CHECK(hi.print(10, 1) == " * line10");
     CHECK(hi.print(14, 10) == "// line14");
     CHECK(hi.print(20, 10) == "");
 }
 
+TEST_CASE("Lines can be printed in any order", "[highlighter]")
+{
+    std::string input;
+    for (int i = 0; i < 100; ++i) {
+        input += "--[[ comment\n"
+                 "     of three\n"
+                 "     lines ]] local v" + std::to_string(i) + " = 1\n";
+    }
+
+    Tree tree = parseLua(input);
+
+    std::vector<boost::string_ref> lines = split(input, '\n');
+    const int nLines = lines.size();
+
+    TermHighlighter hi(tree);
+    for (int i = nLines; i > 0; --i) {
+        REQUIRE(hi.print(i, 1) == lines[i - 1]);
+    }
+    for (int i = 1; i <= nLines; i += 7) {
+        REQUIRE(hi.print(i, 1) == lines[i - 1]);
+    }
+    REQUIRE(hi.print(1, nLines) == input.substr(0, input.size() - 1U));
+    REQUIRE(hi.print(150, 3) == lines[149].to_string() + '\n' +
+                                lines[150].to_string() + '\n' +
+                                lines[151].to_string());
+}
+
 TEST_CASE("Printing a subtree", "[highlighter]")
 {
     Tree tree = parseC(R"(
@@ -185,3 +216,27 @@ TEST_CASE("Rename highligh has priority over move", "[highlighter]")
             }
         })");
 }
+
+TEST_CASE("Spelling diffs can be shared", "[highlighter]")
+{
+    std::string words;
+    for (int i = 0; i < 100; ++i) {
+        words += " w" + std::to_string(i);
+    }
+
+    Tree oldTree = parseLua("x = \"" + words + " old" + words + "\"");
+    Tree newTree = parseLua("x = \"" + words + " new" + words + "\"");
+
+    TimeReport tr;
+    compare(oldTree, newTree, tr, true, false);
+
+    auto spellingDiffs = std::make_shared<SpellingDiffs>();
+
+    TermHighlighter oldHi(oldTree, true);
+    oldHi.setSpellingDiffs(spellingDiffs);
+    CHECK(oldHi.print() == "x = \"" + words + " {-old-}" + words + "\"");
+
+    TermHighlighter newHi(newTree, false);
+    newHi.setSpellingDiffs(spellingDiffs);
+    CHECK(newHi.print() == "x = \"" + words + " {+new+}" + words + "\"");
+}
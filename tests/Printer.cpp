@@ -24,6 +24,7 @@
 #include "utils/time.hpp"
 #include "Printer.hpp"
 #include "compare.hpp"
+#include "decoration.hpp"
 #include "tree.hpp"
 
 #include "tests.hpp"
@@ -617,3 +618,38 @@ TEST_CASE("Diffing by characters", "[printer]")
 
     REQUIRE(printed == expected);
 }
+
+TEST_CASE("Streaming produces the same output with decorations", "[printer]")
+{
+    Tree oldTree = parseLua(R"(
+        function f(x)
+            return x + 1
+        end
+    )");
+    Tree newTree = parseLua(R"(
+        function f(x, y)
+            local z = y
+            return x + z
+        end
+    )");
+
+    TimeReport tr;
+    compare(oldTree, newTree, tr, true, true);
+
+    auto print = [&](bool streaming) {
+        std::ostringstream oss;
+        Printer printer(*oldTree.getRoot(), *newTree.getRoot(),
+                        *oldTree.getLanguage(), oss);
+        printer.addHeader({ "old", "new" });
+        printer.setStreaming(streaming);
+        printer.print(tr);
+        return oss.str();
+    };
+
+    decor::enableDecorations();
+    std::string buffered = print(false);
+    std::string streamed = print(true);
+    decor::disableDecorations();
+
+    REQUIRE(streamed == buffered);
+}
@@ -437,3 +437,99 @@ TEST_CASE("Identical lines in different states don't match",
 
     REQUIRE(printed == expected);
 }
+
+TEST_CASE("Unchanged lines anchor alignment of changed ones", "[alignment]")
+{
+    std::string printed = compareAndPrint(parseLua(R"(
+        function first()
+            return 1
+        end
+
+        function second()
+            return 2
+        end
+    )"), parseLua(R"(
+        function first()
+            return 1
+        end
+
+        function inserted()
+            return 2
+        end
+
+        function second()
+            return 20
+        end
+    )"));
+
+    std::string expected = normalizeText(R"(
+        ~~~~~~~~~~~~~~~~~~~~~~!~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        ~~~~~~~~~~~~~~~~~~~~~~!~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        1                    |   1
+        2  function first()  |   2  function first()
+        3      return 1      |   3      return 1
+        4  end               |   4  end
+        5                    |   5
+        -                    {+++}   6  {+function+}{+ +}{+inserted+}{+(+}{+)+}
+        -                    {+++}   7      {+return+}{+ +}{+2+}
+        -                    {+++}   8  {+end+}
+        -                    {+++}   9
+        6  function second() |  10  function second()
+        7      return {#2#}  {#~#}  11      return {#20#}
+        8  end               |  12  end
+    )");
+
+    REQUIRE(printed == expected);
+}
+
+TEST_CASE("Relations anchor alignment of lines with duplicated text",
+          "[alignment]")
+{
+    std::string printed = compareAndPrint(parseLua(R"(
+        function f()
+            return 1
+        end
+
+
+
+
+
+        function f()
+            return 1
+        end
+    )"), parseLua(R"(
+
+
+
+
+        function f()
+            return 1
+        end
+        function f()
+            return 1
+        end
+    )"));
+
+    std::string expected = normalizeText(R"(
+        ~~~~~~~~~~~~~~~~~~!~~~~~~~~~~~~~~~~~~
+        ~~~~~~~~~~~~~~~~~~!~~~~~~~~~~~~~~~~~~
+         1               |   1
+         -               {+++}   2
+         -               {+++}   3
+         -               {+++}   4
+         -               {+++}   5
+         2  function f() |   6  function f()
+         3      return 1 |   7      return 1
+         4  end          |   8  end
+         5               {---}   -
+         6               {---}   -
+         7               {---}   -
+         8               {---}   -
+         9               {---}   -
+        10  function f() |   9  function f()
+        11      return 1 |  10      return 1
+        12  end          |  11  end
+    )");
+
+    REQUIRE(printed == expected);
+}
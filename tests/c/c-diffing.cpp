@@ -19,9 +19,12 @@
 #include "Catch/catch.hpp"
 
 #include <functional>
+#include <sstream>
+#include <string>
 
 #include "c/C11SType.hpp"
 #include "utils/time.hpp"
+#include "Printer.hpp"
 #include "compare.hpp"
 #include "tree.hpp"
 
@@ -2060,3 +2063,35 @@ TEST_CASE("Condition update", "[comparison]")
         }
     )", false);
 }
+
+TEST_CASE("Parallel comparison yields the same result", "[comparison]")
+{
+    const std::string left = R"(
+        int f(int a) { return a + 1; }
+        int g(int b) { if (b) { return 2; } return 3; }
+        void h(void) { call(1, 2, 3); other(); }
+        struct s { int field; char *name; };
+    )";
+    const std::string right = R"(
+        int f(int a) { return a + 2; }
+        void h(void) { call(1, 2); other(); more(); }
+        int g(int c) { if (c) { return 2; } return 4; }
+        struct s { int field; const char *name; };
+    )";
+
+    auto diff = [&](int jobs) {
+        Tree oldTree = parseC(left, true);
+        Tree newTree = parseC(right, true);
+
+        TimeReport tr;
+        compare(oldTree, newTree, tr, true, false, jobs);
+
+        std::ostringstream oss;
+        Printer printer(*oldTree.getRoot(), *newTree.getRoot(),
+                        *oldTree.getLanguage(), oss);
+        printer.print(tr);
+        return oss.str();
+    };
+
+    CHECK(diff(4) == diff(1));
+}
@@ -574,8 +574,8 @@ TEST_CASE("Tabulation of size 1 is allowed", "[parser]")
     TreeBuilder tb = lang->parse(str, "<input>", tabWidth, /*debug=*/false, mr);
     REQUIRE_FALSE(tb.hasFailed());
 
-    STree stree(std::move(tb), str, false, false, *lang, mr);
-    Tree tree(std::move(lang), tabWidth, str, stree.getRoot());
+    STree stree(std::move(tb), str, false, false, *lang);
+    Tree tree(std::move(lang), tabWidth, str, stree);
 
     const Node *node;
 
@@ -16,7 +16,11 @@
 
 #include "Catch/catch.hpp"
 
+#include <utility>
+#include <vector>
+
 #include "utils/time.hpp"
+#include "change-distilling.hpp"
 #include "compare.hpp"
 #include "tree.hpp"
 
@@ -46,3 +50,43 @@ TEST_CASE("Distilling links matched nodes", "[change-distiller]")
     CHECK(findNode(oldTree, test, true) == nullptr);
     CHECK(findNode(newTree, test, true) == nullptr);
 }
+
+TEST_CASE("Indexed terminal matching is equivalent to brute force",
+          "[change-distiller]")
+{
+    const std::string left = R"(
+        int main(int argc, char *argv[]) {
+            /* comment */
+            const int value = compute(argc, 10);
+            printf("%d: %s\n", value, argv[0]);
+            return value > 0 ? 0 : 1;
+        }
+    )";
+    const std::string right = R"(
+        int main(int argc, char *argv[]) {
+            /* another comment */
+            const long value = compute(argc + 1, 20);
+            printf("%ld: %s\n", value, argv[1]);
+            return value > 10 ? 0 : 2;
+        }
+    )";
+
+    auto distill = [&](bool bruteForce) {
+        Tree oldTree = parseC(left);
+        Tree newTree = parseC(right);
+
+        Distiller distiller(*oldTree.getLanguage());
+        distiller.setBruteForce(bruteForce);
+        distiller.distill(*oldTree.getRoot(), *newTree.getRoot());
+
+        std::vector<std::pair<State, int>> result;
+        for (Node *node : postOrder(*oldTree.getRoot())) {
+            const Node *relative = node->relative;
+            result.emplace_back(State{node->state},
+                                relative == nullptr ? -1 : relative->poID);
+        }
+        return result;
+    };
+
+    CHECK(distill(false) == distill(true));
+}
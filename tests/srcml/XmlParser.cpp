@@ -0,0 +1,139 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "Catch/catch.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "srcml/XmlParser.hpp"
+
+namespace {
+
+// Records events as a string.
+class Recorder : public XmlHandler
+{
+public:
+    std::string events;
+
+private:
+    virtual void startElement(boost::string_ref name,
+                              const XmlAttrs &attrs) override
+    {
+        events += '<' + name.to_string();
+        for (const auto &attr : attrs) {
+            events += ' ' + attr.first + '=' + attr.second;
+        }
+        events += '>';
+    }
+
+    virtual void endElement(boost::string_ref name) override
+    { events += "</" + name.to_string() + '>'; }
+
+    virtual void text(boost::string_ref text) override
+    { events += '[' + text.to_string() + ']'; }
+};
+
+}
+
+static std::string parse(const std::string &xml, std::size_t chunkSize);
+
+TEST_CASE("XmlParser reports elements and text", "[srcml][xml]")
+{
+    const std::string xml =
+        "<?xml version=\"1.0\"?>\n"
+        "<unit a=\"x &amp; y\" b='1'>\n"
+        "  <!-- comment -->\n"
+        "  <name>a &lt;b&gt;</name> <empty/>\r\n"
+        "  <c>  x\r\ny </c><![CDATA[<&amp;>]]>\n"
+        "</unit>\n";
+    const std::string expected =
+        "<unit a=x & y b=1><name>[a <b>]</name><empty></empty>"
+        "<c>[  x\ny ]</c>[<&amp;>]</unit>";
+
+    REQUIRE(parse(xml, xml.size()) == expected);
+    REQUIRE(parse(xml, 1U) == expected);
+    REQUIRE(parse(xml, 7U) == expected);
+}
+
+TEST_CASE("XmlParser decodes character references", "[srcml][xml]")
+{
+    REQUIRE(parse("<a>&#65;&#x42;&#x416;&bad;</a>", 3U) ==
+            "<a>[AB\xD0\x96&bad;]</a>");
+}
+
+TEST_CASE("XmlParser reports offsets of tokens", "[srcml][xml]")
+{
+    struct Handler : XmlHandler
+    {
+        XmlParser *parser;
+        std::size_t start = 0U, end = 0U;
+
+        virtual void startElement(boost::string_ref name,
+                                  const XmlAttrs &/*attrs*/) override
+        {
+            if (name == "b") {
+                start = parser->getTokenStart();
+            }
+        }
+        virtual void endElement(boost::string_ref name) override
+        {
+            if (name == "b") {
+                end = parser->getTokenEnd();
+            }
+        }
+        virtual void text(boost::string_ref /*text*/) override
+        { }
+    } handler;
+
+    const std::string xml = "<a> <b x='>'>text</b> </a>";
+
+    XmlParser parser(handler);
+    handler.parser = &parser;
+    for (char c : xml) {
+        parser.feed(std::string(1U, c));
+    }
+    parser.finish();
+
+    REQUIRE(xml.substr(handler.start, handler.end - handler.start) ==
+            "<b x='>'>text</b>");
+}
+
+TEST_CASE("XmlParser rejects malformed input", "[srcml][xml]")
+{
+    REQUIRE_THROWS_AS(parse("", 1U), std::runtime_error);
+    REQUIRE_THROWS_AS(parse("  \n", 1U), std::runtime_error);
+    REQUIRE_THROWS_AS(parse("<a><b></a>", 1U), std::runtime_error);
+    REQUIRE_THROWS_AS(parse("<a>", 1U), std::runtime_error);
+    REQUIRE_THROWS_AS(parse("<a x=1></a>", 1U), std::runtime_error);
+    REQUIRE_THROWS_AS(parse("<a><!-- </a>", 1U), std::runtime_error);
+}
+
+// Parses XML fed in chunks of specified size and returns recorded events.
+static std::string
+parse(const std::string &xml, std::size_t chunkSize)
+{
+    Recorder recorder;
+    XmlParser parser(recorder);
+    for (std::size_t i = 0U; i < xml.size(); i += chunkSize) {
+        parser.feed(boost::string_ref(xml).substr(i, chunkSize));
+    }
+    parser.finish();
+    return recorder.events;
+}
@@ -156,8 +156,8 @@ parse(const std::string &fileName, const std::string &str, bool coarse)
         return Tree(std::move(lang), tabWidth, str, tb.getRoot());
     }
 
-    STree stree(std::move(tb), str, false, false, *lang, mr);
-    return Tree(std::move(lang), tabWidth, str, stree.getRoot());
+    STree stree(std::move(tb), str, false, false, *lang);
+    return Tree(std::move(lang), tabWidth, str, stree);
 }
 
 const Node *
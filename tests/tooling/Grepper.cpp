@@ -95,3 +95,57 @@ TEST_CASE("Grep starts each processing with clear match", "[tooling][grepper]")
     CHECK(nMatches == 2);
     CHECK(nGreps == 0);
 }
+
+TEST_CASE("Grep retries overlapping prefixes", "[tooling][grepper]")
+{
+    auto grepHandler = [&](const std::vector<Node *> &match) {
+        REQUIRE(match.size() == 3U);
+        CHECK(match[0]->label == "b");
+        CHECK(match[2]->label == "c");
+    };
+
+    Tree tree = parseC("int a = b + b + c;", true);
+
+    Grepper grepper({ "b", "+", "c" });
+    CHECK(grepper.grep(tree.getRoot(), grepHandler));
+    CHECK(grepper.getMatched() == 1);
+}
+
+TEST_CASE("Grep matches multiple patterns in one pass", "[tooling][grepper]")
+{
+    Grepper grepper = Grepper::anyOf({ { "const", "//" },
+                                       { "void" },
+                                       { "/^cha/", ")" } });
+
+    std::vector<int> patterns;
+    auto grepHandler = [&](const std::vector<Node *> &/*match*/) {
+        patterns.push_back(grepper.getMatchedPattern());
+    };
+
+    Tree tree = parseC("void chars(const char *, const char);", true);
+
+    CHECK(grepper.grep(tree.getRoot(), grepHandler));
+    CHECK(grepper.getMatched() == 3);
+    CHECK(patterns == std::vector<int>({ 1, 0, 0 }));
+}
+
+TEST_CASE("Grep reports single pattern of those ending at the same token",
+          "[tooling][grepper]")
+{
+    Grepper grepper = Grepper::anyOf({ { "x" },
+                                       { "a", "+", "b" },
+                                       { "+", "b" },
+                                       { "b" } });
+
+    std::vector<int> patterns;
+    auto grepHandler = [&](const std::vector<Node *> &match) {
+        patterns.push_back(grepper.getMatchedPattern());
+        CHECK(match.size() == 3U);
+    };
+
+    Tree tree = parseLua("local y = a + b");
+
+    CHECK(grepper.grep(tree.getRoot(), grepHandler));
+    CHECK(grepper.getMatched() == 1);
+    CHECK(patterns == std::vector<int>({ 1 }));
+}
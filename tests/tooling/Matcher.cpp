@@ -255,3 +255,50 @@ TEST_CASE("Function matcher works", "[tooling][matcher][.srcml]")
         CHECK(nMatches == 2);
     }
 }
+
+TEST_CASE("Nested matchers report each node once", "[tooling][matcher]")
+{
+    Matcher callMatcher(MType::Call, nullptr);
+    Matcher blockMatcher(MType::Block, &callMatcher);
+
+    std::vector<std::string> matches;
+
+    auto matchHandler = [&](Node *node) {
+        matches.push_back(printSubTree(*node, false));
+    };
+
+    Tree tree = parseLua("do do f(g()) end end "
+                         "do do end end");
+    CHECK(blockMatcher.match(tree.getRoot(), *tree.getLanguage(),
+                             matchHandler));
+    CHECK(matches == std::vector<std::string>({ "f(g())", "g()" }));
+
+    CHECK(blockMatcher.getSeen() == 4);
+    CHECK(blockMatcher.getMatched() == 2);
+    CHECK(callMatcher.getSeen() == 2);
+    CHECK(callMatcher.getMatched() == 2);
+}
+
+TEST_CASE("Matching skips subtrees that can't match", "[tooling][matcher]")
+{
+    Matcher paramMatcher(MType::Parameter, nullptr);
+    Matcher funcMatcher(MType::Function, &paramMatcher);
+
+    int nMatches = 0;
+
+    auto matchHandler = [&](Node */*node*/) {
+        ++nMatches;
+    };
+
+    Tree tree = parseLua("function f(a) function g(b, c) end end "
+                         "function h() end");
+    CHECK(funcMatcher.match(tree.getRoot(), *tree.getLanguage(),
+                            matchHandler));
+    CHECK(nMatches == 3);
+
+    // Functions don't nest, so `g` isn't considered.
+    CHECK(funcMatcher.getSeen() == 2);
+    CHECK(funcMatcher.getMatched() == 1);
+    CHECK(paramMatcher.getSeen() == 3);
+    CHECK(paramMatcher.getMatched() == 3);
+}
@@ -18,6 +18,9 @@
 
 #include <boost/filesystem/operations.hpp>
 
+#include <string>
+#include <vector>
+
 #include "tooling/Traverser.hpp"
 #include "tooling/common.hpp"
 
@@ -67,3 +70,60 @@ TEST_CASE("Traverser accounts for lang attribute", "[tooling][traverser]")
 
     CHECK(paths.size() == 1);
 }
+
+TEST_CASE("Traverser finishes files in order of discovery",
+          "[tooling][traverser]")
+{
+    TempDir tempDir("traverser");
+    for (int i = 0; i < 50; ++i) {
+        makeFile(tempDir.str() + "/test" + std::to_string(i) + ".c", { });
+    }
+
+    auto search = [&](int jobs) {
+        std::vector<std::string> paths;
+        auto prepare = [&](const std::string &path, TimeReport &/*tr*/) {
+            std::string prepared = path;
+            return [&paths, prepared](const std::string &path) {
+                paths.push_back(path);
+                return (prepared == path);
+            };
+        };
+
+        Environment env;
+        CHECK(Traverser({ tempDir.str() }, "", env.getConfig(),
+                        env.getTimeKeeper(), jobs, prepare).search());
+        return paths;
+    };
+
+    std::vector<std::string> sequential = search(1);
+    CHECK(sequential.size() == 50);
+    CHECK(search(3) == sequential);
+}
+
+TEST_CASE("Traverser keeps order of prefetched files", "[tooling][traverser]")
+{
+    TempDir tempDir("traverser");
+    for (int i = 0; i < 50; ++i) {
+        const char *ext = (i%3 == 0 ? ".c" : ".cpp");
+        makeFile(tempDir.str() + "/test" + std::to_string(i) + ext, { });
+    }
+
+    auto search = [&](int jobs) {
+        std::vector<std::string> paths;
+        auto prepare = [&](const std::string &/*path*/, TimeReport &/*tr*/) {
+            return [&paths](const std::string &path) {
+                paths.push_back(path);
+                return true;
+            };
+        };
+
+        Environment env;
+        CHECK(Traverser({ tempDir.str() }, "", env.getConfig(),
+                        env.getTimeKeeper(), jobs, prepare).search());
+        return paths;
+    };
+
+    std::vector<std::string> sequential = search(1);
+    CHECK(sequential.size() == 50);
+    CHECK(search(4) == sequential);
+}
@@ -16,6 +16,9 @@
 
 #include "Catch/catch.hpp"
 
+#include <string>
+#include <vector>
+
 #include "tree-edit-distance.hpp"
 #include "tree.hpp"
 
@@ -128,3 +131,79 @@ TEST_CASE("All postponed nodes are pulled into parents", "[ted][postponed]")
     CHECK(findNode(newTree, Type::Comments, "// Comment 2.")->state
           == State::Inserted);
 }
+
+TEST_CASE("Width of cost cells doesn't affect results", "[ted]")
+{
+    const std::string oldCode = R"(
+        local function f(a, b)
+            if a then
+                return b + 1
+            end
+            return a
+        end
+        print(f(1, 2))
+    )";
+    const std::string newCode = R"(
+        local function f(a, c)
+            if not a then
+                return c * 2
+            end
+            g(a)
+            return a
+        end
+    )";
+
+    Tree oldNarrow = parseLua(oldCode), newNarrow = parseLua(newCode);
+    Tree oldWide = parseLua(oldCode), newWide = parseLua(newCode);
+
+    // Fine-grained representation of the function.
+    auto func = [](Tree &tree) -> Node & {
+        return *tree.getRoot()->children[0]->next;
+    };
+
+    const int narrow = ted(func(oldNarrow), func(newNarrow), false);
+    const int wide = ted(func(oldWide), func(newWide), true);
+    CHECK(narrow > 0);
+    CHECK(narrow == wide);
+
+    auto check = [](Node &narrowRoot, Node &wideRoot) {
+        std::vector<Node *> narrowNodes = postOrder(narrowRoot);
+        std::vector<Node *> wideNodes = postOrder(wideRoot);
+        REQUIRE(narrowNodes.size() == wideNodes.size());
+        for (std::size_t i = 0U; i < narrowNodes.size(); ++i) {
+            CHECK(narrowNodes[i]->state == wideNodes[i]->state);
+            CHECK((narrowNodes[i]->relative == nullptr) ==
+                  (wideNodes[i]->relative == nullptr));
+        }
+    };
+    check(func(oldNarrow), func(oldWide));
+    check(func(newNarrow), func(newWide));
+}
+
+TEST_CASE("Too large trees are refused", "[ted]")
+{
+    auto makeCode = [](int statements) {
+        std::string code = "local function f()\n";
+        for (int i = 0; i < statements; ++i) {
+            code += "    x = x + " + std::to_string(i) + "\n";
+        }
+        return code + "end\n";
+    };
+
+    Tree smallTree = parseLua(makeCode(10));
+    Tree oldTree = parseLua(makeCode(3000));
+    Tree newTree = parseLua(makeCode(3001));
+
+    // Fine-grained representation of the function.
+    auto func = [](Tree &tree) -> Node & {
+        return *tree.getRoot()->children[0]->next;
+    };
+
+    CHECK(canTed(func(smallTree), func(oldTree)));
+    CHECK(!canTed(func(oldTree), func(newTree)));
+
+    CHECK(ted(func(oldTree), func(newTree)) == -1);
+    CHECK(countLeaves(*oldTree.getRoot(), State::Unchanged) > 0);
+    CHECK(countLeaves(*oldTree.getRoot(), State::Deleted) == 0);
+    CHECK(countLeaves(*newTree.getRoot(), State::Inserted) == 0);
+}
@@ -18,7 +18,13 @@
 
 #include <boost/algorithm/string/replace.hpp>
 
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
 #include "c/C11SType.hpp"
+#include "Language.hpp"
 #include "STree.hpp"
 #include "tree.hpp"
 
@@ -87,8 +93,8 @@ TEST_CASE("Tabulation size in comments is variable", "[tree]")
     TreeBuilder tb = lang->parse(str, "<input>", tabWidth, /*debug=*/false, mr);
     REQUIRE_FALSE(tb.hasFailed());
 
-    STree stree(std::move(tb), str, false, false, *lang, mr);
-    Tree tree(std::move(lang), tabWidth, str, stree.getRoot());
+    STree stree(std::move(tb), str, false, false, *lang);
+    Tree tree(std::move(lang), tabWidth, str, stree);
 
     const Node *node = findNode(tree,
                                 [&](const Node *node) {
@@ -104,3 +110,89 @@ TEST_CASE("Tabulation size in comments is variable", "[tree]")
     REQUIRE(node != nullptr);
     CHECK(node->spelling == expanded);
 }
+
+TEST_CASE("Fingerprints summarize subtrees", "[tree]")
+{
+    Tree oldTree = parseC(R"(
+        int main(int argc, char *argv[]) {
+            /* comment */
+            return 0;
+        }
+    )", true);
+
+    Tree newTree = parseC(R"(
+        int main(int argc, char *argv[]) {
+            /* another comment */
+            return 0;
+        }
+    )", true);
+
+    const Node &oldRoot = *oldTree.getRoot();
+    const Node &newRoot = *newTree.getRoot();
+    const Fingerprint &oldFp = oldRoot.fingerprint;
+    const Fingerprint &newFp = newRoot.fingerprint;
+
+    CHECK(oldFp.textLength == static_cast<int>(printSubTree(oldRoot,
+                                                            true).size()));
+    CHECK(oldFp.codeLength == static_cast<int>(printSubTree(oldRoot,
+                                                            false).size()));
+    CHECK(oldFp.textLength > oldFp.codeLength);
+
+    CHECK(oldFp.code == newFp.code);
+    CHECK(oldFp.codeLength == newFp.codeLength);
+    CHECK(oldFp.text != newFp.text);
+    CHECK(oldFp.structure != newFp.structure);
+}
+
+TEST_CASE("Serialized tree can be restored", "[tree]")
+{
+    Tree tree = parseC(R"(
+        int main(int argc, char *argv[]) {
+            /* comment */
+            return 0;
+        }
+    )", true);
+
+    std::string data = tree.serialize();
+
+    std::unique_ptr<Language> lang = Language::create("file.c");
+    Tree restored = Tree::deserialize(lang, data);
+    CHECK(lang == nullptr);
+
+    std::ostringstream original, copy;
+    dumpTree(original, tree.getRoot(), tree.getLanguage());
+    dumpTree(copy, restored.getRoot(), restored.getLanguage());
+    CHECK(copy.str() == original.str());
+
+    const Fingerprint &fp = tree.getRoot()->fingerprint;
+    const Fingerprint &restoredFp = restored.getRoot()->fingerprint;
+    CHECK(restoredFp.structure == fp.structure);
+    CHECK(restoredFp.text == fp.text);
+    CHECK(restoredFp.size == fp.size);
+
+    lang = Language::create("file.c");
+    data.pop_back();
+    REQUIRE_THROWS_AS(Tree::deserialize(lang, data), std::runtime_error);
+    CHECK(lang != nullptr);
+}
+
+TEST_CASE("Serialized tree with invalid enumerations is rejected", "[tree]")
+{
+    Tree tree = parseLua("local x = 1");
+    const std::string data = tree.serialize();
+
+    std::unique_ptr<Language> lang = Language::create("file.lua");
+    Tree restored = Tree::deserialize(lang, data);
+    CHECK(lang == nullptr);
+
+    // Root is the last node, its type, stype and state are followed by flags
+    // and id of the root.
+    for (std::size_t offset : { 8U, 7U, 6U }) {
+        std::string corrupted = data;
+        corrupted[corrupted.size() - offset] = '\xff';
+
+        lang = Language::create("file.lua");
+        REQUIRE_THROWS_AS(Tree::deserialize(lang, corrupted),
+                          std::runtime_error);
+    }
+}
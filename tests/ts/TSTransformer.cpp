@@ -0,0 +1,102 @@
+// Copyright (C) 2026 xaizek <xaizek@posteo.net>
+//
+// This file is part of zograscope.
+//
+// zograscope is free software: you can redistribute it and/or modify
+// it under the terms of version 3 of the GNU Affero General Public License as
+// published by the Free Software Foundation.
+//
+// zograscope is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "Catch/catch.hpp"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pmr/monolithic.hpp"
+
+#include "ts/bash/TSBashLanguage.hpp"
+#include "ts/lua/TSLuaLanguage.hpp"
+#include "ts/TSTransformer.hpp"
+#include "TreeBuilder.hpp"
+#include "tree.hpp"
+
+// Dumps tree built by a language into a string.
+template <typename L>
+static std::string
+dump(const std::string &contents, TreeBuilder &&tb,
+     cpp17::pmr::monolithic &mr)
+{
+    Tree tree(std::unique_ptr<Language>(new L()), 4, contents, tb.getRoot(),
+              &mr);
+    std::ostringstream oss;
+    dumpTree(oss, tree.getRoot(), tree.getLanguage());
+    return oss.str();
+}
+
+TEST_CASE("Lua is reparsed after edits", "[ts][ts-lua]")
+{
+    cpp17::pmr::monolithic mr;
+    TsLuaLanguage lang;
+    TSParseTree prev;
+
+    const std::string v1 = "local a = 1\nreturn a\n";
+    const std::string v2 = "local abc = 1\n\nreturn a + 2\n";
+
+    lang.reparse(v1, prev, {}, 4, false, mr);
+    REQUIRE(!prev.empty());
+
+    std::vector<TSTextEdit> edits = {
+        { 6U, 7U, "abc" },
+        { 14U, 14U, "\n" },
+        { 23U, 23U, " + 2" },
+    };
+    std::string reparsed = dump<TsLuaLanguage>(v2,
+                                               lang.reparse(v2, prev, edits, 4,
+                                                            false, mr),
+                                               mr);
+    std::string parsed = dump<TsLuaLanguage>(v2,
+                                             lang.parse(v2, "", 4, false, mr),
+                                             mr);
+    REQUIRE(reparsed == parsed);
+}
+
+TEST_CASE("Bash is parsed from scratch on mismatching edits", "[ts][ts-bash]")
+{
+    cpp17::pmr::monolithic mr;
+    TsBashLanguage lang;
+    TSParseTree prev;
+
+    const std::string v1 = "echo a\n";
+    const std::string v2 = "if true; then echo b; fi\n";
+
+    lang.reparse(v1, prev, {}, 4, false, mr);
+
+    std::vector<TSTextEdit> edits = { { 5U, 100U, "b" } };
+    std::string reparsed = dump<TsBashLanguage>(v2,
+                                                lang.reparse(v2, prev, edits, 4,
+                                                             false, mr),
+                                                mr);
+    std::string parsed = dump<TsBashLanguage>(v2,
+                                              lang.parse(v2, "", 4, false, mr),
+                                              mr);
+    REQUIRE(reparsed == parsed);
+
+    // The tree corresponds to new contents and can be used further.
+    const std::string v3 = "if false; then echo b; fi\n";
+    edits = { { 3U, 7U, "false" } };
+    reparsed = dump<TsBashLanguage>(v3,
+                                    lang.reparse(v3, prev, edits, 4, false, mr),
+                                    mr);
+    parsed = dump<TsBashLanguage>(v3, lang.parse(v3, "", 4, false, mr), mr);
+    REQUIRE(reparsed == parsed);
+}
@@ -16,10 +16,287 @@
 
 #include "Catch/catch.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "pmr/monolithic.hpp"
+
+#include "utils/Tracer.hpp"
+#include "utils/fs.hpp"
 #include "utils/strings.hpp"
+#include "utils/time.hpp"
 
 TEST_CASE("Different strings are recognized as different", "[utils][dice]")
 {
     DiceString diceB("abd");
     REQUIRE(DiceString("abc").compare(diceB) < 1.0f);
 }
+
+TEST_CASE("Dice coefficient is computed precisely", "[utils][dice]")
+{
+    cpp17::pmr::monolithic mr;
+
+    // Short and long strings of different size.
+    std::string shortStr = "abcd";
+    std::string longStr = "zzab";
+    for (char c = 'A'; c <= 'Z'; ++c) {
+        longStr += std::string(2, c);
+    }
+
+    // Long string with all possible bigrams.
+    std::string allBigrams;
+    for (int i = 0; i < 300; ++i) {
+        for (int j = 0; j < 300; ++j) {
+            allBigrams += static_cast<char>(i);
+            allBigrams += static_cast<char>(j);
+        }
+    }
+
+    DiceString shortDice(shortStr, &mr);
+    DiceString longDice(longStr, &mr);
+    DiceString allDice(allBigrams, &mr);
+
+    // 1 common bigram ("ab"), 3 and 55 unique bigrams.
+    CHECK(shortDice.compare(longDice) == Approx(2.0f/58));
+    CHECK(longDice.compare(shortDice) == Approx(2.0f/58));
+    // 65536 bigrams in total, all of the short string is there.
+    CHECK(shortDice.compare(allDice) == Approx(2.0f*3/(3 + 65536)));
+}
+
+TEST_CASE("Dice index finds all similar enough strings", "[utils][dice]")
+{
+    std::vector<std::string> strings = {
+        "int a = 10;", "int b = 10;", "return x;", "x", "",
+        "for (i = 0; i < n; ++i) { }", "for (j = 0; j < n; ++j) { }",
+        "void f(void) { return; }", "void g(void) { return 0; }", "y",
+    };
+
+    std::vector<DiceString> indexed(strings.cbegin(), strings.cend());
+    std::vector<DiceString> probes(strings.cbegin(), strings.cend());
+
+    for (float threshold : { 0.3f, 0.6f, 0.8f, 1.0f }) {
+        DiceIndex index(indexed, threshold);
+        for (DiceString &probe : probes) {
+            std::vector<int> candidates = index.lookup(probe);
+            for (int i = 0, n = indexed.size(); i < n; ++i) {
+                if (probe.compare(indexed[i]) >= threshold) {
+                    INFO(probe.str() << " ~ " << indexed[i].str());
+                    CHECK(std::binary_search(candidates.cbegin(),
+                                             candidates.cend(), i));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Dice index filters out dissimilar strings", "[utils][dice]")
+{
+    std::vector<std::string> strings = { "abcdefgh", "zyxwvuts", "abcdefgz" };
+    std::vector<DiceString> indexed(strings.cbegin(), strings.cend());
+    DiceIndex index(indexed, 0.8f);
+
+    DiceString probe("abcdefgh");
+    CHECK(index.lookup(probe) == std::vector<int>({ 0, 2 }));
+}
+
+TEST_CASE("Only DOS line endings are normalized", "[utils][eols]")
+{
+    CHECK(normalizeEols("a\r\nb\r\n") == "a\nb\n");
+    CHECK(normalizeEols("a\rb\r") == "a\rb\r");
+    CHECK(normalizeEols("\r\r\n\n") == "\r\n\n");
+}
+
+TEST_CASE("File contents doesn't depend on line endings", "[utils][eols]")
+{
+    TempFile unixFile("unix"), dosFile("dos");
+    {
+        std::ofstream(unixFile.str(), std::ios::binary) << "a\r\nb\n";
+        std::ofstream(dosFile.str(), std::ios::binary) << "a\r\r\nb\r\n";
+    }
+
+    FileContents unixContents(unixFile), dosContents(dosFile);
+    CHECK(unixContents.str() == "a\nb\n");
+    CHECK(dosContents.str() == "a\r\nb\n");
+    CHECK(readFile(dosFile) == dosContents.str());
+}
+
+TEST_CASE("Arena reuses its blocks after reset", "[utils][pmr]")
+{
+    // Counts allocations and keeps track of memory in use.
+    class Counter : public cpp17::pmr::memory_resource
+    {
+    public:
+        int allocations = 0;
+        std::size_t inUse = 0U;
+
+    private:
+        virtual void * do_allocate(std::size_t bytes,
+                                   std::size_t alignment) override
+        {
+            ++allocations;
+            inUse += bytes;
+            return cpp17::pmr::get_default_resource()->allocate(bytes,
+                                                                alignment);
+        }
+
+        virtual void do_deallocate(void *p, std::size_t bytes,
+                                   std::size_t alignment) override
+        {
+            inUse -= bytes;
+            cpp17::pmr::get_default_resource()->deallocate(p, bytes,
+                                                           alignment);
+        }
+
+        virtual bool do_is_equal(const memory_resource &other)
+            const noexcept override
+        {
+            return this == &other;
+        }
+    } counter;
+
+    {
+        cpp17::pmr::monolithic mr(&counter);
+        mr.allocate(100U*1024U);
+        mr.allocate(10U);
+        const int allocations = counter.allocations;
+        const std::size_t inUse = counter.inUse;
+
+        mr.reset();
+        mr.allocate(100U*1024U);
+        mr.allocate(10U);
+        CHECK(counter.allocations == allocations);
+        CHECK(counter.inUse == inUse);
+
+        // Only bookkeeping remains.
+        mr.reset(0U);
+        CHECK(counter.inUse < 1024U);
+    }
+
+    CHECK(counter.inUse == 0U);
+}
+
+TEST_CASE("Stage names are interned", "[utils][tracer]")
+{
+    const Tracer::StageId id = Tracer::intern("interned-stage");
+    CHECK(Tracer::intern("interned-stage") == id);
+    CHECK(Tracer::intern("other-stage") != id);
+    CHECK(Tracer::getName(id) == "interned-stage");
+}
+
+TEST_CASE("Profile accounts for nested stages", "[utils][tracer]")
+{
+    Tracer tracer;
+    {
+        TimeReport tr;
+        tr.setTracer(&tracer);
+
+        auto timer = tr.measure("outer");
+        tr.measure("inner");
+        tr.measure("inner");
+    }
+
+    std::ostringstream oss;
+    tracer.printProfile(oss);
+
+    const std::string profile = oss.str();
+    std::vector<boost::string_ref> lines = split(profile, '\n');
+    REQUIRE(lines.size() == 4U);
+    CHECK(std::count_if(lines.cbegin(), lines.cend(),
+                        [](boost::string_ref line) {
+                            return boost::ends_with(line, " 1  outer");
+                        }) == 1);
+    CHECK(std::count_if(lines.cbegin(), lines.cend(),
+                        [](boost::string_ref line) {
+                            return boost::ends_with(line, " 2  inner");
+                        }) == 1);
+}
+
+TEST_CASE("Subjects of stages are traced as arguments", "[utils][tracer]")
+{
+    Tracer tracer;
+    {
+        TimeReport tr;
+        tr.setTracer(&tracer);
+
+        tr.measure("parsing: a.c");
+        tr.measure("parsing: b.c");
+    }
+
+    std::ostringstream oss;
+    tracer.writeChromeTrace(oss);
+    const std::string trace = oss.str();
+    CHECK(trace.find("\"name\":\"parsing\"") != std::string::npos);
+    CHECK(trace.find("\"args\":{\"subject\":\"a.c\"}") != std::string::npos);
+    CHECK(trace.find("\"args\":{\"subject\":\"b.c\"}") != std::string::npos);
+    CHECK(trace.find("parsing: ") == std::string::npos);
+
+    oss.str({});
+    tracer.printProfile(oss);
+    const std::string profile = oss.str();
+    CHECK(boost::ends_with(profile, " 2  parsing\n"));
+}
+
+TEST_CASE("Control characters of subjects are escaped", "[utils][tracer]")
+{
+    Tracer tracer;
+    {
+        TimeReport tr;
+        tr.setTracer(&tracer);
+
+        tr.measure("parsing: a\rb\x1f\n\"c\"");
+    }
+
+    std::ostringstream oss;
+    tracer.writeChromeTrace(oss);
+    const std::string trace = oss.str();
+    CHECK(trace.find("\"subject\":\"a\\u000db\\u001f\\n\\\"c\\\"\"")
+          != std::string::npos);
+}
+
+TEST_CASE("Trace of each thread is balanced", "[utils][tracer]")
+{
+    Tracer tracer;
+    const Tracer::StageId outer = Tracer::intern("outer");
+    const Tracer::StageId inner = Tracer::intern("inner");
+
+    auto work = [&tracer, outer, inner](int n) {
+        tracer.begin(outer);
+        for (int i = 0; i < n; ++i) {
+            tracer.begin(inner);
+            tracer.end(inner);
+        }
+        tracer.end(outer);
+    };
+
+    // The first thread overwrites beginning of the outer stage and of the
+    // first inner one.
+    std::thread thread(work, Tracer::bufferCapacity/2U);
+    thread.join();
+    work(0);
+
+    std::ostringstream oss;
+    tracer.writeChromeTrace(oss);
+    const std::string trace = oss.str();
+
+    auto count = [&trace](const std::string &what) {
+        int n = 0;
+        for (std::size_t pos = trace.find(what);
+             pos != std::string::npos;
+             pos = trace.find(what, pos + 1U)) {
+            ++n;
+        }
+        return n;
+    };
+
+    const int nBegins = count("\"ph\":\"B\"");
+    CHECK(nBegins == Tracer::bufferCapacity/2U);
+    CHECK(count("\"ph\":\"E\"") == nBegins);
+    CHECK(count("\"tid\":1}") == 2*(nBegins - 1));
+    CHECK(count("\"tid\":2}") == 2);
+}
@@ -8,6 +8,8 @@
 #ifndef PMR_MONOLITHIC_HPP_
 #define PMR_MONOLITHIC_HPP_
 
+#include <limits>
+
 #include "pmr_vector.hpp"
 #include "polymorphic_allocator.hpp"
 
@@ -28,6 +30,11 @@ public:
     explicit monolithic(memory_resource *parent = get_default_resource());
     virtual ~monolithic() override;
 
+    // Makes all memory available for new allocations, which invalidates
+    // everything allocated so far.  Blocks are kept for reuse as long as their
+    // total size doesn't exceed the limit, the rest is returned to parent.
+    void reset(size_t maxRetained = numeric_limits<size_t>::max());
+
 protected:
     virtual void * do_allocate(size_t bytes, size_t alignment) override;
     virtual void do_deallocate(void *p, size_t bytes,
@@ -46,7 +53,8 @@ private:
     };
 
     memory_resource *parent;
-    vector<Block> blocks;
+    vector<Block> blocks; // Blocks in use followed by free ones.
+    size_t used = 0U;     // Number of blocks in use.
 };
 
 inline byte *
@@ -80,19 +88,45 @@ monolithic::~monolithic()
     }
 }
 
+inline void
+monolithic::reset(size_t maxRetained)
+{
+    size_t retained = 0U;
+    size_t kept = 0U;
+    for (Block &block : blocks) {
+        if (block.size <= maxRetained - retained) {
+            retained += block.size;
+            block.next = block.start;
+            blocks[kept++] = block;
+        } else {
+            parent->deallocate(block.start, block.size, alignment);
+        }
+    }
+    blocks.erase(blocks.begin() + kept, blocks.end());
+    used = 0U;
+}
+
 inline void *
 monolithic::do_allocate(size_t bytes, size_t align)
 {
     void *ret;
-    if (blocks.empty() || !(ret = blocks.back().allocate(bytes, align))) {
-        const size_t size = max(static_cast<std::size_t>(blockSize), bytes);
+    if (used != 0U && (ret = blocks[used - 1U].allocate(bytes, align))) {
+        return ret;
+    }
 
-        byte *r = static_cast<byte *>(parent->allocate(size, alignment));
-        blocks.push_back(Block{size, r, r});
-        ret = blocks.back().allocate(bytes, align);
+    // Reuse a free block if it's large enough.
+    for (size_t i = used; i < blocks.size(); ++i) {
+        if ((ret = blocks[i].allocate(bytes, align))) {
+            swap(blocks[i], blocks[used++]);
+            return ret;
+        }
     }
 
-    return ret;
+    const size_t size = max(static_cast<std::size_t>(blockSize), bytes);
+
+    byte *r = static_cast<byte *>(parent->allocate(size, alignment));
+    blocks.insert(blocks.begin() + used, Block{size, r, r});
+    return blocks[used++].allocate(bytes, align);
 }
 
 inline void
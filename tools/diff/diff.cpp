@@ -44,8 +44,10 @@ struct Args : CommonArgs
     bool gitDiff;       // Invoked by git and file was changed.
     bool gitRename;     // File was renamed and possibly changed too.
     bool gitRenameOnly; // File was renamed without changing it.
+    bool stream;        // Print lines as soon as they are formatted.
 };
 
+static boost::program_options::options_description getLocalOpts();
 static Args parseLocalArgs(const Environment &env);
 static int run(Environment &env, const Args &args);
 static int gitFallback(const Args &args);
@@ -57,7 +59,7 @@ main(int argc, char *argv[])
     int result;
 
     try {
-        Environment env;
+        Environment env(getLocalOpts());
         env.setup({ argv + 1, argv + argc });
 
         args = parseLocalArgs(env);
@@ -91,12 +93,28 @@ main(int argc, char *argv[])
     return result;
 }
 
+// Retrieves description of options specific to this tool.
+static boost::program_options::options_description
+getLocalOpts()
+{
+    boost::program_options::options_description options;
+    options.add_options()
+        ("stream", "print lines as soon as they are formatted");
+
+    return options;
+}
+
+// Parses options specific to the tool.
 static Args
 parseLocalArgs(const Environment &env)
 {
     Args args;
     static_cast<CommonArgs &>(args) = env.getCommonArgs();
 
+    const boost::program_options::variables_map &varMap = env.getVarMap();
+
+    args.stream = varMap.count("stream");
+
     args.gitDiff = args.pos.size() == 7U
                 || (args.pos.size() == 9U && args.pos[2] != args.pos[5]);
     args.gitRename = (args.pos.size() == 9U);
@@ -167,7 +185,7 @@ run(Environment &env, const Args &args)
         return EXIT_SUCCESS;
     }
 
-    compare(treeA, treeB, tr, !args.fine, /*skipRefine=*/false);
+    compare(treeA, treeB, tr, !args.fine, /*skipRefine=*/false, args.jobs);
 
     dumpTrees(args, treeA, treeB);
 
@@ -179,6 +197,7 @@ run(Environment &env, const Args &args)
     } else {
         printer.addHeader({ oldFile, newFile });
     }
+    printer.setStreaming(args.stream);
     printer.print(tr);
 
     return EXIT_SUCCESS;
@@ -194,14 +213,9 @@ gitFallback(const Args &args)
 
     std::cout << "Parsing has failed, falling back to `git diff`\n";
 
-    // Print only a header by passing in an empty tree.
-    Node n;
-    std::unique_ptr<Language> l = Language::create(args.pos[0]);
-    Printer printer(n, n, *l, std::cout);
-    printer.addHeader({ args.pos[3], args.pos[6] });
-    printer.addHeader({ "a/" + args.pos[0], "b/" + args.pos[0] });
-    TimeReport tr;
-    printer.print(tr);
+    Printer::printHeaders({ { args.pos[3], args.pos[6] },
+                            { "a/" + args.pos[0], "b/" + args.pos[0] } },
+                          std::cout);
 
     std::cout.flush();
 
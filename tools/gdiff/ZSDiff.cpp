@@ -25,6 +25,7 @@
 #include <QTextBrowser>
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -154,7 +155,8 @@ private:
 Q_DECLARE_METATYPE(TokenInfo *)
 
 ZSDiff::SideInfo
-ZSDiff::printTree(Tree &tree, CodeView *textEdit, bool original)
+ZSDiff::printTree(Tree &tree, CodeView *textEdit, bool original,
+                  std::shared_ptr<SpellingDiffs> spellingDiffs)
 {
     std::vector<StablePos> stopPositions;
 
@@ -162,6 +164,7 @@ ZSDiff::printTree(Tree &tree, CodeView *textEdit, bool original)
     Highlighter highlighter(tree, original);
     highlighter.setPrintBrackets(false);
     highlighter.setTransparentDiffables(false);
+    highlighter.setSpellingDiffs(std::move(spellingDiffs));
 
     std::vector<ColorCane> hi = highlighter.print().splitIntoLines();
 
@@ -340,11 +343,13 @@ ZSDiff::loadDiff(const DiffEntry &diffEntry)
     QTextDocument *oldDoc = ui->oldCode->document();
     QTextDocument *newDoc = ui->newCode->document();
 
+    auto spellingDiffs = std::make_shared<SpellingDiffs>();
     SideInfo leftSide = (timeReport.measure("left-print"),
-                         printTree(oldTree, ui->oldCode, true));
+                         printTree(oldTree, ui->oldCode, true, spellingDiffs));
     oldMap = std::move(leftSide.map);
     SideInfo rightSide = (timeReport.measure("right-print"),
-                          printTree(newTree, ui->newCode, false));
+                          printTree(newTree, ui->newCode, false,
+                                    spellingDiffs));
     newMap = std::move(rightSide.map);
 
     oldDoc->documentLayout()->registerHandler(blankLineAttr.getType(),
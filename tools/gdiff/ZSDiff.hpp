@@ -42,6 +42,7 @@ class QPlainTextEdit;
 
 class Environment;
 class Node;
+class SpellingDiffs;
 class TimeReport;
 class SynHi;
 
@@ -77,7 +78,8 @@ public:
 private:
     void loadDiff(const DiffEntry &diffEntry);
     void updateTitle();
-    SideInfo printTree(Tree &tree, CodeView *textEdit, bool original);
+    SideInfo printTree(Tree &tree, CodeView *textEdit, bool original,
+                       std::shared_ptr<SpellingDiffs> spellingDiffs);
     void diffAndPrint(TimeReport &tr);
     void highlightMatch(QPlainTextEdit *textEdit);
     void syncOtherCursor(QPlainTextEdit *textEdit);
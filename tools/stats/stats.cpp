@@ -15,21 +15,24 @@
 // along with zograscope.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/utility/string_ref.hpp>
-#include <boost/optional.hpp>
 
 #include <algorithm>
 #include <functional>
 #include <memory>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
 
 #include "pmr/monolithic.hpp"
 #include "tooling/FunctionAnalyzer.hpp"
 #include "tooling/Traverser.hpp"
 #include "tooling/common.hpp"
+#include "utils/ArenaPool.hpp"
 #include "utils/nums.hpp"
-#include "utils/optional.hpp"
 #include "utils/strings.hpp"
+#include "utils/time.hpp"
 #include "ColorScheme.hpp"
 #include "NodeRange.hpp"
 #include "TermHighlighter.hpp"
@@ -117,10 +120,14 @@ private:
     const Language &lang;
 };
 
+// Keeps sample of integers as a histogram of their values.  Takes memory
+// proportional to the number of distinct values, yet results are exact and
+// aggregators can be merged.
 class StatsAggregator
 {
 public:
     void aggregate(int value);
+    void merge(const StatsAggregator &other);
 
     bool isEmpty() const;
 
@@ -128,13 +135,28 @@ public:
     int getMin() const;
     int getMax() const;
     int getMedian() const;
+    // Computes percentile using nearest-rank method.
+    int getPercentile(int percent) const;
+
+private:
+    // Retrieves value at zero-based position within sorted sample.
+    int getNth(int n) const;
 
 private:
     int sampleSize = 0;
-    int min = 0;
-    int max = 0;
-    mutable std::vector<int> data;
-    mutable bool sorted;
+    std::map<int, int> histogram; // Value -> number of its occurrences.
+};
+
+// Statistics about a set of files, which can be collected in parallel and
+// merged afterwards.
+struct FileStats
+{
+    void merge(const FileStats &other);
+
+    int blank = 0, code = 0, comment = 0, structural = 0;
+
+    StatsAggregator funcSizes;
+    StatsAggregator paramCounts;
 };
 
 class FileProcessor
@@ -143,9 +165,16 @@ public:
     FileProcessor(Environment &env, const Args &args);
 
 public:
-    bool operator()(const std::string &path);
+    std::function<bool(const std::string &path)>
+    operator()(const std::string &path, TimeReport &tr);
     void printReport() const;
 
+private:
+    void analyze(Tree &tree, std::vector<LineContent> &map,
+                 FileStats &stats) const;
+    bool process(const std::string &path, Tree &tree,
+                 const std::vector<LineContent> &map, const FileStats &stats);
+
 private:
     Environment &env;
     const Args &args;
@@ -158,10 +187,10 @@ private:
     decor::Decoration codeHi;
     decor::Decoration structuralHi;
 
-    int files = 0, blank = 0, code = 0, comment = 0, structural = 0;
+    int files = 0;
+    FileStats totals;
 
-    StatsAggregator funcSizes;
-    StatsAggregator paramCounts;
+    ArenaPool arenas;
 };
 
 }
@@ -219,17 +248,17 @@ LineAnalyzer::updateMap(unsigned int line, const Node &node)
 inline void
 StatsAggregator::aggregate(int value)
 {
-    if (sampleSize == 0 || value < min) {
-        min = value;
-    }
-    if (sampleSize == 0 || value > max) {
-        max = value;
-    }
-
+    ++histogram[value];
     ++sampleSize;
+}
 
-    data.push_back(value);
-    sorted = false;
+inline void
+StatsAggregator::merge(const StatsAggregator &other)
+{
+    for (const auto &entry : other.histogram) {
+        histogram[entry.first] += entry.second;
+    }
+    sampleSize += other.sampleSize;
 }
 
 inline bool
@@ -247,31 +276,63 @@ StatsAggregator::getSampleSize() const
 inline int
 StatsAggregator::getMin() const
 {
-    return min;
+    return (histogram.empty() ? 0 : histogram.cbegin()->first);
 }
 
 inline int
 StatsAggregator::getMax() const
 {
-    return max;
+    return (histogram.empty() ? 0 : histogram.crbegin()->first);
 }
 
 inline int
 StatsAggregator::getMedian() const
 {
-    if (data.empty()) {
+    if (sampleSize == 0) {
         return 0;
     }
 
-    if (!sorted) {
-        std::sort(data.begin(), data.end());
-        sorted = true;
+    if (sampleSize % 2 == 1) {
+        return getNth(sampleSize/2);
     }
+    return (getNth(sampleSize/2 - 1) + getNth(sampleSize/2))/2;
+}
 
-    if (data.size() % 2 == 1) {
-        return data[data.size()/2];
+inline int
+StatsAggregator::getPercentile(int percent) const
+{
+    if (sampleSize == 0) {
+        return 0;
     }
-    return (data[data.size()/2 - 1] + data[data.size()/2])/2;
+
+    // Rank is ceil(percent/100*sampleSize), but at least one.
+    const long long rank = (static_cast<long long>(percent)*sampleSize + 99)
+                         / 100;
+    return getNth(std::max(rank, 1LL) - 1);
+}
+
+inline int
+StatsAggregator::getNth(int n) const
+{
+    for (const auto &entry : histogram) {
+        if (n < entry.second) {
+            return entry.first;
+        }
+        n -= entry.second;
+    }
+    return getMax();
+}
+
+inline void
+FileStats::merge(const FileStats &other)
+{
+    blank += other.blank;
+    code += other.code;
+    comment += other.comment;
+    structural += other.structural;
+
+    funcSizes.merge(other.funcSizes);
+    paramCounts.merge(other.paramCounts);
 }
 
 inline
@@ -289,25 +350,40 @@ FileProcessor::FileProcessor(Environment &env, const Args &args)
     structuralHi = decor::bold + decor::inv + 81_fg + decor::black_bg;
 }
 
-inline bool
-FileProcessor::operator()(const std::string &path)
+inline std::function<bool(const std::string &path)>
+FileProcessor::operator()(const std::string &path, TimeReport &tr)
 {
-    cpp17::pmr::monolithic mr;
-    Tree tree(&mr);
+    // Results of analysis, which is done in parallel with other files.
+    struct Parsed : ParsedFile
+    {
+        using ParsedFile::ParsedFile;
 
-    if (optional_t<Tree> &&t = buildTreeFromFile(env, path, &mr)) {
-        tree = *t;
-    } else {
-        std::cerr << "Failed to parse: " << path << '\n';
-        return false;
-    }
+        std::vector<LineContent> map;
+        FileStats stats;
+    };
 
-    dumpTree(args, tree);
+    auto parsed = std::make_shared<Parsed>(arenas);
+    parsed->parse(env, tr, path);
 
-    if (args.dryRun) {
-        return true;
+    if (!parsed->tree.isEmpty() && !args.dryRun) {
+        analyze(parsed->tree, parsed->map, parsed->stats);
     }
 
+    return [this, parsed](const std::string &path) {
+        if (parsed->tree.isEmpty()) {
+            std::cerr << "Failed to parse: " << path << '\n';
+            return false;
+        }
+        return process(path, parsed->tree, parsed->map, parsed->stats);
+    };
+}
+
+// Computes statistics of a single file.  Doesn't modify state of the
+// processor, so can be invoked on several threads at the same time.
+inline void
+FileProcessor::analyze(Tree &tree, std::vector<LineContent> &map,
+                       FileStats &stats) const
+{
     Language &lang = *tree.getLanguage();
 
     LineAnalyzer lineAnalyzer(lang);
@@ -316,19 +392,53 @@ FileProcessor::operator()(const std::string &path)
         if (node->leaf) {
             lineAnalyzer.countIn(node);
         } else if (lang.classify(node->stype) == MType::Function) {
-            funcSizes.aggregate(functionAnalyzer.getLineCount(node));
-            paramCounts.aggregate(functionAnalyzer.getParamCount(node));
+            stats.funcSizes.aggregate(functionAnalyzer.getLineCount(node));
+            stats.paramCounts.aggregate(functionAnalyzer.getParamCount(node));
         }
     }
 
-    const std::vector<LineContent> &map = lineAnalyzer.getMap();
+    map = lineAnalyzer.getMap();
+    for (LineContent c : map) {
+        switch (c) {
+            case LineContent::Blank:
+                ++stats.blank;
+                break;
+            case LineContent::Code:
+                ++stats.code;
+                break;
+            case LineContent::Comment:
+                ++stats.comment;
+                break;
+            case LineContent::Structural:
+                ++stats.structural;
+                break;
+        }
+    }
+}
+
+// Accounts for results of analysis of a file.  Files are processed in the
+// order of their discovery.
+inline bool
+FileProcessor::process(const std::string &path, Tree &tree,
+                       const std::vector<LineContent> &map,
+                       const FileStats &stats)
+{
+    dumpTree(args, tree);
+
+    if (args.dryRun) {
+        return true;
+    }
 
-    std::unique_ptr<TermHighlighter> hi;
-    if (args.annotate) {
-        hi.reset(new TermHighlighter(tree));
-        std::cout << (pathHi << path) << '\n';
+    totals.merge(stats);
+    ++files;
+
+    if (!args.annotate) {
+        return true;
     }
 
+    TermHighlighter hi(tree);
+    std::cout << (pathHi << path) << '\n';
+
     const int lineColWidth = 1 + countWidth(map.size());
 
     int line = 1;
@@ -339,34 +449,27 @@ FileProcessor::operator()(const std::string &path)
             case LineContent::Blank:
                 str = " blank ";
                 dec = &blankHi;
-                ++blank;
                 break;
             case LineContent::Code:
                 str = " code ";
                 dec = &codeHi;
-                ++code;
                 break;
             case LineContent::Comment:
                 str = " comment ";
                 dec = &commentHi;
-                ++comment;
                 break;
             case LineContent::Structural:
                 str = " structural ";
                 dec = &structuralHi;
-                ++structural;
                 break;
         }
-        if (hi != nullptr) {
-            std::cout << std::setw(lineColWidth)
-                << std::right << (lineNoHi << line << ' ') << ' '
-                << std::setw(12) << std::left
-                << (*dec << str) << " "
-                << hi->print(line, 1) << '\n';
-        }
+        std::cout << std::setw(lineColWidth)
+            << std::right << (lineNoHi << line << ' ') << ' '
+            << std::setw(12) << std::left
+            << (*dec << str) << " "
+            << hi.print(line, 1) << '\n';
         ++line;
     }
-    ++files;
     return true;
 }
 
@@ -376,6 +479,11 @@ FileProcessor::printReport() const
     std::cout << Header { "Input information" }
               << Bullet { "files" } << files << "\n\n";
 
+    const int blank = totals.blank;
+    const int comment = totals.comment;
+    const int code = totals.code;
+    const int structural = totals.structural;
+
     int nonBlank = comment + code + structural;
     int lines = blank + nonBlank;
     std::cout << Header { "Line statistics" }
@@ -398,6 +506,8 @@ FileProcessor::printReport() const
                  << Part { nonBlank - comment, lines } << '\n'
               << '\n';
 
+    const StatsAggregator &funcSizes = totals.funcSizes;
+    const StatsAggregator &paramCounts = totals.paramCounts;
     if (!funcSizes.isEmpty()) {
         std::cout << Header { "Function statistics" }
                   << Bullet { "count" }
@@ -407,6 +517,10 @@ FileProcessor::printReport() const
                      << Count { funcSizes.getMin() } << '\n'
                   << "  " << Bullet { "median" }
                      << Count { funcSizes.getMedian() } << '\n'
+                  << "  " << Bullet { "p90" }
+                     << Count { funcSizes.getPercentile(90) } << '\n'
+                  << "  " << Bullet { "p99" }
+                     << Count { funcSizes.getPercentile(99) } << '\n'
                   << "  " << Bullet { "max" }
                      << Count { funcSizes.getMax() } << '\n'
                   << SubHeader { "Params" }
@@ -414,6 +528,10 @@ FileProcessor::printReport() const
                      << Count { paramCounts.getMin() } << '\n'
                   << "  " << Bullet { "median" }
                      << Count { paramCounts.getMedian() } << '\n'
+                  << "  " << Bullet { "p90" }
+                     << Count { paramCounts.getPercentile(90) } << '\n'
+                  << "  " << Bullet { "p99" }
+                     << Count { paramCounts.getPercentile(99) } << '\n'
                   << "  " << Bullet { "max" }
                      << Count { paramCounts.getMax() } << '\n';
     }
@@ -501,7 +619,8 @@ run(const Args &args, Environment &env)
     Config &config = env.getConfig();
     FileProcessor processor(env, args);
 
-    if (!Traverser(paths, args.lang, config, std::ref(processor)).search()) {
+    if (!Traverser(paths, args.lang, config, env.getTimeKeeper(),
+                   getParsingJobs(args), std::ref(processor)).search()) {
         std::cerr << "No matching files were discovered.\n";
         return EXIT_FAILURE;
     }